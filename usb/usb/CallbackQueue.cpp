@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CallbackQueue.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+CallbackQueue::CallbackQueue(size_t capacity)
+    : mCapacity(capacity), mThread(&CallbackQueue::run, this) {}
+
+CallbackQueue::~CallbackQueue() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExit = true;
+    }
+    mPosted.notify_one();
+    mRemoved.notify_all();
+    mThread.join();
+}
+
+void CallbackQueue::post(Callback callback, uint32_t key) {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    if (key) {
+        auto queued = std::find_if(mQueue.begin(), mQueue.end(),
+                                   [key](const Entry &e) { return e.key == key; });
+        // The newer callback goes last, so that it still comes after the
+        // callbacks queued since the superseded one.
+        if (queued != mQueue.end()) {
+            mQueue.erase(queued);
+            mSuperseded++;
+        }
+    } else if (mQueue.size() >= mCapacity) {
+        mBlocked++;
+        mRemoved.wait(lock, [this] { return mQueue.size() < mCapacity || mExit; });
+    }
+
+    mQueue.push_back({key, std::move(callback)});
+    mMaxDepth = std::max(mMaxDepth, mQueue.size());
+    mPosted.notify_one();
+}
+
+void CallbackQueue::debug(int fd) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    dprintf(fd, "Callbacks:\n");
+    dprintf(fd, "  Depth: %zu (max %zu, capacity %zu)\n", mQueue.size(), mMaxDepth, mCapacity);
+    dprintf(fd, "  Dispatched: %" PRIu64 "\n", mDispatched);
+    dprintf(fd, "  Superseded: %" PRIu64 "\n", mSuperseded);
+    dprintf(fd, "  Blocked: %" PRIu64 "\n", mBlocked);
+    dprintf(fd, "  Slowest: %" PRId64 " us\n",
+            static_cast<int64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(mMaxDispatch).count()));
+}
+
+void CallbackQueue::run() {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    for (;;) {
+        mPosted.wait(lock, [this] { return !mQueue.empty() || mExit; });
+        if (mExit) {
+            return;
+        }
+
+        Callback callback = std::move(mQueue.front().callback);
+        mQueue.pop_front();
+        mRemoved.notify_one();
+
+        lock.unlock();
+        const auto start = Clock::now();
+        callback();
+        const auto elapsed = Clock::now() - start;
+        lock.lock();
+
+        mDispatched++;
+        mMaxDispatch = std::max(mMaxDispatch, elapsed);
+    }
+}
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
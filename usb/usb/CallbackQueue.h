@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+// Runs the callbacks to the framework in order, on a thread of their own, so
+// that a slow framework holds up neither the uevents nor the HAL locks.
+class CallbackQueue {
+  public:
+    using Callback = std::function<void()>;
+
+    // Holds up to 'capacity' callbacks, plus one per key.
+    explicit CallbackQueue(size_t capacity);
+    ~CallbackQueue();
+
+    // Queues 'callback'. With a non-zero 'key', it drops the queued callback of
+    // the same key, e.g. an older snapshot of the port status, and never
+    // blocks. Otherwise it blocks while the queue is full.
+    void post(Callback callback, uint32_t key = 0);
+    // Emit diagnostic information to the given file.
+    void debug(int fd);
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        uint32_t key;
+        Callback callback;
+    };
+
+    void run();
+
+    const size_t mCapacity;
+    std::mutex mMutex;
+    std::condition_variable mPosted;
+    std::condition_variable mRemoved;
+    std::deque<Entry> mQueue;
+    bool mExit{false};
+    uint64_t mDispatched{0};
+    uint64_t mSuperseded{0};
+    uint64_t mBlocked{0};
+    size_t mMaxDepth{0};
+    Clock::duration mMaxDispatch{};
+    std::thread mThread;
+};
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PortStatusUpdate.h"
+
+#include <algorithm>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+Status updatePortStatus(const PortStatusReader &reader, const std::set<std::string> &ports,
+                        bool moisture, std::vector<PortStatus> *portStatus) {
+    Status status = Status::SUCCESS;
+    bool firstPort = false;
+    auto findPort = [&](const std::string &portName) {
+        return std::find_if(portStatus->begin(), portStatus->end(),
+                            [&](const PortStatus &p) { return p.portName == portName; });
+    };
+
+    if (portStatus->empty() ||
+        std::any_of(ports.begin(), ports.end(), [&](const std::string &p) {
+            return findPort(p) == portStatus->end() || !reader.exists(p);
+        })) {
+        portStatus->clear();
+        return reader.scan(portStatus);
+    }
+
+    for (const std::string &portName : ports) {
+        auto port = findPort(portName);
+        if (reader.readRoles(portName, &*port) != Status::SUCCESS) {
+            status = Status::ERROR;
+        }
+        firstPort |= port == portStatus->begin();
+    }
+    // The sink limit nodes belong to the PD phy of the first port.
+    if (firstPort) {
+        reader.readPowerTransfer(portStatus);
+    }
+    if (moisture) {
+        reader.readMoisture(portStatus);
+    }
+    return status;
+}
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
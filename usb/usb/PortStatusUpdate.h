@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/usb/PortStatus.h>
+#include <aidl/android/hardware/usb/Status.h>
+
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+// Where updatePortStatus() reads the status of the ports from.
+struct PortStatusReader {
+    // Reads the status of every port.
+    std::function<Status(std::vector<PortStatus> *portStatus)> scan;
+    // Whether the typec port is still registered.
+    std::function<bool(const std::string &portName)> exists;
+    // Reads the roles and capabilities of a port. The contaminant and power
+    // transfer fields are left alone.
+    std::function<Status(const std::string &portName, PortStatus *portStatus)> readRoles;
+    // Reads the power transfer limit, which the first port reports.
+    std::function<void(std::vector<PortStatus> *portStatus)> readPowerTransfer;
+    // Reads the moisture status, which the first port reports.
+    std::function<void(std::vector<PortStatus> *portStatus)> readMoisture;
+};
+
+// Updates the cached 'portStatus' with what a burst of uevents may have
+// changed: the typec 'ports', and the moisture status if 'moisture' is set.
+// Rescans every port when one of 'ports' was added or removed, and only reads
+// the nodes of 'ports' otherwise.
+Status updatePortStatus(const PortStatusReader &reader, const std::set<std::string> &ports,
+                        bool moisture, std::vector<PortStatus> *portStatus);
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "android.hardware.usb.aidl-service"
+
+#include "UeventBurst.h"
+
+#include <errno.h>
+#include <log/log.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+UeventBurst::UeventBurst(std::chrono::milliseconds window, FlushFunction flush)
+    : mWindow(window),
+      mFlush(std::move(flush)),
+      mTimerFd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) {
+    if (mTimerFd < 0) {
+        ALOGE("uevent burst timer failed; errno=%d", errno);
+    }
+}
+
+UeventBurst::~UeventBurst() {
+    disable();
+}
+
+void UeventBurst::disable() {
+    if (mTimerFd >= 0)
+        close(mTimerFd);
+    mTimerFd = -1;
+}
+
+void UeventBurst::add(const Uevent &event) {
+    if (!event.isTypec() && !event.hasMoisture)
+        return;
+
+    if (event.isTypec())
+        mPorts.emplace(event.typecPort());
+    mMoisture |= event.hasMoisture;
+    if (mUevents++)
+        return;
+
+    struct itimerspec spec = {};
+    spec.it_value.tv_sec = mWindow.count() / 1000;
+    spec.it_value.tv_nsec = mWindow.count() % 1000 * 1000000;
+    // Without the timer, the uevents are handled one by one.
+    if (mTimerFd < 0 || timerfd_settime(mTimerFd, 0, &spec, nullptr)) {
+        if (mTimerFd >= 0)
+            ALOGE("Failed to arm the uevent burst timer; errno=%d", errno);
+        flush();
+    }
+}
+
+void UeventBurst::expire() {
+    uint64_t expirations;
+
+    if (read(mTimerFd, &expirations, sizeof(expirations)) < 0)
+        return;
+    if (mUevents)
+        flush();
+}
+
+void UeventBurst::flush() {
+    std::set<std::string> ports;
+    bool moisture = mMoisture;
+    uint32_t uevents = mUevents;
+
+    ports.swap(mPorts);
+    mMoisture = false;
+    mUevents = 0;
+    mFlush(ports, moisture, uevents);
+}
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <functional>
+#include <set>
+#include <string>
+
+#include "UeventParser.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+// Coalesces the typec and moisture uevents received within a window of the
+// first one into a single update. Typec and moisture uevents come in bursts
+// around plug events. The window is timed by a timerfd, which the owner polls
+// alongside the uevent socket.
+class UeventBurst {
+  public:
+    // Handles a burst: the typec 'ports' it changed, whether it reported
+    // 'moisture', and the number of 'uevents' in it.
+    using FlushFunction = std::function<void(const std::set<std::string> &ports, bool moisture,
+                                              uint32_t uevents)>;
+
+    UeventBurst(std::chrono::milliseconds window, FlushFunction flush);
+    ~UeventBurst();
+
+    // The timer, readable once the window of a burst has passed. Negative
+    // when it could not be created, in which case no uevent is coalesced.
+    int fd() const { return mTimerFd; }
+    // Stops coalescing, e.g. when fd() cannot be polled, so that every uevent
+    // is handled on its own. Must be called before the first add().
+    void disable();
+    // Adds 'event' to the burst, starting one if none is open. Uevents of
+    // other devices are ignored.
+    void add(const Uevent &event);
+    // Flushes the burst once fd() is readable.
+    void expire();
+
+  private:
+    void flush();
+
+    const std::chrono::milliseconds mWindow;
+    const FlushFunction mFlush;
+    int mTimerFd;
+    std::set<std::string> mPorts;
+    bool mMoisture{false};
+    uint32_t mUevents{0};
+};
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
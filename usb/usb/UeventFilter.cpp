@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "android.hardware.usb.aidl-service"
+
+#include "UeventFilter.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <log/log.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+constexpr char kSysfsRoot[] = "/sys";
+constexpr char kTypecClassPath[] = "/sys/class/typec/";
+constexpr char kUsbPowerSupplyPath[] = "/sys/class/power_supply/usb";
+
+// Lengths of the uevent actions: add; bind, move; change, online, remove,
+// unbind; offline. The '@' of the header follows the action.
+constexpr uint32_t kActionLengths[] = {3, 4, 6, 7};
+
+constexpr uint32_t kAccept = 0xffffffff;
+constexpr uint32_t kDrop = 0;
+
+// Resolves a sysfs link into the devpath of its device.
+static bool getDevpath(const std::string &link, std::string *devpath) {
+    char path[PATH_MAX];
+
+    if (!realpath(link.c_str(), path)) {
+        ALOGE("Failed to resolve %s: %s", link.c_str(), strerror(errno));
+        return false;
+    }
+    if (strncmp(path, kSysfsRoot, strlen(kSysfsRoot)) || path[strlen(kSysfsRoot)] != '/') {
+        ALOGE("Unexpected path for %s: %s", link.c_str(), path);
+        return false;
+    }
+    *devpath = path + strlen(kSysfsRoot);
+    return true;
+}
+
+bool getUeventFilterRules(std::vector<UeventFilterRule> *rules) {
+    UeventFilterRule rule;
+    DIR *dp;
+
+    rules->clear();
+    dp = opendir(kTypecClassPath);
+    if (dp == NULL) {
+        ALOGE("Failed to open %s", kTypecClassPath);
+        return false;
+    }
+    // Partners, cables and plugs are named after their port and live below it.
+    while (struct dirent *ep = readdir(dp)) {
+        if (ep->d_name[0] == '.' || strchr(ep->d_name, '-')) {
+            continue;
+        }
+        if (!getDevpath(std::string(kTypecClassPath) + ep->d_name, &rule.devpath)) {
+            closedir(dp);
+            return false;
+        }
+        rule.subtree = true;
+        rules->push_back(rule);
+    }
+    closedir(dp);
+    if (rules->empty()) {
+        ALOGE("No typec port found");
+        return false;
+    }
+
+    if (!getDevpath(kUsbPowerSupplyPath, &rule.devpath)) {
+        return false;
+    }
+    rule.subtree = false;
+    rules->push_back(rule);
+    return true;
+}
+
+// Emits the instructions which accept a header naming 'rule' when its action
+// is 'actionLength' long, and fall through to the next instruction otherwise.
+// Returns false if the failure jumps do not fit in their 8 bit offsets.
+static bool emitRule(const UeventFilterRule &rule, uint32_t actionLength,
+                     std::vector<sock_filter> *program) {
+    const std::string &devpath = rule.devpath;
+    const uint32_t begin = actionLength + 1;
+    const uint32_t end = begin + devpath.size();
+    std::vector<size_t> failJumps;
+    uint32_t offset = begin;
+
+    auto emit = [&](sock_filter insn) { program->push_back(insn); };
+    auto emitCheck = [&](uint16_t code, uint32_t value) {
+        failJumps.push_back(program->size());
+        emit(BPF_JUMP(code, value, 0, 0));
+    };
+
+    // Loads past the end of the message would abort the whole program.
+    emit(BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0));
+    emitCheck(BPF_JMP | BPF_JGE | BPF_K, end + 1);
+    emit(BPF_STMT(BPF_LD | BPF_B | BPF_ABS, actionLength));
+    emitCheck(BPF_JMP | BPF_JEQ | BPF_K, '@');
+
+    // Absolute loads are big endian.
+    while (offset < end) {
+        const uint32_t size = end - offset >= 4 ? 4 : end - offset >= 2 ? 2 : 1;
+        const uint16_t width = size == 4 ? BPF_W : size == 2 ? BPF_H : BPF_B;
+        uint32_t value = 0;
+
+        for (uint32_t i = 0; i < size; i++) {
+            value = (value << 8) | static_cast<uint8_t>(devpath[offset - begin + i]);
+        }
+        emit(BPF_STMT(BPF_LD | width | BPF_ABS, offset));
+        emitCheck(BPF_JMP | BPF_JEQ | BPF_K, value);
+        offset += size;
+    }
+
+    // The devpath must end there, or go on below the device for a subtree.
+    emit(BPF_STMT(BPF_LD | BPF_B | BPF_ABS, end));
+    if (rule.subtree) {
+        emit(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, '\0', 1, 0));
+        emitCheck(BPF_JMP | BPF_JEQ | BPF_K, '/');
+    } else {
+        emitCheck(BPF_JMP | BPF_JEQ | BPF_K, '\0');
+    }
+    emit(BPF_STMT(BPF_RET | BPF_K, kAccept));
+
+    for (size_t jump : failJumps) {
+        const size_t skip = program->size() - (jump + 1);
+        if (skip > UINT8_MAX) {
+            return false;
+        }
+        (*program)[jump].jf = skip;
+    }
+    return true;
+}
+
+std::vector<sock_filter> buildUeventFilter(const std::vector<UeventFilterRule> &rules) {
+    std::vector<sock_filter> program;
+
+    for (const auto &rule : rules) {
+        for (uint32_t actionLength : kActionLengths) {
+            if (!emitRule(rule, actionLength, &program)) {
+                ALOGE("Devpath too long for a uevent filter: %s", rule.devpath.c_str());
+                return {};
+            }
+        }
+    }
+    program.push_back(BPF_STMT(BPF_RET | BPF_K, kDrop));
+
+    if (program.size() > BPF_MAXINSNS) {
+        ALOGE("Uevent filter too long: %zu instructions", program.size());
+        return {};
+    }
+    return program;
+}
+
+bool attachUeventFilter(int fd, const std::vector<sock_filter> &program) {
+    const sock_fprog fprog = {
+            .len = static_cast<unsigned short>(program.size()),
+            .filter = const_cast<sock_filter *>(program.data()),
+    };
+
+    if (program.empty()) {
+        return false;
+    }
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog))) {
+        ALOGE("Failed to attach the uevent filter: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
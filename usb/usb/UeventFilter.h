@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <linux/filter.h>
+
+#include <string>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+// A device whose uevents wake the HAL.
+struct UeventFilterRule {
+    // As in the uevent header, i.e. the sysfs path without "/sys".
+    std::string devpath;
+    // Also matches the devices below it, e.g. the partner of a port.
+    bool subtree;
+};
+
+// Resolves the rules for the typec ports, and their partners, and for the
+// USB power supply, which reports moisture. Fails when any of them is
+// missing, in which case no filter should be used.
+bool getUeventFilterRules(std::vector<UeventFilterRule> *rules);
+// Builds a classic BPF program which only accepts the uevents whose header,
+// "action@devpath", names a device matched by one of the rules. Returns an
+// empty program when the rules do not fit in one.
+std::vector<sock_filter> buildUeventFilter(const std::vector<UeventFilterRule> &rules);
+// Attaches 'program' to the socket, so that the kernel drops the rest.
+bool attachUeventFilter(int fd, const std::vector<sock_filter> &program);
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "UeventParser.h"
+
+#include <string.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+using std::string_view;
+
+// Sets 'field' to the value of 'line' if it is the first "key=value" line
+// for 'key'.
+static bool parseKey(string_view line, string_view key, string_view *field) {
+    if (line.size() < key.size() || memcmp(line.data(), key.data(), key.size())) {
+        return false;
+    }
+    if (field->data() == nullptr) {
+        *field = line.substr(key.size());
+    }
+    return true;
+}
+
+void parseUevent(const char *msg, size_t len, Uevent *event) {
+    static constexpr string_view kPartnerSuffix = "-partner";
+    const char *end = msg + len;
+
+    *event = {};
+    while (msg < end && *msg) {
+        const char *nul = static_cast<const char *>(memchr(msg, '\0', end - msg));
+        const string_view line(msg, (nul ? nul : end) - msg);
+
+        // Dispatch on the first character, so that most lines are rejected
+        // by a single comparison.
+        switch (line[0]) {
+            case 'a':
+                if (line.substr(0, 3) == "add" && line.size() >= 3 + kPartnerSuffix.size() &&
+                    line.substr(line.size() - kPartnerSuffix.size()) == kPartnerSuffix) {
+                    event->partnerAdded = true;
+                }
+                break;
+            case 'A':
+                parseKey(line, "ACTION=", &event->action);
+                break;
+            case 'D':
+                parseKey(line, "DEVPATH=", &event->devpath) ||
+                        parseKey(line, "DEVTYPE=", &event->devtype);
+                break;
+            case 'S':
+                parseKey(line, "SUBSYSTEM=", &event->subsystem);
+                break;
+            case 'P':
+                if (line.substr(0, 13) != "POWER_SUPPLY_") {
+                    break;
+                }
+                if (line.substr(13, 17) == "MOISTURE_DETECTED") {
+                    event->hasMoisture = true;
+                } else {
+                    parseKey(line, "POWER_SUPPLY_NAME=", &event->powerSupplyName);
+                }
+                break;
+            default:
+                break;
+        }
+        if (!nul) {
+            break;
+        }
+        msg = nul + 1;
+    }
+}
+
+string_view Uevent::typecPort() const {
+    static constexpr string_view kTypecDir = "/typec/";
+    const size_t begin = devpath.find(kTypecDir);
+
+    if (!isTypec() || begin == string_view::npos) {
+        return {};
+    }
+    // Partners, cables and plugs live below their port.
+    const string_view port = devpath.substr(begin + kTypecDir.size());
+    return port.substr(0, port.find('/'));
+}
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include <string_view>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+// The fields of a kernel uevent which the HAL acts on. The views point into
+// the parsed message and are empty when the key is absent.
+struct Uevent {
+    std::string_view action;
+    std::string_view devpath;
+    std::string_view subsystem;
+    std::string_view devtype;
+    std::string_view powerSupplyName;
+    // A line starts with "add" and ends with "-partner", which is the header
+    // of a typec partner being added.
+    bool partnerAdded;
+    // POWER_SUPPLY_MOISTURE_DETECTED is present, whatever its value.
+    bool hasMoisture;
+
+    // A typec port, partner or cable changed.
+    bool isTypec() const { return devtype.substr(0, 6) == "typec_"; }
+    // The name of the typec port which changed, e.g. "port0" for the port
+    // itself and for its partner. Empty for other devices.
+    std::string_view typecPort() const;
+};
+
+// Parses the 'len' bytes of NUL-separated lines of 'msg' into 'event' in a
+// single pass, without allocating. Only the first occurrence of a key counts.
+void parseUevent(const char *msg, size_t len, Uevent *event);
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
@@ -21,12 +21,16 @@
 #include <android-base/strings.h>
 #include <assert.h>
 #include <dirent.h>
+#include <inttypes.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
 #include <chrono>
-#include <regex>
+#include <functional>
+#include <memory>
+#include <set>
 #include <thread>
 #include <unordered_map>
 
@@ -36,6 +40,10 @@
 #include <utils/StrongPointer.h>
 
 #include "Usb.h"
+#include "PortStatusUpdate.h"
+#include "UeventBurst.h"
+#include "UeventFilter.h"
+#include "UeventParser.h"
 
 using android::base::GetProperty;
 using android::base::Trim;
@@ -53,9 +61,69 @@ constexpr char kDetectedPath[] = "/sys/class/power_supply/usb/moisture_detected"
 constexpr char kDisableContatminantDetection[] = "vendor.usb.contaminantdisable";
 constexpr char kEnabledPath[] = "/sys/class/power_supply/usb/moisture_detection_enabled";
 constexpr char kTypecPath[] = "/sys/class/typec";
+// Typec and moisture uevents received within this window of the first one are
+// handled as a single update.
+constexpr std::chrono::milliseconds kUeventBurstWindow{100};
+// Callbacks waiting for the framework, beyond which the HAL entry points block.
+constexpr size_t kCallbackQueueCapacity = 32;
+// Port status snapshots supersede the one still queued.
+constexpr uint32_t kPortStatusCallbackKey = 1;
 
 void queryVersionHelper(android::hardware::usb::Usb *usb,
-                        std::vector<PortStatus> *currentPortStatus);
+                        std::vector<PortStatus> *currentPortStatus, bool force = false);
+
+// Takes mLock, accounting for the time spent waiting for it.
+static void lockHelper(android::hardware::usb::Usb *usb) {
+    using std::chrono::steady_clock;
+
+    if (pthread_mutex_trylock(&usb->mLock)) {
+        const steady_clock::time_point start = steady_clock::now();
+        pthread_mutex_lock(&usb->mLock);
+        const steady_clock::duration wait = steady_clock::now() - start;
+        usb->mLockStats.contended++;
+        usb->mLockStats.totalWait += wait;
+        usb->mLockStats.maxWait = std::max(usb->mLockStats.maxWait, wait);
+    }
+    usb->mLockStats.acquired++;
+    usb->mLockStats.lockedAt = steady_clock::now();
+}
+
+static void unlockHelper(android::hardware::usb::Usb *usb) {
+    const std::chrono::steady_clock::duration hold =
+            std::chrono::steady_clock::now() - usb->mLockStats.lockedAt;
+
+    usb->mLockStats.maxHold = std::max(usb->mLockStats.maxHold, hold);
+    pthread_mutex_unlock(&usb->mLock);
+}
+
+// Returns mCallback, holding mLock only to copy it.
+static shared_ptr<IUsbCallback> getCallbackHelper(android::hardware::usb::Usb *usb) {
+    shared_ptr<IUsbCallback> callback;
+
+    lockHelper(usb);
+    callback = usb->mCallback;
+    unlockHelper(usb);
+    return callback;
+}
+
+// Queues a call to 'callback', made from the dispatch thread. 'what' names it
+// in the logs. See CallbackQueue::post() for 'key'.
+static void postCallbackHelper(android::hardware::usb::Usb *usb,
+                               const shared_ptr<IUsbCallback> &callback, const char *what,
+                               std::function<ScopedAStatus(IUsbCallback *)> notify,
+                               uint32_t key = 0) {
+    if (callback == NULL) {
+        ALOGE("Not notifying the userspace. Callback is not set");
+        return;
+    }
+    usb->mCallbacks.post(
+            [callback, what, notify = std::move(notify)] {
+                ScopedAStatus ret = notify(callback.get());
+                if (!ret.isOk())
+                    ALOGE("%s error %s", what, ret.getDescription().c_str());
+            },
+            key);
+}
 
 ScopedAStatus Usb::enableUsbData(const string& in_portName, bool in_enable,
         int64_t in_transactionId) {
@@ -101,16 +169,12 @@ ScopedAStatus Usb::enableUsbData(const string& in_portName, bool in_enable,
     if (result) {
         mUsbDataEnabled = in_enable;
     }
-    pthread_mutex_lock(&mLock);
-    if (mCallback != NULL) {
-        ScopedAStatus ret = mCallback->notifyEnableUsbDataStatus(
-            in_portName, in_enable, result ? Status::SUCCESS : Status::ERROR, in_transactionId);
-        if (!ret.isOk())
-            ALOGE("notifyEnableUsbDataStatus error %s", ret.getDescription().c_str());
-    } else {
-        ALOGE("Not notifying the userspace. Callback is not set");
-    }
-    pthread_mutex_unlock(&mLock);
+    postCallbackHelper(this, getCallbackHelper(this), "notifyEnableUsbDataStatus",
+                       [=](IUsbCallback *callback) {
+                           return callback->notifyEnableUsbDataStatus(
+                                   in_portName, in_enable,
+                                   result ? Status::SUCCESS : Status::ERROR, in_transactionId);
+                       });
     queryVersionHelper(this, &currentPortStatus);
 
     return ScopedAStatus::ok();
@@ -122,16 +186,11 @@ ScopedAStatus Usb::enableUsbDataWhileDocked(const string& in_portName,
 
     ALOGI("Userspace enableUsbDataWhileDocked  opID:%ld", in_transactionId);
 
-    pthread_mutex_lock(&mLock);
-    if (mCallback != NULL) {
-        ScopedAStatus ret = mCallback->notifyEnableUsbDataWhileDockedStatus(
-                in_portName, Status::NOT_SUPPORTED, in_transactionId);
-        if (!ret.isOk())
-            ALOGE("notifyEnableUsbDataStatus error %s", ret.getDescription().c_str());
-    } else {
-        ALOGE("Not notifying the userspace. Callback is not set");
-    }
-    pthread_mutex_unlock(&mLock);
+    postCallbackHelper(this, getCallbackHelper(this), "notifyEnableUsbDataWhileDockedStatus",
+                       [=](IUsbCallback *callback) {
+                           return callback->notifyEnableUsbDataWhileDockedStatus(
+                                   in_portName, Status::NOT_SUPPORTED, in_transactionId);
+                       });
     queryVersionHelper(this, &currentPortStatus);
 
     return ScopedAStatus::ok();
@@ -148,16 +207,12 @@ ScopedAStatus Usb::resetUsbPort(const std::string& in_portName, int64_t in_trans
         result = false;
     }
 
-    pthread_mutex_lock(&mLock);
-    if (mCallback != NULL) {
-        ::ndk::ScopedAStatus ret = mCallback->notifyResetUsbPortStatus(
-            in_portName, result ? Status::SUCCESS : Status::ERROR, in_transactionId);
-        if (!ret.isOk())
-            ALOGE("notifyTransactionStatus error %s", ret.getDescription().c_str());
-    } else {
-        ALOGE("Not notifying the userspace. Callback is not set");
-    }
-    pthread_mutex_unlock(&mLock);
+    postCallbackHelper(this, getCallbackHelper(this), "notifyTransactionStatus",
+                       [=](IUsbCallback *callback) {
+                           return callback->notifyResetUsbPortStatus(
+                                   in_portName, result ? Status::SUCCESS : Status::ERROR,
+                                   in_transactionId);
+                       });
 
     return ::ndk::ScopedAStatus::ok();
 }
@@ -165,9 +220,10 @@ ScopedAStatus Usb::resetUsbPort(const std::string& in_portName, int64_t in_trans
 ScopedAStatus Usb::limitPowerTransfer(const string& in_portName, bool in_limit,
         int64_t in_transactionId) {
     std::vector<PortStatus> currentPortStatus;
+    shared_ptr<IUsbCallback> currentCallback;
     bool sessionFail = false, success;
 
-    pthread_mutex_lock(&mLock);
+    lockHelper(this);
     ALOGI("limitPowerTransfer limit:%c opId:%ld", in_limit ? 'y' : 'n', in_transactionId);
 
     if (in_limit) {
@@ -190,17 +246,18 @@ ScopedAStatus Usb::limitPowerTransfer(const string& in_portName, bool in_limit,
         sessionFail = true;
     }
 
-    if (mCallback != NULL && in_transactionId >= 0) {
-        ScopedAStatus ret = mCallback->notifyLimitPowerTransferStatus(
-                in_portName, in_limit, sessionFail ? Status::ERROR : Status::SUCCESS,
-                in_transactionId);
-        if (!ret.isOk())
-            ALOGE("limitPowerTransfer error %s", ret.getDescription().c_str());
+    currentCallback = mCallback;
+    unlockHelper(this);
+
+    if (in_transactionId >= 0) {
+        postCallbackHelper(this, currentCallback, "limitPowerTransfer", [=](IUsbCallback *callback) {
+            return callback->notifyLimitPowerTransferStatus(
+                    in_portName, in_limit, sessionFail ? Status::ERROR : Status::SUCCESS,
+                    in_transactionId);
+        });
     } else {
         ALOGE("Not notifying the userspace. Callback is not set");
     }
-
-    pthread_mutex_unlock(&mLock);
     queryVersionHelper(this, &currentPortStatus);
 
     return ScopedAStatus::ok();
@@ -209,8 +266,8 @@ ScopedAStatus Usb::limitPowerTransfer(const string& in_portName, bool in_limit,
 Status queryMoistureDetectionStatus(std::vector<PortStatus> *currentPortStatus) {
     string enabled, status, path, DetectedPath;
 
-    (*currentPortStatus)[0].supportedContaminantProtectionModes
-            .push_back(ContaminantProtectionMode::FORCE_DISABLE);
+    (*currentPortStatus)[0].supportedContaminantProtectionModes = {
+            ContaminantProtectionMode::FORCE_DISABLE};
     (*currentPortStatus)[0].contaminantProtectionStatus = ContaminantProtectionStatus::NONE;
     (*currentPortStatus)[0].contaminantDetectionStatus = ContaminantDetectionStatus::DISABLED;
     (*currentPortStatus)[0].supportsEnableContaminantPresenceDetection = true;
@@ -369,7 +426,11 @@ Usb::Usb()
       mRoleSwitchLock(PTHREAD_MUTEX_INITIALIZER),
       mPartnerLock(PTHREAD_MUTEX_INITIALIZER),
       mPartnerUp(false),
-      mUsbDataEnabled(true) {
+      mUsbDataEnabled(true),
+      mPortStatusResult(Status::SUCCESS),
+      mUeventBursts{},
+      mLockStats{},
+      mCallbacks(kCallbackQueueCapacity) {
     pthread_condattr_t attr;
     if (pthread_condattr_init(&attr)) {
         ALOGE("pthread_condattr_init failed: %s", strerror(errno));
@@ -429,16 +490,12 @@ ScopedAStatus Usb::switchRole(const string& in_portName, const PortRole& in_role
         }
     }
 
-    pthread_mutex_lock(&mLock);
-    if (mCallback != NULL) {
-         ScopedAStatus ret = mCallback->notifyRoleSwitchStatus(
-            in_portName, in_role, roleSwitch ? Status::SUCCESS : Status::ERROR, in_transactionId);
-        if (!ret.isOk())
-            ALOGE("RoleSwitchStatus error %s", ret.getDescription().c_str());
-    } else {
-        ALOGE("Not notifying the userspace. Callback is not set");
-    }
-    pthread_mutex_unlock(&mLock);
+    postCallbackHelper(this, getCallbackHelper(this), "RoleSwitchStatus",
+                       [=](IUsbCallback *callback) {
+                           return callback->notifyRoleSwitchStatus(
+                                   in_portName, in_role,
+                                   roleSwitch ? Status::SUCCESS : Status::ERROR, in_transactionId);
+                       });
     pthread_mutex_unlock(&mRoleSwitchLock);
 
     return ScopedAStatus::ok();
@@ -563,6 +620,66 @@ bool canSwitchRoleHelper(const string &portName) {
     return false;
 }
 
+bool isPartnerConnected(const string &portName) {
+    return !access(("/sys/class/typec/" + portName + "-partner").c_str(), F_OK);
+}
+
+// Reads the roles and capabilities of a port into 'portStatus'. The contaminant
+// and power transfer fields are left alone.
+Status getPortRolesHelper(android::hardware::usb::Usb *usb, const string &portName,
+        bool connected, PortStatus *portStatus) {
+    PortRole currentRole;
+
+    ALOGI("%s", portName.c_str());
+    portStatus->portName = portName;
+
+    currentRole.set<PortRole::powerRole>(PortPowerRole::NONE);
+    if (getCurrentRoleHelper(portName, connected, &currentRole) == Status::SUCCESS){
+        portStatus->currentPowerRole = currentRole.get<PortRole::powerRole>();
+    } else {
+        ALOGE("Error while retrieving portNames");
+        return Status::ERROR;
+    }
+
+    currentRole.set<PortRole::dataRole>(PortDataRole::NONE);
+    if (getCurrentRoleHelper(portName, connected, &currentRole) == Status::SUCCESS) {
+        portStatus->currentDataRole = currentRole.get<PortRole::dataRole>();
+    } else {
+        ALOGE("Error while retrieving current port role");
+        return Status::ERROR;
+    }
+
+    currentRole.set<PortRole::mode>(PortMode::NONE);
+    if (getCurrentRoleHelper(portName, connected, &currentRole) == Status::SUCCESS) {
+        portStatus->currentMode = currentRole.get<PortRole::mode>();
+    } else {
+        ALOGE("Error while retrieving current data role");
+        return Status::ERROR;
+    }
+
+    portStatus->canChangeMode = true;
+    portStatus->canChangeDataRole = connected ? canSwitchRoleHelper(portName) : false;
+    portStatus->canChangePowerRole = portStatus->canChangeDataRole;
+
+    portStatus->supportedModes = {PortMode::DRP};
+
+    if (!usb->mUsbDataEnabled) {
+        portStatus->usbDataStatus = {UsbDataStatus::DISABLED_FORCE};
+    } else {
+        portStatus->usbDataStatus = {UsbDataStatus::ENABLED};
+    }
+    portStatus->powerBrickStatus = PowerBrickStatus::UNKNOWN;
+
+    ALOGI("%s connected:%d canChangeMode:%d canChagedata:%d canChangePower:%d "
+        "usbDataEnabled:%d",
+        portName.c_str(), connected,
+        portStatus->canChangeMode,
+        portStatus->canChangeDataRole,
+        portStatus->canChangePowerRole,
+        usb->mUsbDataEnabled ? 1 : 0);
+    return Status::SUCCESS;
+}
+
 Status getPortStatusHelper(android::hardware::usb::Usb *usb,
         std::vector<PortStatus> *currentPortStatus) {
     std::unordered_map<string, bool> names;
@@ -573,61 +690,13 @@ Status getPortStatusHelper(android::hardware::usb::Usb *usb,
         currentPortStatus->resize(names.size());
         for (std::pair<string, bool> port : names) {
             i++;
-            ALOGI("%s", port.first.c_str());
-            (*currentPortStatus)[i].portName = port.first;
-
-            PortRole currentRole;
-            currentRole.set<PortRole::powerRole>(PortPowerRole::NONE);
-            if (getCurrentRoleHelper(port.first, port.second, &currentRole) == Status::SUCCESS){
-                (*currentPortStatus)[i].currentPowerRole = currentRole.get<PortRole::powerRole>();
-            } else {
-                ALOGE("Error while retrieving portNames");
-                goto done;
-            }
-
-            currentRole.set<PortRole::dataRole>(PortDataRole::NONE);
-            if (getCurrentRoleHelper(port.first, port.second, &currentRole) == Status::SUCCESS) {
-                (*currentPortStatus)[i].currentDataRole = currentRole.get<PortRole::dataRole>();
-            } else {
-                ALOGE("Error while retrieving current port role");
-                goto done;
-            }
-
-            currentRole.set<PortRole::mode>(PortMode::NONE);
-            if (getCurrentRoleHelper(port.first, port.second, &currentRole) == Status::SUCCESS) {
-                (*currentPortStatus)[i].currentMode = currentRole.get<PortRole::mode>();
-            } else {
-                ALOGE("Error while retrieving current data role");
-                goto done;
-            }
-
-            (*currentPortStatus)[i].canChangeMode = true;
-            (*currentPortStatus)[i].canChangeDataRole =
-                port.second ? canSwitchRoleHelper(port.first) : false;
-            (*currentPortStatus)[i].canChangePowerRole =
-                port.second ? canSwitchRoleHelper(port.first) : false;
-
-            (*currentPortStatus)[i].supportedModes.push_back(PortMode::DRP);
-
-            if (!usb->mUsbDataEnabled) {
-                (*currentPortStatus)[i].usbDataStatus.push_back(UsbDataStatus::DISABLED_FORCE);
-            } else {
-                (*currentPortStatus)[i].usbDataStatus.push_back(UsbDataStatus::ENABLED);
+            result = getPortRolesHelper(usb, port.first, port.second, &(*currentPortStatus)[i]);
+            if (result != Status::SUCCESS) {
+                break;
             }
-            (*currentPortStatus)[i].powerBrickStatus = PowerBrickStatus::UNKNOWN;
-
-            ALOGI("%d:%s connected:%d canChangeMode:%d canChagedata:%d canChangePower:%d "
-                "usbDataEnabled:%d",
-                i, port.first.c_str(), port.second,
-                (*currentPortStatus)[i].canChangeMode,
-                (*currentPortStatus)[i].canChangeDataRole,
-                (*currentPortStatus)[i].canChangePowerRole,
-                usb->mUsbDataEnabled ? 1 : 0);
         }
-        return Status::SUCCESS;
     }
-done:
-    return Status::ERROR;
+    return result;
 }
 
 Status queryPowerTransferStatus(std::vector<PortStatus> *currentPortStatus) {
@@ -645,38 +714,91 @@ Status queryPowerTransferStatus(std::vector<PortStatus> *currentPortStatus) {
     return Status::SUCCESS;
 }
 
-void queryVersionHelper(android::hardware::usb::Usb *usb,
-                        std::vector<PortStatus> *currentPortStatus) {
-    Status status;
-    pthread_mutex_lock(&usb->mLock);
-    status = getPortStatusHelper(usb, currentPortStatus);
-    queryMoistureDetectionStatus(currentPortStatus);
-    queryPowerTransferStatus(currentPortStatus);
+// Reads the status of every port. Called with mLock held.
+static Status scanPortStatusHelper(android::hardware::usb::Usb *usb,
+                                   std::vector<PortStatus> *currentPortStatus) {
+    Status status = getPortStatusHelper(usb, currentPortStatus);
+
+    if (!currentPortStatus->empty()) {
+        queryMoistureDetectionStatus(currentPortStatus);
+        queryPowerTransferStatus(currentPortStatus);
+    }
+    return status;
+}
+
+// Caches the status, and queues it for the callback unless it is the one sent
+// last. Called with mLock held, which a keyed post does not block.
+static void notifyPortStatusHelper(android::hardware::usb::Usb *usb,
+                                   const std::vector<PortStatus> &currentPortStatus,
+                                   Status status, bool force) {
+    if (!force && currentPortStatus == usb->mPortStatus && status == usb->mPortStatusResult) {
+        ALOGI("Port status unchanged");
+        return;
+    }
+    usb->mPortStatus = currentPortStatus;
+    usb->mPortStatusResult = status;
+
     if (usb->mCallback != NULL) {
-        ScopedAStatus ret = usb->mCallback->notifyPortStatusChange(*currentPortStatus,
-            status);
-        if (!ret.isOk())
-            ALOGE("queryPortStatus error %s", ret.getDescription().c_str());
+        postCallbackHelper(usb, usb->mCallback, "queryPortStatus",
+                           [currentPortStatus, status](IUsbCallback *callback) {
+                               return callback->notifyPortStatusChange(currentPortStatus, status);
+                           },
+                           kPortStatusCallbackKey);
     } else {
         ALOGI("Notifying userspace skipped. Callback is NULL");
     }
-    pthread_mutex_unlock(&usb->mLock);
+}
+
+void queryVersionHelper(android::hardware::usb::Usb *usb,
+                        std::vector<PortStatus> *currentPortStatus, bool force) {
+    Status status;
+    lockHelper(usb);
+    status = scanPortStatusHelper(usb, currentPortStatus);
+    notifyPortStatusHelper(usb, *currentPortStatus, status, force);
+    unlockHelper(usb);
+}
+
+// Updates the cached status with what a burst of uevents may have changed:
+// the nodes of the typec 'ports', and the moisture status if 'moisture' is
+// set.
+void updatePortStatusHelper(android::hardware::usb::Usb *usb, const std::set<string> &ports,
+                            bool moisture, std::vector<PortStatus> *currentPortStatus) {
+    const PortStatusReader reader = {
+            .scan = [usb](std::vector<PortStatus> *portStatus) {
+                return scanPortStatusHelper(usb, portStatus);
+            },
+            .exists = [](const string &portName) {
+                return !access((string(kTypecPath) + "/" + portName).c_str(), F_OK);
+            },
+            .readRoles = [usb](const string &portName, PortStatus *portStatus) {
+                return getPortRolesHelper(usb, portName, isPartnerConnected(portName),
+                                          portStatus);
+            },
+            .readPowerTransfer = [](std::vector<PortStatus> *portStatus) {
+                queryPowerTransferStatus(portStatus);
+            },
+            .readMoisture = [](std::vector<PortStatus> *portStatus) {
+                queryMoistureDetectionStatus(portStatus);
+            },
+    };
+    Status status;
+
+    lockHelper(usb);
+    *currentPortStatus = usb->mPortStatus;
+    status = updatePortStatus(reader, ports, moisture, currentPortStatus);
+    notifyPortStatusHelper(usb, *currentPortStatus, status, false);
+    unlockHelper(usb);
 }
 
 ScopedAStatus Usb::queryPortStatus(int64_t in_transactionId) {
     std::vector<PortStatus> currentPortStatus;
 
-    queryVersionHelper(this, &currentPortStatus);
-    pthread_mutex_lock(&mLock);
-    if (mCallback != NULL) {
-        ScopedAStatus ret = mCallback->notifyQueryPortStatus(
-            "all", Status::SUCCESS, in_transactionId);
-        if (!ret.isOk())
-            ALOGE("notifyQueryPortStatus error %s", ret.getDescription().c_str());
-    } else {
-        ALOGE("Not notifying the userspace. Callback is not set");
-    }
-    pthread_mutex_unlock(&mLock);
+    queryVersionHelper(this, &currentPortStatus, true);
+    postCallbackHelper(this, getCallbackHelper(this), "notifyQueryPortStatus",
+                       [=](IUsbCallback *callback) {
+                           return callback->notifyQueryPortStatus("all", Status::SUCCESS,
+                                                                  in_transactionId);
+                       });
 
     return ScopedAStatus::ok();
 }
@@ -691,16 +813,12 @@ ScopedAStatus Usb::enableContaminantPresenceDetection(const string& in_portName,
     if (status != "running" && disable != "true")
         success = WriteStringToFile(in_enable ? "1" : "0", kEnabledPath);
 
-    pthread_mutex_lock(&mLock);
-    if (mCallback != NULL) {
-        ScopedAStatus ret = mCallback->notifyContaminantEnabledStatus(
-            in_portName, in_enable, success ? Status::SUCCESS : Status::ERROR, in_transactionId);
-        if (!ret.isOk())
-            ALOGE("notifyContaminantEnabledStatus error %s", ret.getDescription().c_str());
-    } else {
-        ALOGE("Not notifying the userspace. Callback is not set");
-    }
-    pthread_mutex_unlock(&mLock);
+    postCallbackHelper(this, getCallbackHelper(this), "notifyContaminantEnabledStatus",
+                       [=](IUsbCallback *callback) {
+                           return callback->notifyContaminantEnabledStatus(
+                                   in_portName, in_enable,
+                                   success ? Status::SUCCESS : Status::ERROR, in_transactionId);
+                       });
 
     queryVersionHelper(this, &currentPortStatus);
     return ScopedAStatus::ok();
@@ -709,11 +827,49 @@ ScopedAStatus Usb::enableContaminantPresenceDetection(const string& in_portName,
 struct data {
     int uevent_fd;
     ::aidl::android::hardware::usb::Usb *usb;
+    std::unique_ptr<UeventBurst> burst;
 };
 
+// Handles the uevents of a burst at once: one status update and one
+// notification, then a single check of the disconnected ports.
+static void uevent_burst_flush(Usb *usb, const std::set<string> &ports, bool moisture,
+                               uint32_t uevents) {
+    std::vector<PortStatus> currentPortStatus;
+
+    ALOGI("Coalesced %u uevents", uevents);
+    updatePortStatusHelper(usb, ports, moisture, &currentPortStatus);
+
+    lockHelper(usb);
+    usb->mUeventBursts.bursts++;
+    usb->mUeventBursts.uevents += uevents;
+    usb->mUeventBursts.largest = std::max(usb->mUeventBursts.largest, uevents);
+    usb->mUeventBursts.last = uevents;
+    unlockHelper(usb);
+
+    // Role switch is not in progress and port is in disconnected state
+    if (!pthread_mutex_trylock(&usb->mRoleSwitchLock)) {
+        for (unsigned long i = 0; i < currentPortStatus.size(); i++) {
+            DIR *dp =
+                opendir(string("/sys/class/typec/" +
+                                    string(currentPortStatus[i].portName.c_str()) +
+                                    "-partner").c_str());
+            if (dp == NULL) {
+                switchToDrp(currentPortStatus[i].portName);
+            } else {
+                closedir(dp);
+            }
+        }
+        pthread_mutex_unlock(&usb->mRoleSwitchLock);
+    }
+}
+
+static void uevent_burst_event(uint32_t /*epevents*/, struct data *payload) {
+    payload->burst->expire();
+}
+
 static void uevent_event(uint32_t /*epevents*/, struct data *payload) {
     char msg[UEVENT_MSG_LEN + 2];
-    char *cp;
+    Uevent event;
     int n;
 
     n = uevent_kernel_multicast_recv(payload->uevent_fd, msg, UEVENT_MSG_LEN);
@@ -724,42 +880,17 @@ static void uevent_event(uint32_t /*epevents*/, struct data *payload) {
 
     msg[n] = '\0';
     msg[n + 1] = '\0';
-    cp = msg;
-
-    while (*cp) {
-        if (std::regex_match(cp, std::regex("(add)(.*)(-partner)"))) {
-            ALOGI("partner added");
-            pthread_mutex_lock(&payload->usb->mPartnerLock);
-            payload->usb->mPartnerUp = true;
-            pthread_cond_signal(&payload->usb->mPartnerCV);
-            pthread_mutex_unlock(&payload->usb->mPartnerLock);
-        } else if (!strncmp(cp, "DEVTYPE=typec_", strlen("DEVTYPE=typec_")) ||
-                   !strncmp(cp, "POWER_SUPPLY_MOISTURE_DETECTED",
-                            strlen("POWER_SUPPLY_MOISTURE_DETECTED"))) {
-            std::vector<PortStatus> currentPortStatus;
-            queryVersionHelper(payload->usb, &currentPortStatus);
-
-            // Role switch is not in progress and port is in disconnected state
-            if (!pthread_mutex_trylock(&payload->usb->mRoleSwitchLock)) {
-                for (unsigned long i = 0; i < currentPortStatus.size(); i++) {
-                    DIR *dp =
-                        opendir(string("/sys/class/typec/" +
-                                            string(currentPortStatus[i].portName.c_str()) +
-                                            "-partner").c_str());
-                    if (dp == NULL) {
-                        switchToDrp(currentPortStatus[i].portName);
-                    } else {
-                        closedir(dp);
-                    }
-                }
-                pthread_mutex_unlock(&payload->usb->mRoleSwitchLock);
-            }
-            break;
-        }
-        /* advance to after the next \0 */
-        while (*cp++) {
-        }
+    parseUevent(msg, n, &event);
+
+    // Not coalesced: a role switch is waiting for it.
+    if (event.partnerAdded) {
+        ALOGI("partner added");
+        pthread_mutex_lock(&payload->usb->mPartnerLock);
+        payload->usb->mPartnerUp = true;
+        pthread_cond_signal(&payload->usb->mPartnerCV);
+        pthread_mutex_unlock(&payload->usb->mPartnerLock);
     }
+    payload->burst->add(event);
 }
 
 void *work(void *param) {
@@ -777,8 +908,23 @@ void *work(void *param) {
         return NULL;
     }
 
+    // Let the kernel drop the uevents of other devices, rather than waking up
+    // for each of them. Without the filter, uevent_event() still ignores them.
+    {
+        std::vector<UeventFilterRule> rules;
+        if (!getUeventFilterRules(&rules) ||
+            !attachUeventFilter(uevent_fd, buildUeventFilter(rules))) {
+            ALOGW("Receiving all uevents");
+        }
+    }
+
     payload.uevent_fd = uevent_fd;
     payload.usb = (::aidl::android::hardware::usb::Usb *)param;
+    payload.burst = std::make_unique<UeventBurst>(
+            kUeventBurstWindow,
+            [usb = payload.usb](const std::set<string> &ports, bool moisture, uint32_t uevents) {
+                uevent_burst_flush(usb, ports, moisture, uevents);
+            });
 
     fcntl(uevent_fd, F_SETFL, O_NONBLOCK);
 
@@ -796,6 +942,14 @@ void *work(void *param) {
         goto error;
     }
 
+    // Without the timer, the uevents are handled one by one.
+    ev.data.ptr = (void *)uevent_burst_event;
+    if (payload.burst->fd() >= 0 &&
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, payload.burst->fd(), &ev) == -1) {
+        ALOGE("uevent burst timer failed; errno=%d", errno);
+        payload.burst->disable();
+    }
+
     while (!destroyThread) {
         struct epoll_event events[64];
 
@@ -834,11 +988,13 @@ void sighandler(int sig) {
 }
 
 ScopedAStatus Usb::setCallback(const shared_ptr<IUsbCallback>& in_callback) {
-    pthread_mutex_lock(&mLock);
+    lockHelper(this);
+    // The new callback has not been sent any status yet.
+    mPortStatus.clear();
     if ((mCallback == NULL && in_callback == NULL) ||
             (mCallback != NULL && in_callback != NULL)) {
         mCallback = in_callback;
-        pthread_mutex_unlock(&mLock);
+        unlockHelper(this);
         return ScopedAStatus::ok();
     }
 
@@ -850,7 +1006,7 @@ ScopedAStatus Usb::setCallback(const shared_ptr<IUsbCallback>& in_callback) {
             pthread_join(mPoll, NULL);
             ALOGI("pthread destroyed");
         }
-        pthread_mutex_unlock(&mLock);
+        unlockHelper(this);
         return ScopedAStatus::ok();
     }
 
@@ -866,10 +1022,48 @@ ScopedAStatus Usb::setCallback(const shared_ptr<IUsbCallback>& in_callback) {
         mCallback = NULL;
     }
 
-    pthread_mutex_unlock(&mLock);
+    unlockHelper(this);
     return ScopedAStatus::ok();
 }
 
+binder_status_t Usb::dump(int fd, const char **args, uint32_t numArgs) {
+    if (fd < 0) {
+        ALOGE("Called debug() with invalid fd.");
+        return STATUS_OK;
+    }
+
+    (void)args;
+    (void)numArgs;
+
+    // Copied, so as not to hold mLock while writing to the fd.
+    lockHelper(this);
+    const auto bursts = mUeventBursts;
+    const auto lockStats = mLockStats;
+    unlockHelper(this);
+
+    auto us = [](std::chrono::steady_clock::duration d) {
+        return static_cast<int64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    };
+
+    dprintf(fd, "Uevent bursts:\n");
+    dprintf(fd, "  Window: %" PRId64 " ms\n", static_cast<int64_t>(kUeventBurstWindow.count()));
+    dprintf(fd, "  Bursts: %" PRIu64 "\n", bursts.bursts);
+    dprintf(fd, "  Uevents: %" PRIu64 "\n", bursts.uevents);
+    dprintf(fd, "  Coalesced: %" PRIu64 "\n", bursts.uevents - bursts.bursts);
+    dprintf(fd, "  Largest: %" PRIu32 "\n", bursts.largest);
+    dprintf(fd, "  Last: %" PRIu32 "\n", bursts.last);
+    dprintf(fd, "Lock:\n");
+    dprintf(fd, "  Acquired: %" PRIu64 "\n", lockStats.acquired);
+    dprintf(fd, "  Contended: %" PRIu64 "\n", lockStats.contended);
+    dprintf(fd, "  Wait: %" PRId64 " us (max %" PRId64 " us)\n", us(lockStats.totalWait),
+            us(lockStats.maxWait));
+    dprintf(fd, "  Longest hold: %" PRId64 " us\n", us(lockStats.maxHold));
+    mCallbacks.debug(fd);
+
+    return STATUS_OK;
+}
+
 } // namespace usb
 } // namespace hardware
 } // namespace android
@@ -21,6 +21,10 @@
 #include <aidl/android/hardware/usb/BnUsbCallback.h>
 #include <utils/Log.h>
 
+#include <chrono>
+
+#include "CallbackQueue.h"
+
 #define UEVENT_MSG_LEN 2048
 // The type-c stack waits for 4.5 - 5.5 secs before declaring a port non-pd.
 // The -partner directory would not be created until this is done.
@@ -68,6 +72,7 @@ struct Usb : public BnUsb {
     ScopedAStatus limitPowerTransfer(const string& in_portName, bool in_limit,
             int64_t in_transactionId) override;
     ScopedAStatus resetUsbPort(const string& in_portName, int64_t in_transactionId) override;
+    binder_status_t dump(int fd, const char **args, uint32_t numArgs) override;
 
     std::shared_ptr<::aidl::android::hardware::usb::IUsbCallback> mCallback;
     // Protects mCallback variable
@@ -82,6 +87,28 @@ struct Usb : public BnUsb {
     bool mPartnerUp;
     // Usb Data status
     bool mUsbDataEnabled;
+    // Port status last sent to the callback, which the uevents update in
+    // place. Protected by mLock.
+    std::vector<PortStatus> mPortStatus;
+    Status mPortStatusResult;
+    // Uevent bursts handled as a single update. Protected by mLock.
+    struct {
+        uint64_t bursts;
+        uint64_t uevents;
+        uint32_t largest;
+        uint32_t last;
+    } mUeventBursts;
+    // Contention on mLock, updated while holding it.
+    struct {
+        uint64_t acquired;
+        uint64_t contended;
+        std::chrono::steady_clock::duration totalWait;
+        std::chrono::steady_clock::duration maxWait;
+        std::chrono::steady_clock::duration maxHold;
+        std::chrono::steady_clock::time_point lockedAt;
+    } mLockStats;
+    // Makes the calls to mCallback, so that none is made holding mLock.
+    CallbackQueue mCallbacks;
 
   private:
     pthread_t mPoll;
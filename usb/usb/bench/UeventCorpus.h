@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string_view>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+using namespace std::string_view_literals;
+
+#define PMIC_PATH "/devices/platform/soc/c440000.qcom,spmi/spmi-0/spmi0-02/"
+#define SMB5_PATH PMIC_PATH "c440000.qcom,spmi:qcom,pm7250b@2:qcom,qpnp-smb5"
+#define USBPD_PATH PMIC_PATH "c440000.qcom,spmi:qcom,pm7250b@2:qcom,usb-pdphy@1700/usbpd0"
+#define QG_PATH PMIC_PATH "c440000.qcom,spmi:qcom,pm7250b@2:qpnp,qg"
+
+// Devices of the modeled device which the HAL listens to.
+constexpr char kCorpusTypecPort[] = USBPD_PATH "/typec/port0";
+constexpr char kCorpusUsbPowerSupply[] = SMB5_PATH "/power_supply/usb";
+
+// Synthetic uevents, written by hand after the redfin (SM7250 with a PM7250B)
+// device paths, not captured from a device. They model a phone plugged into a
+// PD charger, then into a dock, and left to charge. Messages are laid out as
+// received from the socket: NUL-separated lines, without a trailing empty
+// line. The mix follows that scenario: power_supply changes dominate, typec
+// events come in bursts around the plug events.
+static constexpr std::string_view kUeventCorpus[] = {
+    "change@" SMB5_PATH "/power_supply/battery\0"
+    "ACTION=change\0"
+    "DEVPATH=" SMB5_PATH "/power_supply/battery\0"
+    "SUBSYSTEM=power_supply\0"
+    "POWER_SUPPLY_NAME=battery\0"
+    "POWER_SUPPLY_TYPE=Battery\0"
+    "POWER_SUPPLY_INPUT_SUSPEND=0\0"
+    "POWER_SUPPLY_STATUS=Charging\0"
+    "POWER_SUPPLY_CHARGE_TYPE=Fast\0"
+    "POWER_SUPPLY_HEALTH=Good\0"
+    "POWER_SUPPLY_PRESENT=1\0"
+    "POWER_SUPPLY_CHARGER_TEMP=402\0"
+    "POWER_SUPPLY_CHARGER_TEMP_MAX=800\0"
+    "POWER_SUPPLY_INPUT_CURRENT_LIMITED=0\0"
+    "POWER_SUPPLY_VOLTAGE_NOW=4012000\0"
+    "POWER_SUPPLY_VOLTAGE_MAX=4450000\0"
+    "POWER_SUPPLY_CURRENT_NOW=-1843000\0"
+    "POWER_SUPPLY_CURRENT_MAX=3000000\0"
+    "POWER_SUPPLY_CAPACITY=61\0"
+    "POWER_SUPPLY_TEMP=298\0"
+    "POWER_SUPPLY_TECHNOLOGY=Li-ion\0"
+    "POWER_SUPPLY_STEP_CHARGING_ENABLED=1\0"
+    "POWER_SUPPLY_SW_JEITA_ENABLED=1\0"
+    "POWER_SUPPLY_CHARGE_DONE=0\0"
+    "POWER_SUPPLY_PARALLEL_DISABLE=1\0"
+    "POWER_SUPPLY_SET_SHIP_MODE=0\0"
+    "POWER_SUPPLY_DIE_HEALTH=Cool\0"
+    "POWER_SUPPLY_RERUN_AICL=0\0"
+    "POWER_SUPPLY_DP_DM=0\0"
+    "POWER_SUPPLY_CHARGE_CONTROL_LIMIT_MAX=13\0"
+    "POWER_SUPPLY_CHARGE_CONTROL_LIMIT=0\0"
+    "POWER_SUPPLY_CHARGE_COUNTER=2450000\0"
+    "POWER_SUPPLY_CYCLE_COUNT=84\0"
+    "POWER_SUPPLY_RECHARGE_SOC=98\0"
+    "POWER_SUPPLY_CHARGE_FULL=4004000\0"
+    "POWER_SUPPLY_FORCE_RECHARGE=0\0"
+    "POWER_SUPPLY_FCC_STEPPER_ENABLE=1\0"
+    "SEQNUM=52114"sv,
+    "change@" SMB5_PATH "/power_supply/usb\0"
+    "ACTION=change\0"
+    "DEVPATH=" SMB5_PATH "/power_supply/usb\0"
+    "SUBSYSTEM=power_supply\0"
+    "POWER_SUPPLY_NAME=usb\0"
+    "POWER_SUPPLY_TYPE=USB\0"
+    "POWER_SUPPLY_PRESENT=1\0"
+    "POWER_SUPPLY_ONLINE=1\0"
+    "POWER_SUPPLY_VOLTAGE_MAX=9000000\0"
+    "POWER_SUPPLY_VOLTAGE_NOW=8932000\0"
+    "POWER_SUPPLY_INPUT_CURRENT_SETTLED=2000000\0"
+    "POWER_SUPPLY_INPUT_CURRENT_NOW=1712000\0"
+    "POWER_SUPPLY_CURRENT_MAX=2000000\0"
+    "POWER_SUPPLY_TYPEC_MODE=Source attached (default current)\0"
+    "POWER_SUPPLY_TYPEC_POWER_ROLE=dual\0"
+    "POWER_SUPPLY_TYPEC_CC_ORIENTATION=1\0"
+    "POWER_SUPPLY_PD_ALLOWED=1\0"
+    "POWER_SUPPLY_PD_ACTIVE=1\0"
+    "POWER_SUPPLY_PD_CURRENT_MAX=2000000\0"
+    "POWER_SUPPLY_PD_VOLTAGE_MAX=9000000\0"
+    "POWER_SUPPLY_PD_VOLTAGE_MIN=9000000\0"
+    "POWER_SUPPLY_REAL_TYPE=USB_PD\0"
+    "POWER_SUPPLY_CONNECTOR_TYPE=0\0"
+    "POWER_SUPPLY_MOISTURE_DETECTED=0\0"
+    "POWER_SUPPLY_SCOPE=Unknown\0"
+    "SEQNUM=52115"sv,
+    "change@" QG_PATH "/power_supply/bms\0"
+    "ACTION=change\0"
+    "DEVPATH=" QG_PATH "/power_supply/bms\0"
+    "SUBSYSTEM=power_supply\0"
+    "POWER_SUPPLY_NAME=bms\0"
+    "POWER_SUPPLY_TYPE=BMS\0"
+    "POWER_SUPPLY_CAPACITY=61\0"
+    "POWER_SUPPLY_CAPACITY_RAW=15728\0"
+    "POWER_SUPPLY_TEMP=298\0"
+    "POWER_SUPPLY_VOLTAGE_NOW=4012000\0"
+    "POWER_SUPPLY_VOLTAGE_OCV=3954000\0"
+    "POWER_SUPPLY_CURRENT_NOW=-1843000\0"
+    "POWER_SUPPLY_RESISTANCE_ID=100000\0"
+    "POWER_SUPPLY_RESISTANCE=152000\0"
+    "POWER_SUPPLY_BATTERY_TYPE=redfin_4080mah\0"
+    "POWER_SUPPLY_CHARGE_FULL_DESIGN=4080000\0"
+    "POWER_SUPPLY_CYCLE_COUNT=84\0"
+    "POWER_SUPPLY_SOC_REPORTING_READY=1\0"
+    "POWER_SUPPLY_TIME_TO_FULL_AVG=3120\0"
+    "POWER_SUPPLY_TIME_TO_EMPTY_AVG=0\0"
+    "SEQNUM=52116"sv,
+    "change@/devices/virtual/thermal/thermal_zone48\0"
+    "ACTION=change\0"
+    "DEVPATH=/devices/virtual/thermal/thermal_zone48\0"
+    "SUBSYSTEM=thermal\0"
+    "NAME=usb_pwr_therm2\0"
+    "TEMP=41200\0"
+    "TRIP=0\0"
+    "SEQNUM=52117"sv,
+    "change@/devices/platform/soc/3d00000.qcom,kgsl-3d0/kgsl/kgsl-3d0\0"
+    "ACTION=change\0"
+    "DEVPATH=/devices/platform/soc/3d00000.qcom,kgsl-3d0/kgsl/kgsl-3d0\0"
+    "SUBSYSTEM=kgsl\0"
+    "PWRLEVEL=5\0"
+    "FREQ=257000000\0"
+    "SEQNUM=52118"sv,
+    "change@" USBPD_PATH "/typec/port0\0"
+    "ACTION=change\0"
+    "DEVPATH=" USBPD_PATH "/typec/port0\0"
+    "SUBSYSTEM=typec\0"
+    "DEVTYPE=typec_port\0"
+    "TYPEC_PORT=port0\0"
+    "SEQNUM=52119"sv,
+    "add@" USBPD_PATH "/typec/port0/port0-partner\0"
+    "ACTION=add\0"
+    "DEVPATH=" USBPD_PATH "/typec/port0/port0-partner\0"
+    "SUBSYSTEM=typec\0"
+    "DEVTYPE=typec_partner\0"
+    "SEQNUM=52120"sv,
+    "change@/devices/virtual/android_usb/android0\0"
+    "ACTION=change\0"
+    "DEVPATH=/devices/virtual/android_usb/android0\0"
+    "SUBSYSTEM=android_usb\0"
+    "USB_STATE=CONFIGURED\0"
+    "SEQNUM=52121"sv,
+    "add@/devices/platform/soc/a600000.ssusb/a600000.dwc3/xhci-hcd.0.auto/usb1/1-1\0"
+    "ACTION=add\0"
+    "DEVPATH=/devices/platform/soc/a600000.ssusb/a600000.dwc3/xhci-hcd.0.auto/usb1/1-1\0"
+    "SUBSYSTEM=usb\0"
+    "MAJOR=189\0"
+    "MINOR=1\0"
+    "DEVNAME=bus/usb/001/002\0"
+    "DEVTYPE=usb_device\0"
+    "PRODUCT=bda/5411/101\0"
+    "TYPE=9/0/2\0"
+    "BUSNUM=001\0"
+    "DEVNUM=002\0"
+    "SEQNUM=52122"sv,
+    "change@" USBPD_PATH "/typec/port0\0"
+    "ACTION=change\0"
+    "DEVPATH=" USBPD_PATH "/typec/port0\0"
+    "SUBSYSTEM=typec\0"
+    "DEVTYPE=typec_port\0"
+    "TYPEC_PORT=port0\0"
+    "SEQNUM=52123"sv,
+    "remove@" USBPD_PATH "/typec/port0/port0-partner\0"
+    "ACTION=remove\0"
+    "DEVPATH=" USBPD_PATH "/typec/port0/port0-partner\0"
+    "SUBSYSTEM=typec\0"
+    "DEVTYPE=typec_partner\0"
+    "SEQNUM=52124"sv,
+    "change@/devices/virtual/misc/ion\0"
+    "ACTION=change\0"
+    "DEVPATH=/devices/virtual/misc/ion\0"
+    "SUBSYSTEM=misc\0"
+    "SEQNUM=52125"sv,
+};
+
+#undef QG_PATH
+#undef USBPD_PATH
+#undef SMB5_PATH
+#undef PMIC_PATH
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "benchmark/benchmark.h"
+
+#include <string.h>
+
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "UeventCorpus.h"
+#include "UeventParser.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+// The corpus as uevent_event() sees it: each message followed by two NULs.
+static std::vector<std::string> corpusMessages() {
+    std::vector<std::string> messages;
+    for (auto uevent : kUeventCorpus) {
+        messages.emplace_back(uevent);
+        messages.back().append(2, '\0');
+    }
+    return messages;
+}
+
+static size_t corpusBytes() {
+    size_t bytes = 0;
+    for (auto uevent : kUeventCorpus) {
+        bytes += uevent.size();
+    }
+    return bytes;
+}
+
+// The matching uevent_event() used to do: a regex built and run per line.
+static void UeventBench_regex(benchmark::State &state) {
+    const auto messages = corpusMessages();
+
+    for (auto _ : state) {
+        for (const auto &msg : messages) {
+            const char *cp = msg.data();
+            bool partnerAdded = false, query = false;
+
+            while (*cp) {
+                if (std::regex_match(cp, std::regex("(add)(.*)(-partner)"))) {
+                    partnerAdded = true;
+                } else if (!strncmp(cp, "DEVTYPE=typec_", strlen("DEVTYPE=typec_")) ||
+                           !strncmp(cp, "POWER_SUPPLY_MOISTURE_DETECTED",
+                                    strlen("POWER_SUPPLY_MOISTURE_DETECTED"))) {
+                    query = true;
+                    break;
+                }
+                while (*cp++) {
+                }
+            }
+            benchmark::DoNotOptimize(partnerAdded);
+            benchmark::DoNotOptimize(query);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * messages.size());
+    state.SetBytesProcessed(state.iterations() * corpusBytes());
+}
+BENCHMARK(UeventBench_regex);
+
+static void UeventBench_parse(benchmark::State &state) {
+    const auto messages = corpusMessages();
+    Uevent event;
+
+    for (auto _ : state) {
+        for (const auto &msg : messages) {
+            parseUevent(msg.data(), msg.size() - 2, &event);
+            benchmark::DoNotOptimize(event.partnerAdded);
+            benchmark::DoNotOptimize(event.isTypec() || event.hasMoisture);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * messages.size());
+    state.SetBytesProcessed(state.iterations() * corpusBytes());
+}
+BENCHMARK(UeventBench_parse);
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
+
+BENCHMARK_MAIN();
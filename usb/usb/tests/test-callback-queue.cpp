@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <vector>
+
+#include "CallbackQueue.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+using namespace std::chrono_literals;
+
+// Records the callbacks run by a queue, the first of which waits for
+// release(), so that the others stay queued meanwhile.
+class CallbackQueueTest : public ::testing::Test {
+  protected:
+    void hold(CallbackQueue *queue) {
+        std::promise<void> started;
+        queue->post([this, &started] {
+            started.set_value();
+            mRelease.get_future().wait();
+        });
+        started.get_future().wait();
+    }
+
+    void release() { mRelease.set_value(); }
+
+    CallbackQueue::Callback record(int value) {
+        return [this, value] {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mRun.push_back(value);
+            mRan.notify_all();
+        };
+    }
+
+    std::vector<int> wait(size_t count) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        EXPECT_TRUE(mRan.wait_for(lock, 5s, [&] { return mRun.size() >= count; }));
+        return mRun;
+    }
+
+  private:
+    std::promise<void> mRelease;
+    std::mutex mMutex;
+    std::condition_variable mRan;
+    std::vector<int> mRun;
+};
+
+TEST_F(CallbackQueueTest, post_runsInOrder) {
+    CallbackQueue queue(4);
+
+    hold(&queue);
+    queue.post(record(1));
+    queue.post(record(2));
+    queue.post(record(3));
+    release();
+    EXPECT_EQ((std::vector<int>{1, 2, 3}), wait(3));
+}
+
+TEST_F(CallbackQueueTest, post_supersededMovesToTail) {
+    CallbackQueue queue(4);
+
+    hold(&queue);
+    queue.post(record(1), 7);
+    queue.post(record(2));
+    queue.post(record(3), 7);
+    queue.post(record(4), 8);
+    release();
+    EXPECT_EQ((std::vector<int>{2, 3, 4}), wait(3));
+}
+
+TEST_F(CallbackQueueTest, post_interleavedKeysKeepPostOrder) {
+    CallbackQueue queue(8);
+
+    hold(&queue);
+    queue.post(record(1), 7);
+    queue.post(record(2));
+    queue.post(record(3), 8);
+    queue.post(record(4));
+    queue.post(record(5), 7);
+    queue.post(record(6));
+    queue.post(record(7), 8);
+    release();
+    EXPECT_EQ((std::vector<int>{2, 4, 5, 6, 7}), wait(5));
+}
+
+TEST_F(CallbackQueueTest, post_blocksWhenFull) {
+    CallbackQueue queue(2);
+
+    hold(&queue);
+    queue.post(record(1));
+    queue.post(record(2));
+    // Keyed callbacks do not count against the capacity.
+    queue.post(record(3), 1);
+
+    auto posted = std::async(std::launch::async, [&] { queue.post(record(4)); });
+    EXPECT_EQ(std::future_status::timeout, posted.wait_for(50ms));
+    release();
+    EXPECT_EQ(std::future_status::ready, posted.wait_for(5s));
+    EXPECT_EQ((std::vector<int>{1, 2, 3, 4}), wait(4));
+}
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <map>
+
+#include "PortStatusUpdate.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+// Serves the roles of the registered ports, and records what is read.
+class PortStatusUpdateTest : public ::testing::Test {
+  protected:
+    PortStatusReader reader() {
+        return {
+                .scan =
+                        [this](std::vector<PortStatus> *portStatus) {
+                            mScans++;
+                            for (const auto &port : mPorts) {
+                                portStatus->push_back(status(port.first));
+                            }
+                            return Status::SUCCESS;
+                        },
+                .exists = [this](const std::string &portName) { return mPorts.count(portName); },
+                .readRoles =
+                        [this](const std::string &portName, PortStatus *portStatus) {
+                            mReads++;
+                            if (!mPorts.count(portName)) {
+                                return Status::ERROR;
+                            }
+                            *portStatus = status(portName);
+                            return Status::SUCCESS;
+                        },
+                .readPowerTransfer = [](std::vector<PortStatus> *) {},
+                .readMoisture = [this](std::vector<PortStatus> *) { mMoistureReads++; },
+        };
+    }
+
+    PortStatus status(const std::string &portName) {
+        PortStatus portStatus;
+        portStatus.portName = portName;
+        portStatus.currentPowerRole = mPorts[portName];
+        return portStatus;
+    }
+
+    // The status reported last, which the framework is only notified of
+    // again when it differs.
+    std::vector<PortStatus> cached() {
+        std::vector<PortStatus> portStatus;
+        EXPECT_EQ(Status::SUCCESS, reader().scan(&portStatus));
+        mScans = 0;
+        return portStatus;
+    }
+
+    std::map<std::string, PortPowerRole> mPorts{{"port0", PortPowerRole::SINK}};
+    uint32_t mScans{0};
+    uint32_t mReads{0};
+    uint32_t mMoistureReads{0};
+};
+
+TEST_F(PortStatusUpdateTest, portAdded_rescans) {
+    const std::vector<PortStatus> reported = cached();
+    std::vector<PortStatus> portStatus = reported;
+
+    mPorts["port1"] = PortPowerRole::NONE;
+    EXPECT_EQ(Status::SUCCESS, updatePortStatus(reader(), {"port1"}, false, &portStatus));
+
+    EXPECT_EQ(1u, mScans);
+    ASSERT_EQ(2u, portStatus.size());
+    EXPECT_EQ("port1", portStatus[1].portName);
+    EXPECT_NE(reported, portStatus);
+}
+
+TEST_F(PortStatusUpdateTest, portRemoved_rescans) {
+    mPorts["port1"] = PortPowerRole::NONE;
+    const std::vector<PortStatus> reported = cached();
+    std::vector<PortStatus> portStatus = reported;
+
+    mPorts.erase("port1");
+    EXPECT_EQ(Status::SUCCESS, updatePortStatus(reader(), {"port1"}, false, &portStatus));
+
+    EXPECT_EQ(1u, mScans);
+    EXPECT_EQ(0u, mReads);
+    ASSERT_EQ(1u, portStatus.size());
+    EXPECT_EQ("port0", portStatus[0].portName);
+    EXPECT_NE(reported, portStatus);
+}
+
+TEST_F(PortStatusUpdateTest, portUnchanged_matchesReported) {
+    const std::vector<PortStatus> reported = cached();
+    std::vector<PortStatus> portStatus = reported;
+
+    EXPECT_EQ(Status::SUCCESS, updatePortStatus(reader(), {"port0"}, false, &portStatus));
+
+    EXPECT_EQ(0u, mScans);
+    EXPECT_EQ(1u, mReads);
+    EXPECT_EQ(0u, mMoistureReads);
+    // Nothing to notify the framework of.
+    EXPECT_EQ(reported, portStatus);
+}
+
+TEST_F(PortStatusUpdateTest, roleChanged_readsOnlyThatPort) {
+    mPorts["port1"] = PortPowerRole::SINK;
+    const std::vector<PortStatus> reported = cached();
+    std::vector<PortStatus> portStatus = reported;
+
+    mPorts["port1"] = PortPowerRole::SOURCE;
+    EXPECT_EQ(Status::SUCCESS, updatePortStatus(reader(), {"port1"}, true, &portStatus));
+
+    EXPECT_EQ(0u, mScans);
+    EXPECT_EQ(1u, mReads);
+    EXPECT_EQ(1u, mMoistureReads);
+    ASSERT_EQ(2u, portStatus.size());
+    EXPECT_EQ(PortPowerRole::SINK, portStatus[0].currentPowerRole);
+    EXPECT_EQ(PortPowerRole::SOURCE, portStatus[1].currentPowerRole);
+    EXPECT_NE(reported, portStatus);
+}
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <poll.h>
+
+#include <string>
+#include <vector>
+
+#include "UeventBurst.h"
+#include "UeventCorpus.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+using namespace std::chrono_literals;
+using namespace std::string_literals;
+
+// Records the bursts flushed by the coalescer under test.
+class UeventBurstTest : public ::testing::Test {
+  protected:
+    struct Flush {
+        std::set<std::string> ports;
+        bool moisture;
+        uint32_t uevents;
+    };
+
+    UeventBurst::FlushFunction flush() {
+        return [this](const std::set<std::string> &ports, bool moisture, uint32_t uevents) {
+            mFlushes.push_back({ports, moisture, uevents});
+        };
+    }
+
+    void add(UeventBurst *burst, const std::string &uevent) {
+        Uevent event;
+        mMessage = uevent;
+        parseUevent(mMessage.data(), mMessage.size(), &event);
+        burst->add(event);
+    }
+
+    // Waits for the window of the burst to pass, as the HAL's epoll loop does.
+    static bool expired(const UeventBurst &burst, std::chrono::milliseconds timeout) {
+        struct pollfd pfd = {.fd = burst.fd(), .events = POLLIN, .revents = 0};
+        return poll(&pfd, 1, timeout.count()) == 1;
+    }
+
+    static std::string typec(const std::string &devpath, const std::string &devtype) {
+        return "change@"s + devpath + "\0ACTION=change\0DEVPATH="s + devpath +
+               "\0SUBSYSTEM=typec\0DEVTYPE="s + devtype;
+    }
+
+    static std::string moisture() {
+        return "change@"s + kCorpusUsbPowerSupply +
+               "\0ACTION=change\0SUBSYSTEM=power_supply\0POWER_SUPPLY_NAME=usb"
+               "\0POWER_SUPPLY_MOISTURE_DETECTED=1"s;
+    }
+
+    std::string mMessage;
+    std::vector<Flush> mFlushes;
+};
+
+TEST_F(UeventBurstTest, burst_flushesOnce) {
+    UeventBurst burst(100ms, flush());
+    const std::string port0 = kCorpusTypecPort;
+    const std::string port1 = port0.substr(0, port0.size() - 1) + "1";
+
+    ASSERT_GE(burst.fd(), 0);
+    add(&burst, typec(port0, "typec_port"));
+    add(&burst, typec(port0 + "/port0-partner", "typec_partner"));
+    add(&burst, moisture());
+    add(&burst, typec(port1, "typec_port"));
+    EXPECT_TRUE(mFlushes.empty());
+
+    ASSERT_TRUE(expired(burst, 5000ms));
+    burst.expire();
+
+    ASSERT_EQ(1u, mFlushes.size());
+    EXPECT_EQ((std::set<std::string>{"port0", "port1"}), mFlushes[0].ports);
+    EXPECT_TRUE(mFlushes[0].moisture);
+    EXPECT_EQ(4u, mFlushes[0].uevents);
+
+    // The timer is not rearmed without a new uevent.
+    EXPECT_FALSE(expired(burst, 200ms));
+}
+
+TEST_F(UeventBurstTest, eventAfterWindow_flushesAgain) {
+    UeventBurst burst(100ms, flush());
+
+    ASSERT_GE(burst.fd(), 0);
+    add(&burst, typec(kCorpusTypecPort, "typec_port"));
+    ASSERT_TRUE(expired(burst, 5000ms));
+    burst.expire();
+
+    add(&burst, moisture());
+    EXPECT_EQ(1u, mFlushes.size());
+    ASSERT_TRUE(expired(burst, 5000ms));
+    burst.expire();
+
+    ASSERT_EQ(2u, mFlushes.size());
+    EXPECT_TRUE(mFlushes[1].ports.empty());
+    EXPECT_TRUE(mFlushes[1].moisture);
+    EXPECT_EQ(1u, mFlushes[1].uevents);
+}
+
+TEST_F(UeventBurstTest, otherDevices_ignored) {
+    UeventBurst burst(100ms, flush());
+    const std::string devpath = "/devices/platform/soc/a600000.ssusb/usb1/1-1"s;
+
+    add(&burst, "add@"s + devpath + "\0ACTION=add\0DEVPATH="s + devpath +
+                        "\0SUBSYSTEM=usb\0DEVTYPE=usb_device"s);
+
+    EXPECT_FALSE(expired(burst, 200ms));
+    EXPECT_TRUE(mFlushes.empty());
+}
+
+TEST_F(UeventBurstTest, disabled_flushesEachUevent) {
+    UeventBurst burst(100ms, flush());
+
+    burst.disable();
+    add(&burst, typec(kCorpusTypecPort, "typec_port"));
+    add(&burst, moisture());
+
+    ASSERT_EQ(2u, mFlushes.size());
+    EXPECT_EQ(1u, mFlushes[0].uevents);
+    EXPECT_EQ(1u, mFlushes[1].uevents);
+}
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "UeventCorpus.h"
+#include "UeventFilter.h"
+#include "UeventParser.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+using ::testing::Test;
+
+// Replays uevents through the filter in the kernel, over a datagram socket
+// pair, so that the program is checked by the same verifier and interpreter
+// as on the uevent socket.
+class UeventFilterTest : public Test {
+  protected:
+    void SetUp() override {
+        ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, mSockets));
+        auto program = buildUeventFilter({
+                {.devpath = kCorpusTypecPort, .subtree = true},
+                {.devpath = kCorpusUsbPowerSupply, .subtree = false},
+        });
+        ASSERT_FALSE(program.empty());
+        ASSERT_TRUE(attachUeventFilter(mSockets[1], program));
+    }
+
+    void TearDown() override {
+        close(mSockets[0]);
+        close(mSockets[1]);
+    }
+
+    bool passes(std::string_view uevent) {
+        char buf[4096];
+
+        EXPECT_EQ(static_cast<ssize_t>(uevent.size()),
+                  send(mSockets[0], uevent.data(), uevent.size(), 0));
+        return recv(mSockets[1], buf, sizeof(buf), MSG_DONTWAIT) ==
+               static_cast<ssize_t>(uevent.size());
+    }
+
+    int mSockets[2];
+};
+
+// Everything uevent_event() acts on must get through, and nothing else from
+// the corpus.
+TEST_F(UeventFilterTest, replay_agreesWithParser) {
+    size_t dropped = 0;
+
+    for (auto uevent : kUeventCorpus) {
+        Uevent event;
+        parseUevent(uevent.data(), uevent.size(), &event);
+        const bool handled = event.partnerAdded || event.isTypec() || event.hasMoisture;
+        const bool passed = passes(uevent);
+
+        EXPECT_EQ(handled, passed) << event.devpath;
+        dropped += !passed;
+    }
+    EXPECT_GT(dropped, 0u);
+}
+
+TEST_F(UeventFilterTest, header_matchesDevice) {
+    const std::string port = kCorpusTypecPort;
+    const std::string usb = kCorpusUsbPowerSupply;
+    using namespace std::string_literals;
+
+    EXPECT_TRUE(passes("change@"s + port + "\0ACTION=change"s));
+    EXPECT_TRUE(passes("bind@"s + port + "/port0-partner\0ACTION=bind"s));
+    EXPECT_TRUE(passes("offline@"s + usb + "\0ACTION=offline"s));
+    // Other devices sharing a prefix.
+    EXPECT_FALSE(passes("change@"s + port + "1\0ACTION=change"s));
+    EXPECT_FALSE(passes("change@"s + usb + "_main\0ACTION=change"s));
+    EXPECT_FALSE(passes("change@"s + usb + "/extcon\0ACTION=change"s));
+    // The devpath alone is not a header.
+    EXPECT_FALSE(passes("DEVPATH="s + usb + "\0ACTION=change"s));
+    // Loads past the end must not accept, nor abort the other rules.
+    EXPECT_FALSE(passes("change@"s + usb));
+    EXPECT_FALSE(passes("add@"));
+}
+
+TEST_F(UeventFilterTest, build_rejectsLongDevpath) {
+    EXPECT_TRUE(buildUeventFilter({{.devpath = std::string(1024, 'a'), .subtree = false}})
+                        .empty());
+}
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "UeventCorpus.h"
+#include "UeventParser.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace usb {
+
+using namespace std::string_literals;
+
+// Keeps the last message alive, as the parsed fields point into it.
+class UeventParserTest : public ::testing::Test {
+  protected:
+    const Uevent &parse(std::string_view uevent) {
+        mMessage = uevent;
+        parseUevent(mMessage.data(), mMessage.size(), &mEvent);
+        return mEvent;
+    }
+
+    std::string mMessage;
+    Uevent mEvent;
+};
+
+TEST_F(UeventParserTest, typecPort_port) {
+    const Uevent event = parse("change@"s + kCorpusTypecPort + "\0ACTION=change\0DEVPATH="s +
+                               kCorpusTypecPort + "\0SUBSYSTEM=typec\0DEVTYPE=typec_port"s);
+
+    EXPECT_TRUE(event.isTypec());
+    EXPECT_EQ("port0", event.typecPort());
+}
+
+TEST_F(UeventParserTest, typecPort_partner) {
+    const std::string devpath = kCorpusTypecPort + "/port0-partner"s;
+    const Uevent event = parse("add@"s + devpath + "\0ACTION=add\0DEVPATH="s + devpath +
+                               "\0SUBSYSTEM=typec\0DEVTYPE=typec_partner"s);
+
+    EXPECT_TRUE(event.partnerAdded);
+    EXPECT_EQ("port0", event.typecPort());
+}
+
+TEST_F(UeventParserTest, partner_added) {
+    const std::string devpath = kCorpusTypecPort + "/port0-partner"s;
+    const Uevent event = parse("add@"s + devpath + "\0ACTION=add\0DEVPATH="s + devpath +
+                               "\0SUBSYSTEM=typec\0DEVTYPE=typec_partner\0SEQNUM=52120"s);
+
+    EXPECT_EQ("add", event.action);
+    EXPECT_EQ(devpath, event.devpath);
+    EXPECT_EQ("typec", event.subsystem);
+    EXPECT_EQ("typec_partner", event.devtype);
+    EXPECT_TRUE(event.partnerAdded);
+}
+
+TEST_F(UeventParserTest, partner_removed) {
+    const std::string devpath = kCorpusTypecPort + "/port0-partner"s;
+    const Uevent event = parse("remove@"s + devpath + "\0ACTION=remove\0DEVPATH="s + devpath +
+                               "\0SUBSYSTEM=typec\0DEVTYPE=typec_partner\0SEQNUM=52124"s);
+
+    EXPECT_EQ("remove", event.action);
+    EXPECT_FALSE(event.partnerAdded);
+    EXPECT_EQ("port0", event.typecPort());
+}
+
+TEST_F(UeventParserTest, partner_otherDeviceAdded) {
+    const std::string devpath = "/devices/platform/soc/a600000.ssusb/usb1/1-1"s;
+    const Uevent event = parse("add@"s + devpath + "\0ACTION=add\0DEVPATH="s + devpath +
+                               "\0SUBSYSTEM=usb\0DEVTYPE=usb_device"s);
+
+    EXPECT_EQ("add", event.action);
+    EXPECT_FALSE(event.partnerAdded);
+    EXPECT_FALSE(event.isTypec());
+}
+
+TEST_F(UeventParserTest, moisture_detected) {
+    const std::string header = "change@"s + kCorpusUsbPowerSupply +
+                               "\0ACTION=change\0SUBSYSTEM=power_supply\0POWER_SUPPLY_NAME=usb"s;
+
+    // Any value counts, as the HAL reads the value from sysfs.
+    for (auto value : {"0", "1"}) {
+        const Uevent event = parse(header + "\0POWER_SUPPLY_MOISTURE_DETECTED="s + value +
+                                   "\0POWER_SUPPLY_SCOPE=Unknown"s);
+
+        EXPECT_TRUE(event.hasMoisture) << value;
+        EXPECT_EQ("usb", event.powerSupplyName);
+    }
+
+    const Uevent event = parse(header + "\0POWER_SUPPLY_PRESENT=1"s);
+    EXPECT_FALSE(event.hasMoisture);
+    EXPECT_EQ("usb", event.powerSupplyName);
+}
+
+TEST_F(UeventParserTest, firstOccurrenceWins) {
+    const Uevent event = parse(
+            "ACTION=change\0ACTION=add\0DEVPATH=/devices/a\0DEVPATH=/devices/b\0"
+            "SUBSYSTEM=typec\0SUBSYSTEM=usb\0DEVTYPE=\0DEVTYPE=typec_port\0"
+            "POWER_SUPPLY_NAME=usb\0POWER_SUPPLY_NAME=battery"s);
+
+    EXPECT_EQ("change", event.action);
+    EXPECT_EQ("/devices/a", event.devpath);
+    EXPECT_EQ("typec", event.subsystem);
+    // An empty value is still the first occurrence.
+    EXPECT_EQ("", event.devtype);
+    EXPECT_FALSE(event.isTypec());
+    EXPECT_EQ("usb", event.powerSupplyName);
+}
+
+TEST_F(UeventParserTest, typecPort_otherDevices) {
+    for (auto uevent : kUeventCorpus) {
+        const Uevent event = parse(uevent);
+
+        EXPECT_EQ(event.isTypec(), !event.typecPort().empty()) << event.devpath;
+    }
+    // Only typec devices name a port, whatever their path.
+    EXPECT_TRUE(parse("DEVPATH=/devices/typec/port0\0DEVTYPE=usb_device"s).typecPort().empty());
+}
+
+} // namespace usb
+} // namespace hardware
+} // namespace android
+} // aidl
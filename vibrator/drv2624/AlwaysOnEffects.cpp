@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AlwaysOnEffects.h"
+
+#include <log/log.h>
+
+#include <charconv>
+#include <cinttypes>
+#include <cstring>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Stored in place of an empty table, which would read as never configured.
+static constexpr char STATE_NONE[] = "none";
+
+AlwaysOnEffects::AlwaysOnEffects(ProgramFunction program, StoreFunction store)
+    : mProgram(std::move(program)), mStore(std::move(store)) {}
+
+bool AlwaysOnEffects::restore(const std::string &state, uint32_t defaultWaveform) {
+    if (!state.empty()) {
+        if (parse(state)) {
+            mRestored = true;
+            return commit();
+        }
+        ALOGW("Ignoring always-on state \"%s\"", state.c_str());
+        mCount = 0;
+    }
+
+    // Leave the stored state alone so that the default keeps applying until
+    // the framework configures the trigger.
+    if (!mProgram(defaultWaveform)) {
+        return false;
+    }
+    mWaveform = defaultWaveform;
+    mPrograms++;
+    return true;
+}
+
+bool AlwaysOnEffects::enable(int32_t id, uint8_t waveform) {
+    auto entries = mEntries;
+    size_t count = mCount;
+    size_t index = find(id);
+
+    if (index < mCount) {
+        erase(index);
+    } else if (mCount == IDS_MAX) {
+        ALOGE("Too many always-on effects");
+        return false;
+    }
+    mEntries[mCount++] = {.id = id, .waveform = waveform};
+
+    if (!commit()) {
+        mEntries = entries;
+        mCount = count;
+        return false;
+    }
+    return true;
+}
+
+bool AlwaysOnEffects::disable(int32_t id) {
+    auto entries = mEntries;
+    size_t count = mCount;
+    size_t index = find(id);
+
+    if (index < mCount) {
+        erase(index);
+    }
+
+    if (!commit()) {
+        mEntries = entries;
+        mCount = count;
+        return false;
+    }
+    return true;
+}
+
+void AlwaysOnEffects::debug(int fd) const {
+    dprintf(fd, "Always-On:\n");
+    dprintf(fd, "  Waveform: %" PRIu32 "\n", mWaveform);
+    dprintf(fd, "  Table: %s\n", serialize().c_str());
+    dprintf(fd, "  Restored: %d, Programmed: %" PRIu32 "\n", mRestored, mPrograms);
+}
+
+bool AlwaysOnEffects::parse(const std::string &state) {
+    const char *pos = state.data();
+    const char *end = pos + state.size();
+
+    mCount = 0;
+    if (state == STATE_NONE) {
+        return true;
+    }
+
+    while (pos < end) {
+        Entry entry;
+        uint32_t waveform;
+
+        if (mCount == IDS_MAX) {
+            return false;
+        }
+        auto res = std::from_chars(pos, end, entry.id);
+        if (res.ec != std::errc() || res.ptr == end || *res.ptr != ':') {
+            return false;
+        }
+        res = std::from_chars(res.ptr + 1, end, waveform);
+        if (res.ec != std::errc() || waveform > UINT8_MAX) {
+            return false;
+        }
+        if (res.ptr != end && *res.ptr++ != ' ') {
+            return false;
+        }
+        entry.waveform = waveform;
+        mEntries[mCount++] = entry;
+        pos = res.ptr;
+    }
+
+    return true;
+}
+
+std::string AlwaysOnEffects::serialize() const {
+    std::string state;
+
+    if (!mCount) {
+        return STATE_NONE;
+    }
+    for (size_t i = 0; i < mCount; i++) {
+        if (i) {
+            state += ' ';
+        }
+        state += std::to_string(mEntries[i].id) + ':' + std::to_string(mEntries[i].waveform);
+    }
+    return state;
+}
+
+bool AlwaysOnEffects::program() {
+    uint32_t waveform = mCount ? mEntries[mCount - 1].waveform : WAVEFORM_NONE;
+
+    if (waveform != mWaveform || !mPrograms) {
+        if (!mProgram(waveform)) {
+            ALOGE("Failed to program low-power trigger (%d): %s", errno, strerror(errno));
+            return false;
+        }
+        mWaveform = waveform;
+        mPrograms++;
+    }
+    return true;
+}
+
+bool AlwaysOnEffects::commit() {
+    const uint32_t previous = mWaveform;
+    const bool programmed = mPrograms;
+
+    if (!program()) {
+        return false;
+    }
+    if (!mStore(serialize())) {
+        ALOGE("Failed to store always-on state");
+        // A restarted HAL would resume the stored table, so keep the trigger
+        // in line with it.
+        if (programmed && mWaveform != previous && mProgram(previous)) {
+            mWaveform = previous;
+            mPrograms++;
+        }
+        return false;
+    }
+    return true;
+}
+
+size_t AlwaysOnEffects::find(int32_t id) const {
+    for (size_t i = 0; i < mCount; i++) {
+        if (mEntries[i].id == id) {
+            return i;
+        }
+    }
+    return mCount;
+}
+
+void AlwaysOnEffects::erase(size_t index) {
+    for (size_t i = index + 1; i < mCount; i++) {
+        mEntries[i - 1] = mEntries[i];
+    }
+    mCount--;
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Tracks the always-on effects requested by the framework and programs the
+// DRV2624 low-power trigger, which lets the SLPI play a waveform from the
+// library while the AP stays suspended. The trigger holds a single waveform,
+// so the most recently enabled id owns it and disabling that id hands the
+// trigger back to the previous one. The table is mirrored into a string that
+// outlives the HAL process, so that a restarted HAL resumes where it left off.
+class AlwaysOnEffects {
+  public:
+    static constexpr size_t IDS_MAX = 4;
+    // Trigger value which disables the low-power trigger.
+    static constexpr uint32_t WAVEFORM_NONE = 0;
+
+    // Writes the waveform index played by the low-power trigger.
+    using ProgramFunction = std::function<bool(uint32_t waveform)>;
+    // Persists the serialized table.
+    using StoreFunction = std::function<bool(const std::string &state)>;
+
+    AlwaysOnEffects(ProgramFunction program, StoreFunction store);
+
+    // Restores a table stored by a previous instance and programs the trigger
+    // accordingly. An empty 'state' means that the framework never configured
+    // the trigger, in which case 'defaultWaveform' is programmed.
+    bool restore(const std::string &state, uint32_t defaultWaveform);
+    // Assigns 'waveform' to 'id' and hands it the trigger.
+    bool enable(int32_t id, uint8_t waveform);
+    // Removes 'id'. Unknown ids are ignored.
+    bool disable(int32_t id);
+    // Returns the waveform currently programmed into the trigger.
+    uint32_t waveform() const { return mWaveform; }
+    // Emit diagnostic information to the given file.
+    void debug(int fd) const;
+
+  private:
+    struct Entry {
+        int32_t id;
+        uint8_t waveform;
+    };
+
+    bool parse(const std::string &state);
+    std::string serialize() const;
+    // Programs the waveform of the most recent entry.
+    bool program();
+    // Programs the trigger and stores the table. The previous waveform is
+    // programmed back if the table cannot be stored.
+    bool commit();
+    size_t find(int32_t id) const;
+    void erase(size_t index);
+
+    const ProgramFunction mProgram;
+    const StoreFunction mStore;
+
+    // Ordered from the oldest to the most recently enabled id.
+    std::array<Entry, IDS_MAX> mEntries;
+    size_t mCount{0};
+    uint32_t mWaveform{WAVEFORM_NONE};
+    uint32_t mPrograms{0};
+    bool mRestored{false};
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
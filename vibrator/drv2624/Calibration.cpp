@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Calibration.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+namespace calibration {
+
+static constexpr float FLOAT_EPS = 1e-7f;
+static constexpr uint32_t NEWTON_ITERATIONS = 8;
+
+static inline bool isValidLevel(float v) {
+    return (v > FLOAT_EPS) && (v <= MAX_VOLTAGE);
+}
+
+static inline float evalCubic(const Coeffs &c, float x) {
+    return ((c[0] * x + c[1]) * x + c[2]) * x + c[3];
+}
+
+// Terms of the Shengjin formula which only depend on the coefficients.
+struct CubicTerms {
+    float a3;  // 3a
+    float AA;  // b^2 - 3ac
+    float bc;  // bc
+    float cc;  // c^2
+};
+
+static inline CubicTerms cubicTerms(const Coeffs &c) {
+    return {
+            .a3 = 3.0f * c[0],
+            .AA = c[1] * c[1] - 3.0f * c[0] * c[2],
+            .bc = c[1] * c[2],
+            .cc = c[2] * c[2],
+    };
+}
+
+// Root for the Delta > 0 case. Since cbrt() keeps the sign of its argument, the
+// four sign combinations of Y1 and Y2 reduce to a single expression. Lanes with
+// Delta <= 0 yield NaN through sqrt().
+static inline float solveDeltaPositive(const Coeffs &c, const CubicTerms &t, float targetG) {
+    const float dd = c[3] - targetG;
+    const float BB = t.bc - 9.0f * c[0] * dd;
+    const float CC = t.cc - 3.0f * c[1] * dd;
+    const float Delta = BB * BB - 4.0f * t.AA * CC;
+    const float sqrtDelta = std::sqrt(Delta > FLOAT_EPS ? Delta : NAN);
+    const float Y1 = t.AA * c[1] + t.a3 * (-BB + sqrtDelta) / 2.0f;
+    const float Y2 = t.AA * c[1] + t.a3 * (-BB - sqrtDelta) / 2.0f;
+    return (-c[1] - std::cbrt(Y1) - std::cbrt(Y2)) / t.a3;
+}
+
+// Refines a root estimate of f(x) = targetG. Used for the near-degenerate
+// branches where the closed form loses precision; starts from the middle of
+// the valid range when the estimate is unusable.
+static float refineNewton(const Coeffs &c, float targetG, float x) {
+    if (!isValidLevel(x)) {
+        x = MAX_VOLTAGE / 2.0f;
+    }
+    for (uint32_t i = 0; i < NEWTON_ITERATIONS; i++) {
+        const float f = evalCubic(c, x) - targetG;
+        const float df = (3.0f * c[0] * x + 2.0f * c[1]) * x + c[2];
+        if (std::fabs(df) <= FLOAT_EPS) {
+            break;
+        }
+        x -= f / df;
+    }
+    return isValidLevel(x) ? x : 0.0f;
+}
+
+static float solveCubic(const Coeffs &c, const CubicTerms &t, float targetG) {
+    const float dd = c[3] - targetG;
+    const float BB = t.bc - 9.0f * c[0] * dd;
+    const float CC = t.cc - 3.0f * c[1] * dd;
+    const float Delta = BB * BB - 4.0f * t.AA * CC;
+    float outPutVal;
+
+    // There are four discriminants in Shengjin formula.
+    // https://zh.wikipedia.org/wiki/%E4%B8%89%E6%AC%A1%E6%96%B9%E7%A8%8B#%E7%9B%9B%E9%87%91%E5%85%AC%E5%BC%8F%E6%B3%95
+    if ((std::fabs(t.AA) <= FLOAT_EPS) && (std::fabs(BB) <= FLOAT_EPS)) {
+        // Case 1: A = B = 0
+        return refineNewton(c, targetG, -c[1] / t.a3);
+    } else if (Delta > FLOAT_EPS) {
+        // Case 2: Delta > 0
+        return solveDeltaPositive(c, t, targetG);
+    } else if (Delta < -FLOAT_EPS) {
+        // Case 3: Delta < 0
+        const float sqrtA = std::sqrt(t.AA);
+        const float T = (2.0f * t.AA * c[1] - t.a3 * BB) / (2.0f * t.AA * sqrtA);
+        const float sita = std::acos(T);
+        const float cosSita = std::cos(sita / 3.0f);
+        const float sinSitaSqrt3 = std::sqrt(3.0f) * std::sin(sita / 3.0f);
+
+        outPutVal = (-c[1] - 2.0f * sqrtA * cosSita) / t.a3;
+        if (isValidLevel(outPutVal)) {
+            return outPutVal;
+        }
+        outPutVal = (-c[1] + sqrtA * (cosSita + sinSitaSqrt3)) / t.a3;
+        if (isValidLevel(outPutVal)) {
+            return outPutVal;
+        }
+        outPutVal = (-c[1] + sqrtA * (cosSita - sinSitaSqrt3)) / t.a3;
+        if (isValidLevel(outPutVal)) {
+            return outPutVal;
+        }
+        return 0.0f;
+    } else {
+        // Case 4: Delta = 0
+        const float K = BB / t.AA;
+        outPutVal = -c[1] / c[0] + K;
+        if (!isValidLevel(outPutVal)) {
+            outPutVal = -K / 2.0f;
+        }
+        return refineNewton(c, targetG, outPutVal);
+    }
+}
+
+// LRA period to od_clamp divisor, see convertLevelsToOdClamp().
+static inline float odClampDivisor(uint32_t lraPeriod) {
+    return (21.32f / 1000.0f) *
+           std::sqrt(1.0f - (static_cast<float>(freqPeriodFormula(lraPeriod)) * 8.0f / 10000.0f));
+}
+
+uint32_t freqPeriodFormula(uint32_t in) {
+    return 1000000000 / (24615 * in);
+}
+
+uint32_t frequencyToPeriod(float freqHz) {
+    return std::round(1000000000.0f / (24615.0f * freqHz));
+}
+
+float targetGToVLevelsLinear(const Coeffs &coeffs, float targetG) {
+    // Implement linear equation to get voltage levels, f(x) = ax + b
+    // 0 to 3.2 is our valid output
+    const float outPutVal = (targetG - coeffs[1]) / coeffs[0];
+    return isValidLevel(outPutVal) ? outPutVal : 0.0f;
+}
+
+float targetGToVLevelsCubic(const Coeffs &coeffs, float targetG) {
+    // Implement cubic equation to get voltage levels, f(x) = ax^3 + bx^2 + cx + d
+    // 0 to 3.2 is our valid output
+    return solveCubic(coeffs, cubicTerms(coeffs), targetG);
+}
+
+float vLevelsToTargetGCubic(const Coeffs &coeffs, float vLevel) {
+    return evalCubic(coeffs, vLevel * MAX_VOLTAGE);
+}
+
+uint32_t convertLevelsToOdClamp(float vLevel, uint32_t lraPeriod) {
+    return std::round(vLevel / odClampDivisor(lraPeriod));
+}
+
+bool renderStrength(const Coeffs &coeffs, float targetG, uint32_t lraPeriod, uint32_t odClampMax,
+                    uint8_t *scale, uint32_t *odClamp) {
+    // Same model selection as the effect od_clamp levels.
+    const bool linear = (coeffs[2] == 0) && (coeffs[3] == 0);
+    const float vLevel = linear ? targetGToVLevelsLinear(coeffs, targetG)
+                                : targetGToVLevelsCubic(coeffs, targetG);
+
+    if (vLevel <= 0.0f) {
+        return false;
+    }
+    for (int step = std::min<int>(*scale, SCALE_GAINS.size() - 1); step >= 0; step--) {
+        const uint32_t value = convertLevelsToOdClamp(vLevel / SCALE_GAINS[step], lraPeriod);
+        if (value > 0 && value <= odClampMax) {
+            *scale = step;
+            *odClamp = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+void targetGToVLevelsLinear(const Coeffs &coeffs, const float *targetG, float *vLevels,
+                            size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const float outPutVal = (targetG[i] - coeffs[1]) / coeffs[0];
+        vLevels[i] = isValidLevel(outPutVal) ? outPutVal : 0.0f;
+    }
+}
+
+void targetGToVLevelsCubic(const Coeffs &coeffs, const float *targetG, float *vLevels,
+                           size_t count) {
+    const CubicTerms terms = cubicTerms(coeffs);
+
+    // Calibrated curves are monotonic over the valid range, so Delta > 0 is the
+    // common case. Solve it branch-free for every lane first...
+    for (size_t i = 0; i < count; i++) {
+        vLevels[i] = solveDeltaPositive(coeffs, terms, targetG[i]);
+    }
+    // ...then fall back to the full solver for lanes it could not handle.
+    for (size_t i = 0; i < count; i++) {
+        if (std::isnan(vLevels[i])) {
+            vLevels[i] = solveCubic(coeffs, terms, targetG[i]);
+        }
+    }
+}
+
+void convertLevelsToOdClamp(const float *vLevels, uint32_t lraPeriod, uint32_t *odClamps,
+                            size_t count) {
+    const float divisor = odClampDivisor(lraPeriod);
+
+    for (size_t i = 0; i < count; i++) {
+        odClamps[i] = std::round(vLevels[i] / divisor);
+    }
+}
+
+}  // namespace calibration
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+namespace calibration {
+
+// Voltage levels are valid within (0, MAX_VOLTAGE].
+constexpr float MAX_VOLTAGE = 3.2f;
+
+// Coefficients {a, b, c, d} of the G-over-voltage curve
+// f(x) = ax^3 + bx^2 + cx + d, or f(x) = ax + b for the linear model.
+using Coeffs = std::array<float, 4>;
+
+// Converts between an LRA period and its resonant frequency in Hz.
+uint32_t freqPeriodFormula(uint32_t in);
+// Converts a fractional frequency in Hz to the nearest LRA period.
+uint32_t frequencyToPeriod(float freqHz);
+
+// Single-target solvers. These return 0 when no valid voltage level exists.
+float targetGToVLevelsLinear(const Coeffs &coeffs, float targetG);
+float targetGToVLevelsCubic(const Coeffs &coeffs, float targetG);
+// Evaluates the cubic model at vLevel, a fraction of MAX_VOLTAGE.
+float vLevelsToTargetGCubic(const Coeffs &coeffs, float vLevel);
+uint32_t convertLevelsToOdClamp(float vLevel, uint32_t lraPeriod);
+
+// Amplitude left by each value of the scale register, see HwApi::setScale().
+constexpr std::array<float, 4> SCALE_GAINS = {1.0f, 0.75f, 0.5f, 0.25f};
+
+// Picks register values which play an effect at 'targetG': the voltage from
+// the G curve is divided by the gain of '*scale' and converted to od_clamp.
+// When that exceeds 'odClampMax', the scale is stepped up towards full
+// amplitude. Returns false, leaving the outputs untouched, when no valid
+// voltage exists or even full scale needs more than 'odClampMax'.
+bool renderStrength(const Coeffs &coeffs, float targetG, uint32_t lraPeriod, uint32_t odClampMax,
+                    uint8_t *scale, uint32_t *odClamp);
+
+// Batch solvers over 'count' contiguous targets. Terms which only depend on
+// the coefficients or the LRA period are computed once per call, and the
+// per-target loops are kept free of cross-lane dependencies so that they
+// vectorize.
+void targetGToVLevelsLinear(const Coeffs &coeffs, const float *targetG, float *vLevels,
+                            size_t count);
+void targetGToVLevelsCubic(const Coeffs &coeffs, const float *targetG, float *vLevels,
+                           size_t count);
+void convertLevelsToOdClamp(const float *vLevels, uint32_t lraPeriod, uint32_t *odClamps,
+                            size_t count);
+
+}  // namespace calibration
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CalibrationSnapshot.h"
+
+#include <fcntl.h>
+#include <log/log.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utils/Trace.h>
+
+#include <charconv>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+static_assert(std::is_trivially_copyable_v<CalibrationSnapshot::Data>);
+
+static constexpr uint32_t CACHE_MAGIC = 0x53433244;  // "D2CS"
+static constexpr uint32_t CACHE_VERSION = 1;
+
+// Identifies the text file a binary copy was made from.
+struct CacheKey {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtimeNs;
+    int64_t size;
+};
+
+struct CacheFile {
+    uint32_t magic;
+    uint32_t version;
+    CacheKey key;
+    uint32_t checksum;
+    uint32_t dataSize;
+    CalibrationSnapshot::Data data;
+};
+
+static CacheKey cacheKey(const struct stat &st) {
+    return {
+            .dev = static_cast<uint64_t>(st.st_dev),
+            .ino = static_cast<uint64_t>(st.st_ino),
+            .mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec,
+            .size = static_cast<int64_t>(st.st_size),
+    };
+}
+
+static bool operator==(const CacheKey &a, const CacheKey &b) {
+    return a.dev == b.dev && a.ino == b.ino && a.mtimeNs == b.mtimeNs && a.size == b.size;
+}
+
+// FNV-1a, only meant to catch torn or stale writes.
+static uint32_t checksum(const CalibrationSnapshot::Data &data) {
+    const auto *bytes = reinterpret_cast<const uint8_t *>(&data);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(data); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool readCache(const std::string &path, const CacheKey &key,
+                      CalibrationSnapshot::Data *data) {
+    CacheFile file;
+    int fd = TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t len = TEMP_FAILURE_RETRY(read(fd, &file, sizeof(file)));
+    close(fd);
+
+    if (len != sizeof(file) || file.magic != CACHE_MAGIC || file.version != CACHE_VERSION ||
+        file.dataSize != sizeof(file.data) || !(file.key == key) ||
+        file.checksum != checksum(file.data)) {
+        return false;
+    }
+    *data = file.data;
+    return true;
+}
+
+// Replaces the binary copy atomically, so that readers never see a partial one.
+static void writeCache(const std::string &path, const CacheKey &key,
+                       const CalibrationSnapshot::Data &data) {
+    const std::string temp = path + ".tmp";
+    CacheFile file{};
+    file.magic = CACHE_MAGIC;
+    file.version = CACHE_VERSION;
+    file.key = key;
+    file.checksum = checksum(data);
+    file.dataSize = sizeof(data);
+    file.data = data;
+
+    int fd = TEMP_FAILURE_RETRY(open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600));
+    if (fd < 0) {
+        ALOGW("Failed to create %s (%d): %s", temp.c_str(), errno, strerror(errno));
+        return;
+    }
+    ssize_t len = TEMP_FAILURE_RETRY(write(fd, &file, sizeof(file)));
+    close(fd);
+    if (len != sizeof(file) || rename(temp.c_str(), path.c_str())) {
+        ALOGW("Failed to write %s (%d): %s", path.c_str(), errno, strerror(errno));
+        unlink(temp.c_str());
+    }
+}
+
+static bool readText(int fd, size_t size, std::string *text) {
+    text->resize(size);
+    size_t offset = 0;
+    while (offset < size) {
+        ssize_t len = TEMP_FAILURE_RETRY(read(fd, &(*text)[offset], size - offset));
+        if (len <= 0) {
+            return false;
+        }
+        offset += len;
+    }
+    return true;
+}
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static std::string_view trim(std::string_view s) {
+    while (!s.empty() && isBlank(s.front())) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && isBlank(s.back())) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+static bool parseValue(std::string_view s, uint32_t *value) {
+    auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), *value);
+    return ec == std::errc() && end == s.data() + s.size();
+}
+
+// The values are separated by blanks and must fill the array exactly. strtof()
+// is used since floating point from_chars() is not available everywhere; the
+// text is NUL-terminated, and every value is checked to start within 's'.
+template <size_t N>
+static bool parseValue(std::string_view s, std::array<float, N> *value) {
+    const char *pos = s.data();
+    const char *const end = s.data() + s.size();
+    for (auto &v : *value) {
+        while (pos < end && isBlank(*pos)) {
+            pos++;
+        }
+        if (pos == end) {
+            return false;
+        }
+        char *next;
+        v = std::strtof(pos, &next);
+        if (next == pos || next > end) {
+            return false;
+        }
+        pos = next;
+    }
+    return pos == end;
+}
+
+static bool parseValue(std::string_view s, float *value) {
+    std::array<float, 1> array;
+    if (!parseValue(s, &array)) {
+        return false;
+    }
+    *value = array[0];
+    return true;
+}
+
+static bool parseValue(std::string_view s, char (*value)[CalibrationSnapshot::AUTOCAL_MAX]) {
+    if (s.size() >= sizeof(*value)) {
+        return false;
+    }
+    std::memcpy(*value, s.data(), s.size());
+    (*value)[s.size()] = '\0';
+    return true;
+}
+
+template <typename T>
+static void parseField(std::string_view key, std::string_view value, const char *name,
+                       CalibrationSnapshot::Field field, T *out,
+                       CalibrationSnapshot::Data *data) {
+    if (key != name) {
+        return;
+    }
+    if (parseValue(value, out)) {
+        data->fields |= field;
+    } else {
+        data->fields &= ~field;
+        ALOGE("Invalid %s config!", name);
+    }
+}
+
+CalibrationSnapshot::Data CalibrationSnapshot::parse(const std::string &text) {
+    Data data{};
+    std::string_view rest = text;
+
+    while (!rest.empty()) {
+        size_t eol = rest.find('\n');
+        std::string_view line = rest.substr(0, eol);
+        rest.remove_prefix(eol == std::string_view::npos ? rest.size() : eol + 1);
+
+        size_t colon = line.find(':');
+        if (line.empty() || line[0] == '#' || colon == std::string_view::npos) {
+            continue;
+        }
+        std::string_view key = trim(line.substr(0, colon));
+        std::string_view value = trim(line.substr(colon + 1));
+
+        parseField(key, value, "autocal", AUTOCAL, &data.autocal, &data);
+        parseField(key, value, "lra_period", LRA_PERIOD, &data.lraPeriod, &data);
+        parseField(key, value, "haptic_coefficient", EFFECT_COEFFS, &data.effectCoeffs, &data);
+        parseField(key, value, "haptic_target_G", EFFECT_TARGET_G, &data.effectTargetG, &data);
+        parseField(key, value, "vibration_amp_max", STEADY_AMP_MAX, &data.steadyAmpMax, &data);
+        parseField(key, value, "vibration_coefficient", STEADY_COEFFS, &data.steadyCoeffs, &data);
+        parseField(key, value, "vibration_target_G", STEADY_TARGET_G, &data.steadyTargetG, &data);
+        parseField(key, value, "q_factor", Q_FACTOR, &data.qFactor, &data);
+    }
+
+    return data;
+}
+
+CalibrationSnapshot CalibrationSnapshot::load(const std::string &path,
+                                              const std::string &cachePath) {
+    ATRACE_NAME("CalibrationSnapshot::load");
+    CalibrationSnapshot snapshot;
+    struct stat st;
+    std::string text;
+
+    snapshot.mPath = path;
+
+    if (path.empty()) {
+        return snapshot;
+    }
+    int fd = TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        ALOGW("Failed to open calibration %s (%d): %s", path.c_str(), errno, strerror(errno));
+        return snapshot;
+    }
+    if (fstat(fd, &st)) {
+        ALOGE("Failed to stat calibration (%d): %s", errno, strerror(errno));
+        close(fd);
+        return snapshot;
+    }
+
+    const CacheKey key = cacheKey(st);
+    if (!cachePath.empty() && readCache(cachePath, key, &snapshot.mData)) {
+        snapshot.mSource = Source::CACHE;
+    } else if (readText(fd, st.st_size, &text)) {
+        snapshot.mData = parse(text);
+        snapshot.mSource = Source::TEXT;
+        if (!cachePath.empty()) {
+            writeCache(cachePath, key, snapshot.mData);
+        }
+    } else {
+        ALOGE("Failed to read calibration (%d): %s", errno, strerror(errno));
+    }
+
+    close(fd);
+    return snapshot;
+}
+
+template <size_t N>
+static void dumpArray(int fd, const char *name, const std::array<float, N> &values) {
+    dprintf(fd, "    %s:", name);
+    for (auto v : values) {
+        dprintf(fd, " %g", v);
+    }
+    dprintf(fd, "\n");
+}
+
+void CalibrationSnapshot::debug(int fd) const {
+    static constexpr const char *SOURCES[] = {"missing", "text", "cache"};
+
+    dprintf(fd, "Persist:\n");
+    dprintf(fd, "  %s (%s):\n", mPath.c_str(), SOURCES[static_cast<size_t>(mSource)]);
+    if (has(AUTOCAL)) {
+        dprintf(fd, "    autocal: %s\n", mData.autocal);
+    }
+    if (has(LRA_PERIOD)) {
+        dprintf(fd, "    lra_period: %" PRIu32 "\n", mData.lraPeriod);
+    }
+    if (has(EFFECT_COEFFS)) {
+        dumpArray(fd, "haptic_coefficient", mData.effectCoeffs);
+    }
+    if (has(EFFECT_TARGET_G)) {
+        dumpArray(fd, "haptic_target_G", mData.effectTargetG);
+    }
+    if (has(STEADY_AMP_MAX)) {
+        dprintf(fd, "    vibration_amp_max: %g\n", mData.steadyAmpMax);
+    }
+    if (has(STEADY_COEFFS)) {
+        dumpArray(fd, "vibration_coefficient", mData.steadyCoeffs);
+    }
+    if (has(STEADY_TARGET_G)) {
+        dumpArray(fd, "vibration_target_G", mData.steadyTargetG);
+    }
+    if (has(Q_FACTOR)) {
+        dprintf(fd, "    q_factor: %g\n", mData.qFactor);
+    }
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
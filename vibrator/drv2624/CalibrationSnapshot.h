@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// The persisted factory calibration, parsed once into a fixed layout. The
+// parsed values are also kept in a binary copy keyed by the identity and
+// modification time of the text file, so that later HAL starts only validate
+// and copy them.
+class CalibrationSnapshot {
+  public:
+    enum Field : uint32_t {
+        AUTOCAL = 1u << 0,
+        LRA_PERIOD = 1u << 1,
+        EFFECT_COEFFS = 1u << 2,
+        EFFECT_TARGET_G = 1u << 3,
+        STEADY_AMP_MAX = 1u << 4,
+        STEADY_COEFFS = 1u << 5,
+        STEADY_TARGET_G = 1u << 6,
+        Q_FACTOR = 1u << 7,
+    };
+
+    enum class Source {
+        MISSING,
+        TEXT,
+        CACHE,
+    };
+
+    static constexpr size_t AUTOCAL_MAX = 64;
+
+    // Trivially copyable, so that it is stored as is.
+    struct Data {
+        // Mask of the valid fields.
+        uint32_t fields;
+        uint32_t lraPeriod;
+        std::array<float, 4> effectCoeffs;
+        std::array<float, 5> effectTargetG;
+        float steadyAmpMax;
+        std::array<float, 4> steadyCoeffs;
+        std::array<float, 3> steadyTargetG;
+        float qFactor;
+        // NUL-terminated.
+        char autocal[AUTOCAL_MAX];
+    };
+
+    CalibrationSnapshot() = default;
+
+    // Loads the calibration at 'path'. The binary copy at 'cachePath' is used
+    // when it matches the file and rewritten otherwise. An empty 'cachePath'
+    // disables the copy.
+    static CalibrationSnapshot load(const std::string &path, const std::string &cachePath);
+    // Parses one "key: values" pair per line. Unknown keys are ignored and
+    // malformed values leave their field unset.
+    static Data parse(const std::string &text);
+
+    bool has(Field field) const { return mData.fields & field; }
+    const Data &data() const { return mData; }
+    Source source() const { return mSource; }
+    // Emit diagnostic information to the given file.
+    void debug(int fd) const;
+
+  private:
+    Data mData{};
+    Source mSource{Source::MISSING};
+    std::string mPath;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
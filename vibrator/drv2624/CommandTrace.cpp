@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CommandTrace.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Indexed by Api.
+static constexpr const char *API_NAMES[] = {
+        "on",
+        "off",
+        "setAmplitude",
+        "perform",
+        "compose",
+        "compositionStep",
+        "composePwle",
+        "alwaysOnEnable",
+        "alwaysOnDisable",
+};
+
+// Indexed by Node.
+static constexpr const char *NODE_NAMES[] = {
+        "autocal",
+        "ol_lra_period",
+        "activate",
+        "duration",
+        "state",
+        "rtp_input",
+        "mode",
+        "set_sequencer",
+        "scale",
+        "ctrl_loop",
+        "lp_trigger_effect",
+        "lra_wave_shape",
+        "od_clamp",
+};
+
+static_assert(std::size(API_NAMES) == static_cast<size_t>(CommandTrace::Api::COUNT));
+static_assert(std::size(NODE_NAMES) == static_cast<size_t>(CommandTrace::Node::COUNT));
+static_assert(std::is_trivially_copyable_v<CommandTrace::Entry>);
+
+static thread_local CommandTrace::Record *sCurrent = nullptr;
+
+static uint32_t toNs(CommandTrace::Clock::duration elapsed) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    return std::clamp<int64_t>(ns, 0, UINT32_MAX);
+}
+
+CommandTrace::Record::Record(CommandTrace *trace, Api api, int32_t arg, int8_t strength)
+    : mTrace(trace), mOuter(sCurrent), mBegin(Clock::now()) {
+    mEntry.api = api;
+    mEntry.arg = arg;
+    mEntry.strength = strength;
+    mEntry.status = 0;
+    mEntry.loopMode = NONE;
+    mEntry.hasTemperature = false;
+    mEntry.hasOdClamp = false;
+    mEntry.writeCount = 0;
+    sCurrent = this;
+}
+
+CommandTrace::Record::~Record() {
+    sCurrent = mOuter;
+    mEntry.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            mBegin.time_since_epoch())
+                            .count();
+    mEntry.elapsedNs = toNs(Clock::now() - mBegin);
+    mTrace->commit(mEntry);
+}
+
+CommandTrace::Record *CommandTrace::Record::current() {
+    return sCurrent;
+}
+
+void CommandTrace::Record::addWrite(Node node, Clock::duration elapsed) {
+    if (mEntry.writeCount < WRITES_MAX) {
+        mEntry.writes[mEntry.writeCount] = {node, toNs(elapsed)};
+    }
+    if (mEntry.writeCount < UINT8_MAX) {
+        mEntry.writeCount++;
+    }
+}
+
+void CommandTrace::commit(const Entry &entry) {
+    uint64_t index = mNext.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = mSlots[index % CAPACITY];
+    Counters &counters = mCounters[static_cast<size_t>(entry.api)];
+    uint32_t us = entry.elapsedNs / 1000;
+    size_t bucket = 0;
+
+    // Readers see an odd sequence, or one for another index, until the entry
+    // is complete, and then drop what they copied.
+    uint64_t words[ENTRY_WORDS] = {};
+    memcpy(words, &entry, sizeof(entry));
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < ENTRY_WORDS; i++) {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot.sequence.store(2 * (index + 1), std::memory_order_release);
+
+    while (bucket < BUCKETS - 1 && us >= (1u << bucket)) {
+        bucket++;
+    }
+    counters.count.fetch_add(1, std::memory_order_relaxed);
+    counters.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    uint32_t max = counters.maxUs.load(std::memory_order_relaxed);
+    while (us > max &&
+           !counters.maxUs.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    }
+}
+
+std::vector<CommandTrace::Entry> CommandTrace::entries() const {
+    uint64_t next = mNext.load(std::memory_order_acquire);
+    std::vector<Entry> entries;
+
+    entries.reserve(CAPACITY);
+    for (uint64_t index = next > CAPACITY ? next - CAPACITY : 0; index < next; index++) {
+        const Slot &slot = mSlots[index % CAPACITY];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * (index + 1)) {
+            continue;
+        }
+        uint64_t words[ENTRY_WORDS];
+        for (size_t i = 0; i < ENTRY_WORDS; i++) {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+            entries.emplace_back();
+            memcpy(&entries.back(), words, sizeof(Entry));
+        }
+    }
+    return entries;
+}
+
+CommandTrace::Histogram CommandTrace::histogram(Api api) const {
+    const Counters &counters = mCounters[static_cast<size_t>(api)];
+    Histogram histogram;
+
+    histogram.count = counters.count.load(std::memory_order_relaxed);
+    histogram.maxUs = counters.maxUs.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < BUCKETS; i++) {
+        histogram.buckets[i] = counters.buckets[i].load(std::memory_order_relaxed);
+    }
+    return histogram;
+}
+
+void CommandTrace::debug(int fd) const {
+    const int64_t now =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch())
+                    .count();
+
+    dprintf(fd, "Command Trace:\n");
+    dprintf(fd, "  Latency (us):");
+    for (size_t i = 0; i < BUCKETS - 1; i++) {
+        dprintf(fd, " <%u", 1u << i);
+    }
+    dprintf(fd, " >=%u\n", 1u << (BUCKETS - 1));
+    for (size_t i = 0; i < static_cast<size_t>(Api::COUNT); i++) {
+        auto histogram = this->histogram(static_cast<Api>(i));
+        if (!histogram.count) {
+            continue;
+        }
+        dprintf(fd, "    %s: count %" PRIu32 ", max %" PRIu32 ",", API_NAMES[i], histogram.count,
+                histogram.maxUs);
+        for (auto bucket : histogram.buckets) {
+            dprintf(fd, " %" PRIu32, bucket);
+        }
+        dprintf(fd, "\n");
+    }
+
+    dprintf(fd, "  Recent:\n");
+    for (const auto &entry : entries()) {
+        dprintf(fd, "    -%" PRId64 "ms %s(%" PRId32, (now - entry.timeNs) / 1000000,
+                getName(entry.api), entry.arg);
+        if (entry.strength != NONE) {
+            dprintf(fd, ", %" PRId8, entry.strength);
+        }
+        dprintf(fd, ") status %" PRId32 ", %" PRIu32 "us", entry.status, entry.elapsedNs / 1000);
+        if (entry.loopMode != NONE) {
+            dprintf(fd, ", loop %s", entry.loopMode ? "open" : "close");
+        }
+        if (entry.hasOdClamp) {
+            dprintf(fd, ", od_clamp %" PRIu32, entry.odClamp);
+        }
+        if (entry.hasTemperature) {
+            dprintf(fd, ", temp %" PRId32, entry.temperature);
+        }
+        for (size_t i = 0; i < std::min<size_t>(entry.writeCount, WRITES_MAX); i++) {
+            dprintf(fd, "%s %s %.1fus", i ? "," : ":", getName(entry.writes[i].node),
+                    entry.writes[i].elapsedNs / 1000.0f);
+        }
+        if (entry.writeCount > WRITES_MAX) {
+            dprintf(fd, " (+%zu)", entry.writeCount - WRITES_MAX);
+        }
+        dprintf(fd, "\n");
+    }
+}
+
+const char *CommandTrace::getName(Api api) {
+    return API_NAMES[static_cast<size_t>(api)];
+}
+
+const char *CommandTrace::getName(Node node) {
+    return NODE_NAMES[static_cast<size_t>(node)];
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
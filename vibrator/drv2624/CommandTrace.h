@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Keeps the most recent haptic commands, with the time taken by each of their
+// hardware writes, and a latency histogram per API, for dump(). Recording is
+// lock-free and allocation-free, so that it can always be on: commands claim a
+// slot of a fixed ring, and a reader skips the slots being overwritten.
+class CommandTrace {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Api : uint8_t {
+        ON,
+        OFF,
+        SET_AMPLITUDE,
+        PERFORM,
+        COMPOSE,
+        COMPOSITION_STEP,
+        COMPOSE_PWLE,
+        ALWAYS_ON_ENABLE,
+        ALWAYS_ON_DISABLE,
+        COUNT,
+    };
+
+    // The hardware nodes written by a command.
+    enum class Node : uint8_t {
+        AUTOCAL,
+        OL_LRA_PERIOD,
+        ACTIVATE,
+        DURATION,
+        STATE,
+        RTP_INPUT,
+        MODE,
+        SEQUENCER,
+        SCALE,
+        CTRL_LOOP,
+        LP_TRIGGER_EFFECT,
+        LRA_WAVE_SHAPE,
+        OD_CLAMP,
+        COUNT,
+    };
+
+    static constexpr size_t CAPACITY = 64;
+    // Writes past this many are counted but not timed.
+    static constexpr size_t WRITES_MAX = 10;
+    // Bucket N counts latencies below 2^N us; the last one counts the rest.
+    static constexpr size_t BUCKETS = 16;
+    static constexpr int8_t NONE = -1;
+
+    struct Write {
+        Node node;
+        uint32_t elapsedNs;
+    };
+
+    struct Entry {
+        int64_t timeNs;
+        uint32_t elapsedNs;
+        // Duration, effect or waveform count, depending on the API.
+        int32_t arg;
+        int32_t status;
+        int32_t temperature;
+        uint32_t odClamp;
+        Api api;
+        int8_t strength;
+        // Set through the control loop write; LoopControl, or NONE.
+        int8_t loopMode;
+        bool hasTemperature;
+        bool hasOdClamp;
+        uint8_t writeCount;
+        Write writes[WRITES_MAX];
+    };
+
+    struct Histogram {
+        uint32_t count;
+        uint32_t maxUs;
+        std::array<uint32_t, BUCKETS> buckets;
+    };
+
+    // Times a command from construction to destruction, and records it then.
+    // Hardware writes issued by the same thread in the meantime are added to
+    // it through current().
+    class Record {
+      public:
+        Record(CommandTrace *trace, Api api, int32_t arg = 0, int8_t strength = NONE);
+        ~Record();
+        Record(const Record &) = delete;
+        Record &operator=(const Record &) = delete;
+
+        // The innermost record of the calling thread, or null.
+        static Record *current();
+
+        void setTemperature(int32_t value) {
+            mEntry.temperature = value;
+            mEntry.hasTemperature = true;
+        }
+        void setLoopMode(bool value) { mEntry.loopMode = value; }
+        void setOdClamp(uint32_t value) {
+            mEntry.odClamp = value;
+            mEntry.hasOdClamp = true;
+        }
+        void setStatus(int32_t value) { mEntry.status = value; }
+        void addWrite(Node node, Clock::duration elapsed);
+
+        // Stores the exception code of 'status' and passes it on.
+        template <typename Status>
+        Status finish(Status status) {
+            setStatus(status.getExceptionCode());
+            return status;
+        }
+
+      private:
+        CommandTrace *const mTrace;
+        Record *const mOuter;
+        const Clock::time_point mBegin;
+        Entry mEntry;
+    };
+
+    // Returns the recorded entries, oldest first.
+    std::vector<Entry> entries() const;
+    Histogram histogram(Api api) const;
+    // Emit diagnostic information to the given file.
+    void debug(int fd) const;
+
+    static const char *getName(Api api);
+    static const char *getName(Node node);
+
+  private:
+    // The entry is copied in and out a word at a time with relaxed atomics,
+    // so that a reader racing with a writer gets a torn copy to drop rather
+    // than undefined behavior.
+    static constexpr size_t ENTRY_WORDS = (sizeof(Entry) + 7) / 8;
+
+    struct Slot {
+        // 2 * (index + 1) once the entry of the given command index is
+        // complete, odd while it is being written.
+        std::atomic<uint64_t> sequence{0};
+        std::array<std::atomic<uint64_t>, ENTRY_WORDS> words{};
+    };
+
+    struct Counters {
+        std::atomic<uint32_t> count{0};
+        std::atomic<uint32_t> maxUs{0};
+        std::array<std::atomic<uint32_t>, BUCKETS> buckets{};
+    };
+
+    void commit(const Entry &entry);
+
+    std::atomic<uint64_t> mNext{0};
+    std::array<Slot, CAPACITY> mSlots;
+    std::array<Counters, static_cast<size_t>(Api::COUNT)> mCounters;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CompletionEngine.h"
+
+#include <log/log.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <utils/Trace.h>
+
+#include <cinttypes>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+CompletionEngine::CompletionEngine() {
+    struct epoll_event ev = {.events = EPOLLIN, .data = {}};
+
+    mTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    mEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mTimerFd < 0 || mEventFd < 0 || mEpollFd < 0) {
+        ALOGE("Failed to create completion engine fds (%d): %s", errno, strerror(errno));
+        return;
+    }
+
+    ev.data.fd = mTimerFd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mTimerFd, &ev)) {
+        ALOGE("Failed to add timerfd (%d): %s", errno, strerror(errno));
+        return;
+    }
+    ev.data.fd = mEventFd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mEventFd, &ev)) {
+        ALOGE("Failed to add eventfd (%d): %s", errno, strerror(errno));
+        return;
+    }
+
+    mThread = std::thread(&CompletionEngine::run, this);
+}
+
+CompletionEngine::~CompletionEngine() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExit = true;
+    }
+    wake();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+    for (int fd : {mTimerFd, mEventFd, mEpollFd}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void CompletionEngine::start(uint32_t durationMs,
+                             const std::shared_ptr<IVibratorCallback> &callback) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    struct itimerspec spec = {};
+
+    preemptLocked();
+    if (!callback) {
+        return;
+    }
+
+    mCallback = callback;
+    mDeadline = Clock::now() + std::chrono::milliseconds(durationMs);
+
+    // A zero it_value disarms the timer, so round up to the next nanosecond.
+    spec.it_value.tv_sec = durationMs / 1000;
+    spec.it_value.tv_nsec = (durationMs % 1000) * 1000000 ?: 1;
+    if (timerfd_settime(mTimerFd, 0, &spec, nullptr)) {
+        ALOGE("Failed to arm completion timer (%d): %s", errno, strerror(errno));
+    }
+}
+
+void CompletionEngine::stop() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    preemptLocked();
+}
+
+void CompletionEngine::debug(int fd) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    dprintf(fd, "Completion:\n");
+    dprintf(fd, "  Active: %s\n", mCallback ? "yes" : "no");
+    dprintf(fd, "  Completed: %" PRIu32 "\n", mCompleted);
+    dprintf(fd, "  Preempted: %" PRIu32 "\n", mPreempted);
+}
+
+void CompletionEngine::preemptLocked() {
+    if (!mCallback) {
+        return;
+    }
+    mPending.push_back(std::move(mCallback));
+    mPreempted++;
+    wake();
+}
+
+void CompletionEngine::wake() {
+    uint64_t one = 1;
+    if (TEMP_FAILURE_RETRY(write(mEventFd, &one, sizeof(one))) < 0 && errno != EAGAIN) {
+        ALOGE("Failed to wake completion thread (%d): %s", errno, strerror(errno));
+    }
+}
+
+void CompletionEngine::run() {
+    std::vector<std::shared_ptr<IVibratorCallback>> fire;
+
+    for (;;) {
+        struct epoll_event events[2];
+        uint64_t count;
+
+        int n = epoll_wait(mEpollFd, events, 2, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ALOGE("Completion epoll_wait failed (%d): %s", errno, strerror(errno));
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            // Drain the counters. Either fd may legitimately be empty because
+            // the timer was re-armed after it fired.
+            (void)TEMP_FAILURE_RETRY(read(events[i].data.fd, &count, sizeof(count)));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mExit) {
+                return;
+            }
+            fire.swap(mPending);
+            if (mCallback && Clock::now() >= mDeadline) {
+                fire.push_back(std::move(mCallback));
+                mCompleted++;
+            }
+        }
+
+        for (auto &callback : fire) {
+            ATRACE_NAME("Vibrator::onComplete");
+            auto ret = callback->onComplete();
+            if (!ret.isOk()) {
+                ALOGE("Failed to notify completion: %s", ret.getDescription().c_str());
+            }
+        }
+        fire.clear();
+    }
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <aidl/android/hardware/vibrator/IVibratorCallback.h>
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Tracks the active vibration and notifies its IVibratorCallback from a
+// dedicated timerfd/epoll thread, either when its duration elapses or when it
+// is preempted by a new vibration or off().
+class CompletionEngine {
+  public:
+    CompletionEngine();
+    ~CompletionEngine();
+
+    // Starts tracking a vibration lasting durationMs. The previously tracked
+    // vibration, if any, is completed. A null callback is allowed and only
+    // preempts the previous vibration.
+    void start(uint32_t durationMs, const std::shared_ptr<IVibratorCallback> &callback);
+    // Completes the tracked vibration immediately.
+    void stop();
+    // Emit diagnostic information to the given file.
+    void debug(int fd);
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    // Moves the tracked callback to the pending list and wakes the thread.
+    // Must be called with mMutex held.
+    void preemptLocked();
+    void wake();
+    void run();
+
+    std::mutex mMutex;
+    std::shared_ptr<IVibratorCallback> mCallback;
+    Clock::time_point mDeadline;
+    std::vector<std::shared_ptr<IVibratorCallback>> mPending;
+    bool mExit{false};
+    uint32_t mCompleted{0};
+    uint32_t mPreempted{0};
+
+    int mTimerFd{-1};
+    int mEventFd{-1};
+    int mEpollFd{-1};
+    std::thread mThread;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CompositionEngine.h"
+
+#include <log/log.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <cinttypes>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+CompositionEngine::CompositionEngine(PlayFunction play, CompletionEngine *completion)
+    : mPlay(std::move(play)), mCompletion(completion) {
+    mThread = std::thread(&CompositionEngine::run, this);
+}
+
+CompositionEngine::~CompositionEngine() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExit = true;
+    }
+    mCondition.notify_one();
+    mThread.join();
+}
+
+void CompositionEngine::start(const Step *steps, size_t count,
+                              const std::shared_ptr<IVibratorCallback> &callback) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    cancelLocked();
+
+    count = std::min(count, STEPS_MAX);
+    for (size_t i = 0; i < count; i++) {
+        mSteps[i] = steps[i];
+    }
+    mHead = 0;
+    mCount = count;
+    mCallback = callback;
+    mDue = Clock::now() + std::chrono::milliseconds(count ? steps[0].delayMs : 0);
+
+    if (!count) {
+        mCompletion->start(0, mCallback);
+        mCallback.reset();
+        return;
+    }
+
+    mCondition.notify_one();
+}
+
+void CompositionEngine::cancel() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    cancelLocked();
+}
+
+void CompositionEngine::debug(int fd) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    dprintf(fd, "Composition:\n");
+    dprintf(fd, "  Pending Steps: %zu\n", mCount);
+    dprintf(fd, "  Played: %" PRIu32 "\n", mPlayed);
+    dprintf(fd, "  Cancelled: %" PRIu32 "\n", mCancelled);
+}
+
+void CompositionEngine::cancelLocked() {
+    if (mCount) {
+        mCancelled++;
+    }
+    mCount = 0;
+    if (mCallback) {
+        mCompletion->start(0, mCallback);
+        mCallback.reset();
+    }
+}
+
+void CompositionEngine::run() {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (!mExit) {
+        if (!mCount) {
+            mCondition.wait(lock);
+            continue;
+        }
+        if (Clock::now() < mDue) {
+            mCondition.wait_until(lock, mDue);
+            continue;
+        }
+
+        const Step &step = mSteps[mHead];
+        mHead = (mHead + 1) % STEPS_MAX;
+        mCount--;
+
+        // Steps are played with the lock held so that cancel() guarantees the
+        // engine no longer touches the hardware once it returns.
+        bool ok = true;
+        if (step.count) {
+            ATRACE_NAME("Vibrator::compose step");
+            ok = mPlay(step);
+            if (!ok) {
+                ALOGE("Failed to play composition step");
+                mCount = 0;
+            }
+            mPlayed++;
+        }
+
+        if (!mCount) {
+            mCompletion->start(ok ? step.durationMs : 0, mCallback);
+            mCallback.reset();
+        } else {
+            mDue = Clock::now() +
+                   std::chrono::milliseconds(step.durationMs + mSteps[mHead].delayMs);
+        }
+    }
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
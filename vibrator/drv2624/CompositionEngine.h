@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "CompletionEngine.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Plays a composition as a series of waveform sequencer activations separated
+// by delays. Steps are held in a fixed-capacity ring so that scheduling never
+// allocates.
+class CompositionEngine {
+  public:
+    // Number of index-count pairs accepted by the DRV2624 sequencer.
+    static constexpr size_t SEQUENCER_SIZE = 8;
+    static constexpr size_t STEPS_MAX = 32;
+
+    // A single sequencer activation.
+    struct Step {
+        // Time to wait after the previous step has finished.
+        uint32_t delayMs;
+        // Playback time of all waveforms in the step.
+        uint32_t durationMs;
+        // Value for HwApi::setScale().
+        uint8_t scale;
+        // Number of valid entries in 'waveforms'. Zero for a pure delay.
+        uint8_t count;
+        std::array<uint8_t, SEQUENCER_SIZE> waveforms;
+        // Shape, OD clamp and LRA period are only written with dynamic config.
+        bool hasConfig;
+        uint32_t shape;
+        uint32_t odClamp;
+        uint32_t olLraPeriod;
+    };
+
+    using PlayFunction = std::function<bool(const Step &)>;
+
+    // 'play' is invoked from the engine thread for every step with a
+    // non-zero count. Completion of the last step is reported through
+    // 'completion'.
+    CompositionEngine(PlayFunction play, CompletionEngine *completion);
+    ~CompositionEngine();
+
+    // Replaces any composition in progress with 'count' steps.
+    void start(const Step *steps, size_t count,
+               const std::shared_ptr<IVibratorCallback> &callback);
+    // Drops any remaining steps and completes the composition callback.
+    void cancel();
+    // Emit diagnostic information to the given file.
+    void debug(int fd);
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    void cancelLocked();
+    void run();
+
+    const PlayFunction mPlay;
+    CompletionEngine *const mCompletion;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::array<Step, STEPS_MAX> mSteps;
+    size_t mHead{0};
+    size_t mCount{0};
+    Clock::time_point mDue;
+    std::shared_ptr<IVibratorCallback> mCallback;
+    bool mExit{false};
+    uint32_t mPlayed{0};
+    uint32_t mCancelled{0};
+
+    std::thread mThread;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
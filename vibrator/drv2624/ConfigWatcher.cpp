@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ConfigWatcher.h"
+
+#include <log/log.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <utils/Trace.h>
+
+#include <cinttypes>
+#include <cstring>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+static constexpr size_t INOTIFY_BUFFER_LEN = 4096;
+
+ConfigWatcher::ConfigWatcher(const std::string &path, SampleFunction sample,
+                             std::chrono::milliseconds interval, ChangeFunction change)
+    : mPath(path), mSample(std::move(sample)), mInterval(interval), mChange(std::move(change)) {
+    struct epoll_event ev = {.events = EPOLLIN, .data = {}};
+    size_t slash = mPath.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : mPath.substr(0, slash + 1);
+
+    mName = slash == std::string::npos ? mPath : mPath.substr(slash + 1);
+
+    if (mPath.empty() && !mInterval.count()) {
+        return;
+    }
+
+    mEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEventFd < 0 || mEpollFd < 0) {
+        ALOGE("Failed to create config watcher fds (%d): %s", errno, strerror(errno));
+        return;
+    }
+
+    ev.data.fd = mEventFd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mEventFd, &ev)) {
+        ALOGE("Failed to add event fd (%d): %s", errno, strerror(errno));
+        return;
+    }
+
+    if (!mPath.empty()) {
+        mInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (mInotifyFd < 0 ||
+            inotify_add_watch(mInotifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            ALOGE("Failed to watch %s (%d): %s", dir.c_str(), errno, strerror(errno));
+        } else {
+            ev.data.fd = mInotifyFd;
+            if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mInotifyFd, &ev)) {
+                ALOGE("Failed to add inotify fd (%d): %s", errno, strerror(errno));
+            }
+        }
+    }
+
+    // Sampled here, so that changes made once the constructor returns are seen.
+    mThread = std::thread(&ConfigWatcher::run, this, mSample ? mSample() : "");
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    if (mThread.joinable()) {
+        uint64_t value = 1;
+        (void)TEMP_FAILURE_RETRY(write(mEventFd, &value, sizeof(value)));
+        mThread.join();
+    }
+    for (int fd : {mInotifyFd, mEventFd, mEpollFd}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void ConfigWatcher::debug(int fd) {
+    dprintf(fd, "Config Watcher:\n");
+    dprintf(fd, "  Path: %s\n", mPath.c_str());
+    dprintf(fd, "  Property Interval: %" PRId64 " ms\n", static_cast<int64_t>(mInterval.count()));
+    dprintf(fd, "  File Changes: %" PRIu32 "\n", mFileChanges.load());
+    dprintf(fd, "  Property Changes: %" PRIu32 "\n", mPropertyChanges.load());
+}
+
+// Drains pending inotify events and reports whether any was for the file.
+bool ConfigWatcher::fileChanged() {
+    alignas(struct inotify_event) char buf[INOTIFY_BUFFER_LEN];
+    bool changed = false;
+    ssize_t len;
+
+    while ((len = TEMP_FAILURE_RETRY(read(mInotifyFd, buf, sizeof(buf)))) > 0) {
+        for (char *cp = buf; cp < buf + len;) {
+            const auto *event = reinterpret_cast<const struct inotify_event *>(cp);
+            if (event->len && mName == event->name) {
+                changed = true;
+            }
+            cp += sizeof(*event) + event->len;
+        }
+    }
+    return changed;
+}
+
+void ConfigWatcher::run(std::string sample) {
+    const int timeout = mInterval.count() ? mInterval.count() : -1;
+
+    while (true) {
+        struct epoll_event ev;
+        bool changed = false;
+
+        int n = TEMP_FAILURE_RETRY(epoll_wait(mEpollFd, &ev, 1, timeout));
+        if (n < 0) {
+            ALOGE("Failed to wait for config changes (%d): %s", errno, strerror(errno));
+            return;
+        }
+        if (n && ev.data.fd == mEventFd) {
+            return;
+        }
+
+        if (n && fileChanged()) {
+            // Wait for the writer to finish before the file is read.
+            while (TEMP_FAILURE_RETRY(epoll_wait(mEpollFd, &ev, 1, SETTLE_TIME.count())) > 0) {
+                if (ev.data.fd == mEventFd) {
+                    return;
+                }
+                fileChanged();
+            }
+            mFileChanges++;
+            changed = true;
+        }
+
+        if (mSample) {
+            std::string next = mSample();
+            if (next != sample) {
+                sample = std::move(next);
+                mPropertyChanges += !changed;
+                changed = true;
+            }
+        }
+
+        if (changed) {
+            ATRACE_NAME("ConfigWatcher::change");
+            mChange();
+        }
+    }
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Reports changes to the calibration file and to the tuning properties from a
+// background thread. The file is watched through inotify on its directory,
+// since calibration tools usually replace it by renaming. Property updates
+// cannot be waited for together with inotify, so the properties are sampled
+// every 'interval' instead, and only while that is non-zero.
+class ConfigWatcher {
+  public:
+    // Returns the current values of the watched properties. A difference
+    // between two samples is reported as a change.
+    using SampleFunction = std::function<std::string()>;
+    using ChangeFunction = std::function<void()>;
+
+    // Bursts of file events closer than this are reported once.
+    static constexpr std::chrono::milliseconds SETTLE_TIME{100};
+
+    ConfigWatcher(const std::string &path, SampleFunction sample,
+                  std::chrono::milliseconds interval, ChangeFunction change);
+    ~ConfigWatcher();
+
+    // Emit diagnostic information to the given file.
+    void debug(int fd);
+
+  private:
+    bool fileChanged();
+    void run(std::string sample);
+
+    const std::string mPath;
+    std::string mName;
+    const SampleFunction mSample;
+    const std::chrono::milliseconds mInterval;
+    const ChangeFunction mChange;
+
+    std::atomic<uint32_t> mFileChanges{0};
+    std::atomic<uint32_t> mPropertyChanges{0};
+
+    int mInotifyFd{-1};
+    int mEventFd{-1};
+    int mEpollFd{-1};
+    std::thread mThread;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DriverSimulator.h"
+
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+#include <log/log.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using namespace std::chrono_literals;
+
+using ::android::base::unique_fd;
+
+using Node = DriverSimulator::Node;
+
+// One register write is about 30 bits on the bus, or 75us. Read-modify-write
+// updates of control bits take two transfers. Duration and state are kept by
+// the driver itself and take no transfer.
+const DriverSimulator::Timing DriverSimulator::DEFAULT_TIMING = {
+        225us,  // AUTOCAL
+        150us,  // OL_LRA_PERIOD
+        150us,  // ACTIVATE
+        0us,    // DURATION
+        0us,    // STATE
+        75us,   // RTP_INPUT
+        150us,  // MODE
+        600us,  // SEQUENCER
+        150us,  // SCALE
+        150us,  // CTRL_LOOP
+        150us,  // LP_TRIGGER_EFFECT
+        150us,  // LRA_WAVE_SHAPE
+        75us,   // OD_CLAMP
+};
+
+// Indexed by Node.
+static constexpr const char *NODE_NAMES[] = {
+        "device/autocal",
+        "device/ol_lra_period",
+        "activate",
+        "duration",
+        "state",
+        "device/rtp_input",
+        "device/mode",
+        "device/set_sequencer",
+        "device/scale",
+        "device/ctrl_loop",
+        "device/lp_trigger_effect",
+        "device/lra_wave_shape",
+        "device/od_clamp",
+};
+
+static_assert(std::size(NODE_NAMES) == static_cast<size_t>(Node::COUNT));
+
+static constexpr char LRA_PERIOD_NAME[] = "device/lra_period";
+
+class DriverSimulator::Api : public Vibrator::HwApi {
+  public:
+    Api(DriverSimulator *sim, std::unique_ptr<Vibrator::HwApi> hwapi)
+        : mSim(sim), mHwApi(std::move(hwapi)) {
+        const char *prefix = std::getenv("HWAPI_PATH_PREFIX");
+
+        for (size_t i = 0; i < mNodes.size(); i++) {
+            const std::string path = std::string(prefix ? prefix : "") + NODE_NAMES[i];
+            mNodes[i].reset(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDWR | O_CLOEXEC)));
+            if (!mNodes[i].ok()) {
+                ALOGW("Failed to open %s (%d): %s", path.c_str(), errno, strerror(errno));
+            }
+        }
+    }
+
+    bool setAutocal(std::string value) override {
+        return write(Node::AUTOCAL, value, [&] { return mHwApi->setAutocal(value); });
+    }
+    bool setOlLraPeriod(uint32_t value) override {
+        return write(Node::OL_LRA_PERIOD, value, [&] { return mHwApi->setOlLraPeriod(value); });
+    }
+    bool setActivate(bool value) override {
+        return write(Node::ACTIVATE, value, [&] { return mHwApi->setActivate(value); });
+    }
+    bool setDuration(uint32_t value) override {
+        return write(Node::DURATION, value, [&] { return mHwApi->setDuration(value); });
+    }
+    bool setState(bool value) override {
+        return write(Node::STATE, value, [&] { return mHwApi->setState(value); });
+    }
+    bool hasRtpInput() override { return mHwApi->hasRtpInput(); }
+    bool setRtpInput(int8_t value) override {
+        return write(Node::RTP_INPUT, value, [&] { return mHwApi->setRtpInput(value); });
+    }
+    bool setMode(std::string value) override {
+        return write(Node::MODE, value, [&] { return mHwApi->setMode(value); });
+    }
+    bool setSequencer(std::string value) override {
+        return write(Node::SEQUENCER, value, [&] { return mHwApi->setSequencer(value); });
+    }
+    bool setScale(uint8_t value) override {
+        return write(Node::SCALE, value, [&] { return mHwApi->setScale(value); });
+    }
+    bool setCtrlLoop(bool value) override {
+        return write(Node::CTRL_LOOP, value, [&] { return mHwApi->setCtrlLoop(value); });
+    }
+    bool setLpTriggerEffect(uint32_t value) override {
+        return write(Node::LP_TRIGGER_EFFECT, value,
+                     [&] { return mHwApi->setLpTriggerEffect(value); });
+    }
+    bool setLraWaveShape(uint32_t value) override {
+        return write(Node::LRA_WAVE_SHAPE, value, [&] { return mHwApi->setLraWaveShape(value); });
+    }
+    bool setOdClamp(uint32_t value) override {
+        return write(Node::OD_CLAMP, value, [&] { return mHwApi->setOdClamp(value); });
+    }
+    bool getPATemp(int32_t *value) override { return mHwApi->getPATemp(value); }
+    bool getLraPeriod(uint32_t *value) override { return mHwApi->getLraPeriod(value); }
+    void debug(int fd) override { mHwApi->debug(fd); }
+
+  private:
+    template <typename T, typename F>
+    bool write(Node node, const T &value, F &&forward) {
+        return mSim->write(node, mNodes[static_cast<size_t>(node)], value, forward);
+    }
+
+    DriverSimulator *const mSim;
+    const std::unique_ptr<Vibrator::HwApi> mHwApi;
+    // Indexed by Node.
+    std::array<unique_fd, static_cast<size_t>(Node::COUNT)> mNodes;
+};
+
+DriverSimulator::DriverSimulator(const Timing &timing) : mTiming(timing) {}
+
+bool DriverSimulator::createNodes(const std::string &root, uint32_t lraPeriod) {
+    const std::string prefix = root + "/";
+
+    if (mkdir((prefix + "device").c_str(), S_IRWXU) && errno != EEXIST) {
+        ALOGE("Failed to create %sdevice (%d): %s", prefix.c_str(), errno, strerror(errno));
+        return false;
+    }
+    for (auto name : NODE_NAMES) {
+        const std::string path = prefix + name;
+        unique_fd fd(TEMP_FAILURE_RETRY(
+                open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR)));
+        if (!fd.ok()) {
+            ALOGE("Failed to create %s (%d): %s", path.c_str(), errno, strerror(errno));
+            return false;
+        }
+    }
+
+    std::ofstream lraPeriodFile{prefix + LRA_PERIOD_NAME};
+    lraPeriodFile << lraPeriod << std::endl;
+    return lraPeriodFile.good();
+}
+
+const char *DriverSimulator::getName(Node node) {
+    return NODE_NAMES[static_cast<size_t>(node)];
+}
+
+std::unique_ptr<Vibrator::HwApi> DriverSimulator::wrap(std::unique_ptr<Vibrator::HwApi> backend) {
+    if (!backend) {
+        return nullptr;
+    }
+    return std::make_unique<Api>(this, std::move(backend));
+}
+
+bool DriverSimulator::isPlaying() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return Clock::now() < mPlayingUntil;
+}
+
+DriverSimulator::Clock::time_point DriverSimulator::lastActivation() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mLastActivation;
+}
+
+std::vector<DriverSimulator::Command> DriverSimulator::trace() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return {mTrace.begin(), mTrace.end()};
+}
+
+void DriverSimulator::clearTrace() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTrace.clear();
+}
+
+// Whether a write reached the node since the last call. The backends write at
+// their own file offset, so the node grows with every write that reaches it;
+// truncating it again keeps it sparse.
+bool DriverSimulator::consume(int fd) {
+    struct stat st;
+
+    if (fd < 0) {
+        return true;
+    }
+    if (fstat(fd, &st)) {
+        ALOGE("Failed to stat node (%d): %s", errno, strerror(errno));
+        return true;
+    }
+    if (!st.st_size) {
+        return false;
+    }
+    if (ftruncate(fd, 0)) {
+        ALOGE("Failed to truncate node (%d): %s", errno, strerror(errno));
+    }
+    return true;
+}
+
+// Called with the bus held, once the backend has taken the write.
+bool DriverSimulator::complete(Node node, std::string value, Clock::time_point begin, bool ok) {
+    const auto deadline = Clock::now() + mTiming[static_cast<size_t>(node)];
+    int error = errno;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (ok && !apply(node, value, begin)) {
+            ok = false;
+            error = errno;
+        }
+    }
+
+    // Spin rather than sleep, as the sleep granularity of a host is coarser
+    // than most of the modeled transfers.
+    while (Clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    const auto end = Clock::now();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (ok && node == Node::ACTIVATE && value == "1") {
+        mLastActivation = end;
+    }
+    if (mTrace.size() == TRACE_MAX) {
+        mTrace.pop_front();
+    }
+    mTrace.push_back({begin, node, std::move(value), end - begin, ok});
+
+    errno = error;
+    return ok;
+}
+
+// Follows the driver: playback needs the device to be enabled through state,
+// lasts for the last duration written, and is stopped by activate=0 or by
+// disabling the device.
+bool DriverSimulator::apply(Node node, const std::string &value, Clock::time_point now) {
+    switch (node) {
+        case Node::STATE:
+            mEnabled = value == "1";
+            if (!mEnabled) {
+                mPlayingUntil = now;
+            }
+            break;
+        case Node::DURATION:
+            mDurationMs = std::stoul(value);
+            break;
+        case Node::ACTIVATE:
+            if (value == "0") {
+                mPlayingUntil = now;
+            } else if (!mEnabled) {
+                errno = EINVAL;
+                return false;
+            } else {
+                mPlayingUntil = now + std::chrono::milliseconds(mDurationMs);
+            }
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Vibrator.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// A user-space model of the DRV2624 kernel driver, for running the HAL on a
+// host without the hardware. The simulator is interposed in front of a real
+// HwApi backend whose nodes live in a scratch directory (see createNodes()),
+// so that the backend's own file I/O is still paid. Only the writes that reach
+// a node are seen by the driver: one that the backend coalesces away costs
+// nothing more. Every write that does reach it takes the time of the I2C
+// transfers the driver would issue, feeds the state/duration/activate state
+// machine, and is recorded in a timestamped trace.
+class DriverSimulator {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Node : uint8_t {
+        AUTOCAL,
+        OL_LRA_PERIOD,
+        ACTIVATE,
+        DURATION,
+        STATE,
+        RTP_INPUT,
+        MODE,
+        SEQUENCER,
+        SCALE,
+        CTRL_LOOP,
+        LP_TRIGGER_EFFECT,
+        LRA_WAVE_SHAPE,
+        OD_CLAMP,
+        COUNT,
+    };
+
+    // Time the driver takes to handle a write to each node, indexed by Node.
+    using Timing = std::array<std::chrono::microseconds, static_cast<size_t>(Node::COUNT)>;
+
+    struct Command {
+        Clock::time_point time;  // When the write was issued.
+        Node node;
+        std::string value;
+        std::chrono::nanoseconds elapsed;  // Backend and modeled time together.
+        bool accepted;
+    };
+
+    // Estimated from the register accesses of each node, at 400 kHz I2C.
+    static const Timing DEFAULT_TIMING;
+    // Only the most recent commands are kept.
+    static constexpr size_t TRACE_MAX = 4096;
+
+    explicit DriverSimulator(const Timing &timing = DEFAULT_TIMING);
+
+    // Creates the driver nodes under 'root', as the backends expect them
+    // with HWAPI_PATH_PREFIX set to it. Writes to the nodes are discarded once
+    // the simulator has seen them, and 'lraPeriod' is reported as the last
+    // calibrated LRA period.
+    static bool createNodes(const std::string &root, uint32_t lraPeriod);
+    static const char *getName(Node node);
+
+    // Returns 'backend' with the simulator interposed, watching the nodes
+    // under HWAPI_PATH_PREFIX. The simulator must outlive the returned object.
+    std::unique_ptr<Vibrator::HwApi> wrap(std::unique_ptr<Vibrator::HwApi> backend);
+
+    // Whether a vibration started by activate is still playing.
+    bool isPlaying() const;
+    // When the last accepted activate=1 write completed.
+    Clock::time_point lastActivation() const;
+    std::vector<Command> trace() const;
+    void clearTrace();
+
+  private:
+    class Api;
+
+    template <typename T>
+    static std::string format(T value) {
+        if constexpr (std::is_same_v<T, std::string>) {
+            return value;
+        } else {
+            return std::to_string(static_cast<int64_t>(value));
+        }
+    }
+
+    // Writes are serialized as on the I2C bus, and 'forward' performs the
+    // write on the backend. 'fd' is the node as seen by the driver.
+    template <typename T, typename F>
+    bool write(Node node, int fd, const T &value, F &&forward) {
+        std::lock_guard<std::mutex> lock(mBusMutex);
+        auto begin = Clock::now();
+        bool ok = forward();
+        int error = errno;
+        bool reached = consume(fd);
+        errno = error;
+        if (!reached) {
+            return ok;
+        }
+        return complete(node, format(value), begin, ok);
+    }
+
+    static bool consume(int fd);
+    bool complete(Node node, std::string value, Clock::time_point begin, bool ok);
+    bool apply(Node node, const std::string &value, Clock::time_point now);
+
+    const Timing mTiming;
+    std::mutex mBusMutex;
+    mutable std::mutex mMutex;
+    bool mEnabled{false};
+    uint32_t mDurationMs{0};
+    Clock::time_point mPlayingUntil;
+    Clock::time_point mLastActivation;
+    std::deque<Command> mTrace;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Exponentially weighted moving average of the gravity samples. Each sample is
+// weighted by the time since the previous one, so an uneven sampling rate
+// does not skew the average. A sample which comes after a gap, e.g. a suspend,
+// restarts the average.
+//
+// A single producer calls push() and reset(). Any number of threads may call
+// average() concurrently; the average is published through a sequence lock so
+// readers never block the producer.
+class GravityEwma {
+  public:
+    // The average follows a step in the samples by 63% within
+    // 'timeConstantNs'. A sample taken more than 'gapNs' after the previous
+    // one restarts it.
+    GravityEwma(int64_t timeConstantNs, int64_t gapNs)
+        : mTimeConstantNs(timeConstantNs), mGapNs(gapNs) {}
+
+    // Adds a sample taken at 'timestampNs'.
+    void push(float x, float y, int64_t timestampNs) {
+        double avgX = mX.load(std::memory_order_relaxed);
+        double avgY = mY.load(std::memory_order_relaxed);
+        uint32_t count = mCount.load(std::memory_order_relaxed);
+        int64_t elapsedNs = timestampNs - mLastNs.load(std::memory_order_relaxed);
+
+        if (!count || elapsedNs < 0 || elapsedNs > mGapNs) {
+            avgX = x;
+            avgY = y;
+            count = 1;
+        } else {
+            double weight = 1.0 - std::exp(-static_cast<double>(elapsedNs) / mTimeConstantNs);
+            avgX += (x - avgX) * weight;
+            avgY += (y - avgY) * weight;
+            if (count < UINT32_MAX) {
+                count++;
+            }
+        }
+
+        publish(avgX, avgY, count, timestampNs);
+    }
+
+    // Drops the average.
+    void reset() { publish(0.0, 0.0, 0, 0); }
+
+    // Returns false if there is no average, or if its last sample was taken
+    // more than the gap before 'nowNs'.
+    bool average(float *x, float *y, int64_t nowNs) const {
+        uint32_t begin, end, count;
+        double avgX, avgY;
+        int64_t lastNs;
+
+        do {
+            begin = mSequence.load(std::memory_order_acquire);
+            avgX = mX.load(std::memory_order_relaxed);
+            avgY = mY.load(std::memory_order_relaxed);
+            count = mCount.load(std::memory_order_relaxed);
+            lastNs = mLastNs.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            end = mSequence.load(std::memory_order_relaxed);
+        } while ((begin & 1) || begin != end);
+
+        if (!count || nowNs - lastNs > mGapNs) {
+            return false;
+        }
+        *x = avgX;
+        *y = avgY;
+        return true;
+    }
+
+    // Number of samples since the average last started.
+    uint32_t size() const { return mCount.load(std::memory_order_relaxed); }
+
+  private:
+    void publish(double x, double y, uint32_t count, int64_t lastNs) {
+        uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+
+        mSequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        mX.store(x, std::memory_order_relaxed);
+        mY.store(y, std::memory_order_relaxed);
+        mCount.store(count, std::memory_order_relaxed);
+        mLastNs.store(lastNs, std::memory_order_relaxed);
+        mSequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    const int64_t mTimeConstantNs;
+    const int64_t mGapNs;
+
+    std::atomic<uint32_t> mSequence{0};
+    std::atomic<double> mX{0.0};
+    std::atomic<double> mY{0.0};
+    std::atomic<uint32_t> mCount{0};
+    std::atomic<int64_t> mLastNs{0};
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
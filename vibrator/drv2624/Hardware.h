@@ -15,7 +15,24 @@
  */
 #pragma once
 
+#include <android-base/file.h>
+#include <android-base/properties.h>
+#include <fcntl.h>
+#include <log/log.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <charconv>
+#include <cinttypes>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <type_traits>
+
 #include "../common/HardwareBase.h"
+#include "CalibrationSnapshot.h"
+#include "ConfigWatcher.h"
+#include "StartupProfile.h"
 #include "Vibrator.h"
 
 namespace aidl {
@@ -50,6 +67,7 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
     bool setLraWaveShape(uint32_t value) override { return set(value, &mLraWaveShape); }
     bool setOdClamp(uint32_t value) override { return set(value, &mOdClamp); }
     bool getPATemp(int32_t *value) override { return get(value, &mPATemp); }
+    bool getLraPeriod(uint32_t *value) override { return get(value, &mLraPeriod); }
     void debug(int fd) override { HwApiBase::debug(fd); }
 
   private:
@@ -67,6 +85,7 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
         open("device/lp_trigger_effect", &mLpTrigger);
         open("device/lra_wave_shape", &mLraWaveShape);
         open("device/od_clamp", &mOdClamp);
+        open("device/lra_period", &mLraPeriod);
         // TODO: for future new architecture: b/149610125
         openFull("/sys/devices/virtual/thermal/tz-by-name/pa-therm1/temp",
                  &mPATemp);
@@ -92,19 +111,263 @@ class HwApi : public Vibrator::HwApi, private HwApiBase {
     std::ofstream mLpTrigger;
     std::ofstream mLraWaveShape;
     std::ofstream mOdClamp;
+    std::ifstream mLraPeriod;
     std::ifstream mPATemp;
 };
 
-class HwCal : public Vibrator::HwCal, private HwCalBase {
+// Variant of HwApi which keeps raw file descriptors to the sysfs nodes instead
+// of iostreams. Values are formatted into a stack buffer and writes to
+// configuration nodes are skipped when the value matches the last one written.
+class HwApiFd : public Vibrator::HwApi {
+  private:
+    // A sysfs node held open for the lifetime of the HAL.
+    class Node {
+      public:
+        // Sysfs attributes are small; this covers every value written by the HAL.
+        static constexpr size_t VALUE_MAX = 256;
+
+        Node() = default;
+        Node(const Node &) = delete;
+        Node &operator=(const Node &) = delete;
+        ~Node() {
+            if (mFd >= 0) {
+                ::close(mFd);
+            }
+        }
+
+        // Opens the node without creating it. Writes are skipped when the
+        // value is unchanged only if 'coalesce' is set, which must not be done
+        // for nodes the driver updates on its own (e.g. activate).
+        void open(const std::string &path, int flags, bool coalesce) {
+            mPath = path;
+            mCoalesce = coalesce;
+            mFd = TEMP_FAILURE_RETRY(::open(path.c_str(), flags | O_CLOEXEC));
+            if (mFd < 0) {
+                ALOGW("Failed to open %s (%d): %s", path.c_str(), errno, strerror(errno));
+            }
+        }
+
+        bool isOpen() const { return mFd >= 0; }
+
+        // Memory kept for the node, including its path.
+        size_t memory() const {
+            return sizeof(*this) + (mPath.capacity() > std::string().capacity() ? mPath.capacity()
+                                                                                  : 0);
+        }
+
+        bool write(bool value) { return write(value ? "1\n" : "0\n", 2); }
+
+        bool write(const std::string &value) {
+            char buf[VALUE_MAX];
+            if (value.size() + 1 > sizeof(buf)) {
+                errno = EINVAL;
+                return false;
+            }
+            memcpy(buf, value.data(), value.size());
+            buf[value.size()] = '\n';
+            return write(buf, value.size() + 1);
+        }
+
+        template <typename T>
+        bool write(T value) {
+            static_assert(std::is_integral_v<T>);
+            char buf[VALUE_MAX];
+            auto [end, ec] = std::to_chars(buf, buf + sizeof(buf) - 1, value);
+            if (ec != std::errc()) {
+                errno = EINVAL;
+                return false;
+            }
+            *end++ = '\n';
+            return write(buf, end - buf);
+        }
+
+        template <typename T>
+        bool read(T *value) {
+            static_assert(std::is_integral_v<T>);
+            char buf[32];
+            ssize_t len;
+
+            if (mFd < 0) {
+                errno = EBADF;
+                return false;
+            }
+            len = TEMP_FAILURE_RETRY(::pread(mFd, buf, sizeof(buf) - 1, 0));
+            if (len <= 0) {
+                return false;
+            }
+            buf[len] = '\0';
+
+            const char *begin = buf;
+            while (begin < buf + len && isspace(*begin)) {
+                begin++;
+            }
+            auto [end, ec] = std::from_chars(begin, buf + len, *value);
+            if (ec != std::errc() || end == begin) {
+                errno = EINVAL;
+                return false;
+            }
+            return true;
+        }
+
+        // Safe to call while another thread writes the node.
+        void debug(int fd) const {
+            char last[VALUE_MAX];
+            size_t lastLen;
+            uint32_t writeCount, skipCount;
+
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                memcpy(last, mLast, mLastLen);
+                lastLen = mLastLen;
+                writeCount = mWriteCount;
+                skipCount = mSkipCount;
+            }
+
+            dprintf(fd, "  %s: %.*s", mPath.c_str(), static_cast<int>(lastLen), last);
+            if (!lastLen) {
+                dprintf(fd, "\n");
+            }
+            dprintf(fd, "    written: %" PRIu32 ", skipped: %" PRIu32 "\n", writeCount,
+                    skipCount);
+        }
+
+      private:
+        bool write(const char *buf, size_t len) {
+            ssize_t ret;
+
+            if (mFd < 0) {
+                errno = EBADF;
+                return false;
+            }
+            // Writers are serialized by the HAL, but dump() reads the cache
+            // from a binder thread of its own.
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mCoalesce && len == mLastLen && !memcmp(buf, mLast, len)) {
+                mSkipCount++;
+                return true;
+            }
+            ret = TEMP_FAILURE_RETRY(::write(mFd, buf, len));
+            if (ret != static_cast<ssize_t>(len)) {
+                // The node state is now unknown, so force the next write out.
+                mLastLen = 0;
+                return false;
+            }
+            memcpy(mLast, buf, len);
+            mLastLen = len;
+            mWriteCount++;
+            return true;
+        }
+
+        std::string mPath;
+        int mFd{-1};
+        bool mCoalesce{false};
+        // Guards the last value and the counters.
+        mutable std::mutex mMutex;
+        char mLast[VALUE_MAX];
+        size_t mLastLen{0};
+        uint32_t mWriteCount{0};
+        uint32_t mSkipCount{0};
+    };
+
+  public:
+    static std::unique_ptr<HwApiFd> Create() {
+        auto hwapi = std::unique_ptr<HwApiFd>(new HwApiFd());
+        // the following nodes are required
+        if (!hwapi->mActivate.isOpen() || !hwapi->mDuration.isOpen() ||
+            !hwapi->mState.isOpen()) {
+            return nullptr;
+        }
+        return hwapi;
+    }
+
+    bool setAutocal(std::string value) override { return mAutocal.write(value); }
+    bool setOlLraPeriod(uint32_t value) override { return mOlLraPeriod.write(value); }
+    bool setActivate(bool value) override { return mActivate.write(value); }
+    bool setDuration(uint32_t value) override { return mDuration.write(value); }
+    bool setState(bool value) override { return mState.write(value); }
+    bool hasRtpInput() override { return mRtpInput.isOpen(); }
+    bool setRtpInput(int8_t value) override { return mRtpInput.write(value); }
+    bool setMode(std::string value) override { return mMode.write(value); }
+    bool setSequencer(std::string value) override { return mSequencer.write(value); }
+    bool setScale(uint8_t value) override { return mScale.write(value); }
+    bool setCtrlLoop(bool value) override { return mCtrlLoop.write(value); }
+    bool setLpTriggerEffect(uint32_t value) override { return mLpTrigger.write(value); }
+    bool setLraWaveShape(uint32_t value) override { return mLraWaveShape.write(value); }
+    bool setOdClamp(uint32_t value) override { return mOdClamp.write(value); }
+    bool getPATemp(int32_t *value) override { return mPATemp.read(value); }
+    bool getLraPeriod(uint32_t *value) override { return mLraPeriod.read(value); }
+    void debug(int fd) override {
+        dprintf(fd, "Kernel:\n");
+        for (auto node : {&mAutocal, &mOlLraPeriod, &mActivate, &mDuration, &mState, &mRtpInput,
+                          &mMode, &mSequencer, &mScale, &mCtrlLoop, &mLpTrigger, &mLraWaveShape,
+                          &mOdClamp, &mLraPeriod}) {
+            node->debug(fd);
+        }
+    }
+    // Counts the nodes held open and the memory kept for all of them.
+    void getNodeUsage(uint32_t *count, uint64_t *bytes) const {
+        *count = 0;
+        *bytes = 0;
+        for (auto node : {&mAutocal, &mOlLraPeriod, &mActivate, &mDuration, &mState, &mRtpInput,
+                          &mMode, &mSequencer, &mScale, &mCtrlLoop, &mLpTrigger, &mLraWaveShape,
+                          &mOdClamp, &mLraPeriod, &mPATemp}) {
+            *count += node->isOpen();
+            *bytes += node->memory();
+        }
+    }
+
   private:
-    static constexpr char AUTOCAL_CONFIG[] = "autocal";
-    static constexpr char LRA_PERIOD_CONFIG[] = "lra_period";
-    static constexpr char EFFECT_COEFF_CONFIG[] = "haptic_coefficient";
-    static constexpr char EFFECT_TARGET_G[] = "haptic_target_G";
-    static constexpr char STEADY_AMP_MAX_CONFIG[] = "vibration_amp_max";
-    static constexpr char STEADY_COEFF_CONFIG[] = "vibration_coefficient";
-    static constexpr char STEADY_TARGET_G[] = "vibration_target_G";
+    HwApiFd() {
+        const char *prefix = std::getenv("HWAPI_PATH_PREFIX");
+        mPathPrefix = prefix ? prefix : "";
+
+        open("device/autocal", &mAutocal, false);
+        open("device/ol_lra_period", &mOlLraPeriod, true);
+        open("activate", &mActivate, false);
+        open("duration", &mDuration, false);
+        open("state", &mState, false);
+        open("device/rtp_input", &mRtpInput, true);
+        open("device/mode", &mMode, true);
+        open("device/set_sequencer", &mSequencer, true);
+        open("device/scale", &mScale, true);
+        open("device/ctrl_loop", &mCtrlLoop, true);
+        open("device/lp_trigger_effect", &mLpTrigger, true);
+        open("device/lra_wave_shape", &mLraWaveShape, true);
+        open("device/od_clamp", &mOdClamp, true);
+        mLraPeriod.open(mPathPrefix + "device/lra_period", O_RDONLY, false);
+        // TODO: for future new architecture: b/149610125
+        mPATemp.open("/sys/devices/virtual/thermal/tz-by-name/pa-therm1/temp", O_RDONLY, false);
+    }
+
+    void open(const std::string &name, Node *node, bool coalesce) {
+        node->open(mPathPrefix + name, O_WRONLY, coalesce);
+    }
 
+  private:
+    std::string mPathPrefix;
+    Node mAutocal;
+    Node mOlLraPeriod;
+    Node mActivate;
+    Node mDuration;
+    Node mState;
+    Node mRtpInput;
+    Node mMode;
+    Node mSequencer;
+    Node mScale;
+    Node mCtrlLoop;
+    Node mLpTrigger;
+    Node mLraWaveShape;
+    Node mOdClamp;
+    Node mLraPeriod;
+    Node mPATemp;
+};
+
+// Persisted values come from a CalibrationSnapshot, loaded in the background
+// as soon as the HwCal is created so that the file is read while the caller
+// opens the hardware nodes. Only the getters of persisted values wait for it.
+// While watched, the snapshot is loaded again whenever the file changes.
+class HwCal : public Vibrator::HwCal {
+  private:
     static constexpr uint32_t WAVEFORM_CLICK_EFFECT_MS = 6;
     static constexpr uint32_t WAVEFORM_TICK_EFFECT_MS = 2;
     static constexpr uint32_t WAVEFORM_DOUBLE_CLICK_EFFECT_MS = 159;
@@ -114,51 +377,65 @@ class HwCal : public Vibrator::HwCal, private HwCalBase {
     static constexpr uint32_t DEFAULT_FREQUENCY_SHIFT = 10;
     static constexpr uint32_t DEFAULT_VOLTAGE_MAX = 107;  // 2.15V;
     static constexpr uint32_t DEFAULT_LP_TRIGGER_SUPPORT = 1;
+    static constexpr uint32_t DEFAULT_TEMPERATURE_MAX_AGE_MS = 1000;
+    static constexpr uint32_t DEFAULT_RESONANCE_INTERVAL_MS = 0;
+    // Property updates cannot be waited for, so overrides are polled. Sampling
+    // them takes microseconds, which makes a wakeup every few seconds cheap.
+    static constexpr uint32_t DEFAULT_RELOAD_INTERVAL_MS = 5000;
+
+    // Tuning properties, listed by debug(). Each may be overridden at runtime
+    // under the override prefix, which is what gets watched for changes.
+    static constexpr const char *PROPERTIES[] = {
+            "closeloop.threshold", "config.dynamic",     "long.frequency.shift",
+            "short.voltage",       "long.voltage",       "click.duration",
+            "tick.duration",       "heavyclick.duration", "effect.shape",
+            "steady.shape",        "lptrigger",          "temperature.maxage",
+            "resonance.interval",  "reload.interval",
+    };
+
+    using Field = CalibrationSnapshot::Field;
 
   public:
-    HwCal() {}
+    HwCal()
+        : mPropertyPrefix(getEnv("PROPERTY_PREFIX")),
+          mOverridePrefix(getEnv("OVERRIDE_PROPERTY_PREFIX")),
+          mPersistPath(getEnv("CALIBRATION_FILEPATH")),
+          mCachePath(getEnv("CALIBRATION_CACHEPATH")),
+          mAlwaysOnPath(getEnv("ALWAYSON_FILEPATH")),
+          mPersist(load()) {}
 
-    bool getAutocal(std::string *value) override { return getPersist(AUTOCAL_CONFIG, value); }
+    bool getAutocal(std::string *value) override {
+        return getPersist(Field::AUTOCAL, [&](const auto &data) { *value = data.autocal; });
+    }
     bool getLraPeriod(uint32_t *value) override {
-        if (getPersist(LRA_PERIOD_CONFIG, value)) {
+        if (getPersist(Field::LRA_PERIOD, [&](const auto &data) { *value = data.lraPeriod; })) {
             return true;
         }
         *value = DEFAULT_LRA_PERIOD;
         return true;
     }
     bool getEffectCoeffs(std::array<float, 4> *value) override {
-        if (getPersist(EFFECT_COEFF_CONFIG, value)) {
-            return true;
-        }
-        return false;
+        return getPersist(Field::EFFECT_COEFFS,
+                          [&](const auto &data) { *value = data.effectCoeffs; });
     }
     bool getEffectTargetG(std::array<float, 5> *value) override {
-      if (getPersist(EFFECT_TARGET_G, value)) {
-        return true;
-      }
-      return false;
+        return getPersist(Field::EFFECT_TARGET_G,
+                          [&](const auto &data) { *value = data.effectTargetG; });
     }
     bool getSteadyAmpMax(float *value) override {
-        if (getPersist(STEADY_AMP_MAX_CONFIG, value)) {
-            return true;
-        }
-        return false;
+        return getPersist(Field::STEADY_AMP_MAX,
+                          [&](const auto &data) { *value = data.steadyAmpMax; });
     }
     bool getSteadyCoeffs(std::array<float, 4> *value) override {
-        if (getPersist(STEADY_COEFF_CONFIG, value)) {
-            return true;
-        }
-        return false;
+        return getPersist(Field::STEADY_COEFFS,
+                          [&](const auto &data) { *value = data.steadyCoeffs; });
     }
     bool getSteadyTargetG(std::array<float, 3> *value) override {
-      if (getPersist(STEADY_TARGET_G, value)) {
-        return true;
-      }
-      return false;
+        return getPersist(Field::STEADY_TARGET_G,
+                          [&](const auto &data) { *value = data.steadyTargetG; });
     }
     bool getCloseLoopThreshold(uint32_t *value) override {
         return getProperty("closeloop.threshold", value, UINT32_MAX);
-        return true;
     }
     bool getDynamicConfig(bool *value) override {
         return getProperty("config.dynamic", value, false);
@@ -198,7 +475,155 @@ class HwCal : public Vibrator::HwCal, private HwCalBase {
       *value = ::android::base::GetProperty("ro.revision", "DVT");
       return true;
     }
-    void debug(int fd) override { HwCalBase::debug(fd); }
+    bool getTemperatureMaxAge(uint32_t *value) override {
+        return getProperty("temperature.maxage", value, DEFAULT_TEMPERATURE_MAX_AGE_MS);
+    }
+    bool getQFactor(float *value) override {
+        return getPersist(Field::Q_FACTOR, [&](const auto &data) { *value = data.qFactor; });
+    }
+    bool getResonanceInterval(uint32_t *value) override {
+        return getProperty("resonance.interval", value, DEFAULT_RESONANCE_INTERVAL_MS);
+    }
+    // Kept in a file, which outlives the HAL process but not the boot: init
+    // removes it in post-fs-data. A missing file means that the framework
+    // never configured the trigger since boot.
+    bool getAlwaysOnState(std::string *value) override {
+        value->clear();
+        if (mAlwaysOnPath.empty()) {
+            return false;
+        }
+        if (!::android::base::ReadFileToString(mAlwaysOnPath, value) && errno != ENOENT) {
+            ALOGE("Failed to read %s (%d): %s", mAlwaysOnPath.c_str(), errno, strerror(errno));
+            return false;
+        }
+        return true;
+    }
+    // Replaces the file atomically, so that a restarted HAL never reads a
+    // partial table.
+    bool setAlwaysOnState(const std::string &value) override {
+        const std::string temp = mAlwaysOnPath + ".tmp";
+
+        if (mAlwaysOnPath.empty()) {
+            return false;
+        }
+        if (!::android::base::WriteStringToFile(value, temp) ||
+            rename(temp.c_str(), mAlwaysOnPath.c_str())) {
+            ALOGE("Failed to write %s (%d): %s", mAlwaysOnPath.c_str(), errno, strerror(errno));
+            unlink(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+    // Properties are sampled every "reload.interval" ms, 5 s unless set, or
+    // never if 0.
+    void watch(std::function<void()> onChange) override {
+        uint32_t interval;
+
+        mWatcher.reset();
+        if (!onChange) {
+            return;
+        }
+        getProperty("reload.interval", &interval, DEFAULT_RELOAD_INTERVAL_MS);
+        mWatcher = std::make_unique<ConfigWatcher>(
+                mPersistPath, [this]() { return sampleProperties(); },
+                std::chrono::milliseconds(interval), [this, onChange]() {
+                    auto persist = load();
+                    persist.wait();
+                    {
+                        std::lock_guard<std::mutex> lock(mPersistMutex);
+                        mPersist = std::move(persist);
+                    }
+                    onChange();
+                });
+    }
+    void debug(int fd) override {
+        dprintf(fd, "Properties:\n");
+        for (const char *key : PROPERTIES) {
+            for (const auto &prefix : {mPropertyPrefix, mOverridePrefix}) {
+                const std::string name = prefix + key;
+                const std::string value =
+                        prefix.empty() ? "" : ::android::base::GetProperty(name, "");
+                if (!value.empty()) {
+                    dprintf(fd, "  %s: %s\n", name.c_str(), value.c_str());
+                }
+            }
+        }
+        persist().get().debug(fd);
+        if (mWatcher) {
+            mWatcher->debug(fd);
+        }
+    }
+
+  private:
+    static std::string getEnv(const char *name) {
+        const char *value = std::getenv(name);
+        return value ? value : "";
+    }
+
+    template <typename T>
+    static T readProperty(const std::string &name, const T defval) {
+        if constexpr (std::is_same_v<T, bool>) {
+            return ::android::base::GetBoolProperty(name, defval);
+        } else {
+            return ::android::base::GetUintProperty<T>(name, defval);
+        }
+    }
+
+    // An unset or malformed override falls back to the base property.
+    template <typename T>
+    bool getProperty(const char *key, T *value, const T defval) {
+        *value = readProperty(mPropertyPrefix + key, defval);
+        if (!mOverridePrefix.empty()) {
+            *value = readProperty(mOverridePrefix + key, *value);
+        }
+        return true;
+    }
+
+    std::shared_future<CalibrationSnapshot> load() const {
+        return std::async(std::launch::async, [this]() {
+                   StartupProfile::Scope scope(&StartupProfile::get(),
+                                               StartupProfile::Phase::LOAD_CALIBRATION);
+                   return CalibrationSnapshot::load(mPersistPath, mCachePath);
+               }).share();
+    }
+
+    std::shared_future<CalibrationSnapshot> persist() {
+        std::lock_guard<std::mutex> lock(mPersistMutex);
+        return mPersist;
+    }
+
+    template <typename F>
+    bool getPersist(Field field, F copy) {
+        // The copy of the future keeps the snapshot alive across a reload.
+        const auto future = persist();
+        const CalibrationSnapshot &snapshot = future.get();
+        if (!snapshot.has(field)) {
+            return false;
+        }
+        copy(snapshot.data());
+        return true;
+    }
+
+    // The base properties are read-only on device, so only the overrides can
+    // change once they are in use.
+    std::string sampleProperties() const {
+        const std::string &prefix = mOverridePrefix.empty() ? mPropertyPrefix : mOverridePrefix;
+        std::string sample;
+        for (const char *key : PROPERTIES) {
+            sample += ::android::base::GetProperty(prefix + key, "");
+            sample += '\n';
+        }
+        return sample;
+    }
+
+    const std::string mPropertyPrefix;
+    const std::string mOverridePrefix;
+    const std::string mPersistPath;
+    const std::string mCachePath;
+    const std::string mAlwaysOnPath;
+    std::mutex mPersistMutex;
+    std::shared_future<CalibrationSnapshot> mPersist;
+    std::unique_ptr<ConfigWatcher> mWatcher;
 };
 
 }  // namespace vibrator
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MotionAwareness.h"
+
+#include <log/log.h>
+#include <utils/SystemClock.h>
+
+#include <cinttypes>
+#include <cmath>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Sample the gravity sensor at 10Hz while enabled.
+static constexpr int32_t SAMPLING_PERIOD_US = 100000;
+// Suspend the sensor 10s after the last long vibration.
+static constexpr int64_t SUSPEND_TIMEOUT_NS = 10000000000;
+// The device is considered lying flat within these gravity bounds.
+static constexpr float FLAT_X_BOUND = 1.3f;
+static constexpr float FLAT_Y_BOUND = 0.8f;
+
+MotionAwareness::MotionAwareness(bool sensor) {
+    if (sensor) {
+        mThread = std::thread(&MotionAwareness::run, this);
+    }
+}
+
+MotionAwareness::~MotionAwareness() {
+    mExit = true;
+    if (ALooper *looper = mLooper.load()) {
+        ALooper_wake(looper);
+    }
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+    // Released here rather than on the looper thread so that a concurrent
+    // wake never touches a destroyed looper.
+    if (ALooper *looper = mLooper.load()) {
+        ALooper_release(looper);
+    }
+}
+
+bool MotionAwareness::isMoving() {
+    int64_t previous = mLastRequestNs.exchange(::android::elapsedRealtimeNano());
+    float avgX, avgY;
+
+    // Resume sampling if the looper thread may have suspended the sensor.
+    if (::android::elapsedRealtimeNano() - previous >= SUSPEND_TIMEOUT_NS) {
+        if (ALooper *looper = mLooper.load()) {
+            ALooper_wake(looper);
+        }
+    }
+
+    if (!mGravity.average(&avgX, &avgY, ::android::elapsedRealtimeNano())) {
+        return true;
+    }
+    return !((avgX > -FLAT_X_BOUND) && (avgX < FLAT_X_BOUND) && (avgY > -FLAT_Y_BOUND) &&
+             (avgY < FLAT_Y_BOUND));
+}
+
+void MotionAwareness::debug(int fd) {
+    float avgX = NAN, avgY = NAN;
+
+    mGravity.average(&avgX, &avgY, ::android::elapsedRealtimeNano());
+
+    dprintf(fd, "Motion Awareness:\n");
+    dprintf(fd, "  Avg X: %f\n", avgX);
+    dprintf(fd, "  Avg Y: %f\n", avgY);
+    dprintf(fd, "  Samples: %" PRIu32 "\n", mGravity.size());
+}
+
+int MotionAwareness::onSensorEvent(int /*fd*/, int /*events*/, void *data) {
+    auto *self = static_cast<MotionAwareness *>(data);
+    ASensorEvent events[8];
+    ssize_t count;
+
+    while ((count = ASensorEventQueue_getEvents(self->mQueue, events, 8)) > 0) {
+        for (ssize_t i = 0; i < count; i++) {
+            self->push(events[i].data[0], events[i].data[1], events[i].timestamp);
+        }
+    }
+
+    return 1;
+}
+
+void MotionAwareness::run() {
+    ASensorManager *sensorManager;
+    ASensorRef sensor;
+    ALooper *looper;
+    bool enabled = false;
+
+    sensorManager = ASensorManager_getInstanceForPackage("");
+    if (!sensorManager) {
+        ALOGE("%s: Sensor manager is NULL", __func__);
+        return;
+    }
+    sensor = ASensorManager_getDefaultSensor(sensorManager, ASENSOR_TYPE_GRAVITY);
+    if (!sensor) {
+        ALOGE("%s: Unable to get gravity sensor", __func__);
+        return;
+    }
+
+    looper = ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
+    mQueue = ASensorManager_createEventQueue(sensorManager, looper, 0, onSensorEvent, this);
+    if (!mQueue) {
+        ALOGE("%s: Unable to create sensor event queue", __func__);
+        return;
+    }
+    ALooper_acquire(looper);
+    mLooper = looper;
+
+    while (!mExit) {
+        int64_t idleNs = ::android::elapsedRealtimeNano() - mLastRequestNs.load();
+        bool active = idleNs < SUSPEND_TIMEOUT_NS;
+        int timeoutMs = -1;
+
+        if (active && !enabled) {
+            int err = ASensorEventQueue_registerSensor(mQueue, sensor, SAMPLING_PERIOD_US, 0);
+            if (err) {
+                ALOGE("%s: Error %d registering gravity sensor", __func__, err);
+            } else {
+                enabled = true;
+            }
+        } else if (!active && enabled) {
+            ASensorEventQueue_disableSensor(mQueue, sensor);
+            enabled = false;
+            // The average goes stale while suspended.
+            mGravity.reset();
+        }
+
+        if (enabled) {
+            timeoutMs = (SUSPEND_TIMEOUT_NS - idleNs) / 1000000 + 1;
+        }
+        ALooper_pollOnce(timeoutMs, nullptr, nullptr, nullptr);
+    }
+
+    if (enabled) {
+        ASensorEventQueue_disableSensor(mQueue, sensor);
+    }
+    ASensorManager_destroyEventQueue(sensorManager, mQueue);
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
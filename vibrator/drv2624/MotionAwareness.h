@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <android/looper.h>
+#include <android/sensor.h>
+
+#include <atomic>
+#include <thread>
+
+#include "GravityEwma.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Keeps the device orientation, as a moving average of the gravity samples,
+// from a dedicated looper thread, so that callers never wait on the sensor.
+// The sensor is enabled on demand and suspended again once no caller has asked
+// for the orientation for a while.
+class MotionAwareness {
+  public:
+    // Without 'sensor', the sensor thread is not started and samples only
+    // come from push().
+    explicit MotionAwareness(bool sensor = true);
+    ~MotionAwareness();
+
+    // Returns false if the device was last seen lying flat. Returns true while
+    // no recent estimate is available, which keeps the full vibration
+    // strength.
+    bool isMoving();
+    // Adds a gravity sample, as received from the sensor, taken at
+    // 'timestampNs' on the elapsed realtime clock.
+    void push(float x, float y, int64_t timestampNs) { mGravity.push(x, y, timestampNs); }
+    // Emit diagnostic information to the given file.
+    void debug(int fd);
+
+  private:
+    // Time for the average to follow 63% of a change, which reacts about as
+    // fast as averaging the last 2s of samples.
+    static constexpr int64_t TIME_CONSTANT_NS = 1000000000;
+    // Missing samples for this long, i.e. 10 sampling periods, means the
+    // sensor stopped, e.g. during a suspend, and the average is stale.
+    static constexpr int64_t GAP_NS = 1000000000;
+
+    static int onSensorEvent(int fd, int events, void *data);
+    void run();
+
+    std::atomic<bool> mExit{false};
+    std::atomic<ALooper *> mLooper{nullptr};
+    std::atomic<int64_t> mLastRequestNs{0};
+    GravityEwma mGravity{TIME_CONSTANT_NS, GAP_NS};
+
+    // Only accessed from the looper thread.
+    ASensorEventQueue *mQueue{nullptr};
+
+    std::thread mThread;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "OdClampTable.h"
+
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+
+#include "Calibration.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+static uint32_t interpolate(uint32_t cold, uint32_t hot, float weight) {
+    return std::round(cold + (static_cast<float>(hot) - static_cast<float>(cold)) * weight);
+}
+
+OdClampTable::OdClampTable(const Bound &cold, const Bound &hot)
+    : mColdTemperature(cold.temperature), mHotTemperature(hot.temperature) {
+    // A bound without a period, as left by an incomplete calibration, drives
+    // at the period of the other bound rather than at a period ramped up from
+    // zero, which would be far above the LRA band.
+    uint32_t coldPeriod = cold.olLraPeriod ? cold.olLraPeriod : hot.olLraPeriod;
+    uint32_t hotPeriod = hot.olLraPeriod ? hot.olLraPeriod : cold.olLraPeriod;
+    // The LRA period is interpolated in the frequency domain, which is where the
+    // cold frequency shift is specified. Periods too long to have a frequency
+    // are interpolated as they are.
+    uint32_t coldFreq = coldPeriod ? calibration::freqPeriodFormula(coldPeriod) : 0;
+    uint32_t hotFreq = hotPeriod ? calibration::freqPeriodFormula(hotPeriod) : 0;
+
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        Entry &entry = mEntries[i];
+
+        if (i == 0) {
+            entry = {cold.odClamp, cold.flatOdClamp, coldPeriod};
+        } else if (i == BUCKET_COUNT - 1) {
+            entry = {hot.odClamp, hot.flatOdClamp, hotPeriod};
+        } else {
+            float weight = static_cast<float>(i) / (BUCKET_COUNT - 1);
+            entry.odClamp = interpolate(cold.odClamp, hot.odClamp, weight);
+            entry.flatOdClamp = interpolate(cold.flatOdClamp, hot.flatOdClamp, weight);
+            entry.olLraPeriod =
+                    coldFreq && hotFreq && coldPeriod != hotPeriod
+                            ? calibration::freqPeriodFormula(interpolate(coldFreq, hotFreq, weight))
+                            : interpolate(coldPeriod, hotPeriod, weight);
+        }
+    }
+}
+
+size_t OdClampTable::bucket(int32_t temperature) const {
+    if (temperature < mColdTemperature) {
+        return 0;
+    }
+    if (temperature > mHotTemperature) {
+        return BUCKET_COUNT - 1;
+    }
+    // Spread [cold, hot] over the inner buckets.
+    int64_t offset = static_cast<int64_t>(temperature) - mColdTemperature;
+    int64_t span = static_cast<int64_t>(mHotTemperature) - mColdTemperature + 1;
+    return 1 + offset * (BUCKET_COUNT - 2) / span;
+}
+
+void OdClampTable::debug(int fd) const {
+    dprintf(fd, "  Steady Table (%" PRId32 " - %" PRId32 "):\n", mColdTemperature,
+            mHotTemperature);
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        const Entry &entry = mEntries[i];
+        dprintf(fd, "    %zu: OD Clamp %" PRIu32 " %" PRIu32 " OL LRA Period %" PRIu32 "\n", i,
+                entry.odClamp, entry.flatOdClamp, entry.olLraPeriod);
+    }
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Steady vibration registers per PA temperature bucket, resolved once from the
+// calibration so that on() only computes a bucket index. Between the cold and
+// hot bounds the OD clamp and the LRA frequency are interpolated, instead of
+// switching between the cold and hot settings.
+class OdClampTable {
+  public:
+    struct Entry {
+        uint32_t odClamp;
+        // OD clamp for long vibrations while the device lies flat.
+        uint32_t flatOdClamp;
+        uint32_t olLraPeriod;
+    };
+
+    struct Bound {
+        int32_t temperature;
+        uint32_t odClamp;
+        uint32_t flatOdClamp;
+        uint32_t olLraPeriod;
+    };
+
+    // One bucket below the cold bound and one above the hot bound; [cold, hot]
+    // is spread evenly over the buckets in between.
+    static constexpr size_t BUCKET_COUNT = 12;
+
+    OdClampTable() = default;
+    OdClampTable(const Bound &cold, const Bound &hot);
+
+    const Entry &lookup(int32_t temperature) const {
+        return mEntries[bucket(temperature)];
+    }
+    size_t bucket(int32_t temperature) const;
+    // Emit diagnostic information to the given file.
+    void debug(int fd) const;
+
+  private:
+    int32_t mColdTemperature{0};
+    int32_t mHotTemperature{0};
+    std::array<Entry, BUCKET_COUNT> mEntries{};
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
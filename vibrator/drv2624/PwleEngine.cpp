@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PwleEngine.h"
+
+#include <log/log.h>
+#include <pthread.h>
+#include <sched.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstring>
+
+#include "Calibration.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+static constexpr int THREAD_PRIORITY = 2;
+static constexpr int8_t MAX_RTP_INPUT = 127;
+
+PwleEngine::PwleEngine(Output output, CompletionEngine *completion)
+    : mOutput(std::move(output)), mCompletion(completion) {
+    mThread = std::thread(&PwleEngine::run, this);
+}
+
+PwleEngine::~PwleEngine() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExit = true;
+    }
+    mCondition.notify_one();
+    mThread.join();
+}
+
+size_t PwleEngine::render(const std::vector<PrimitivePwle> &composite, Sample *samples) {
+    uint64_t elapsedUs = 0;
+    size_t count = 0;
+    // Braking keeps the last frequency; zero leaves the LRA period unchanged.
+    float frequency = 0.0f;
+
+    for (const auto &pwle : composite) {
+        float startAmplitude, endAmplitude, startFrequency, endFrequency;
+        int32_t durationMs;
+
+        if (pwle.getTag() == PrimitivePwle::active) {
+            const auto &active = pwle.get<PrimitivePwle::active>();
+            startAmplitude = active.startAmplitude;
+            endAmplitude = active.endAmplitude;
+            startFrequency = active.startFrequency;
+            endFrequency = active.endFrequency;
+            durationMs = active.duration;
+            frequency = endFrequency;
+        } else {
+            const auto &braking = pwle.get<PrimitivePwle::braking>();
+            startAmplitude = endAmplitude = 0.0f;
+            startFrequency = endFrequency = frequency;
+            durationMs = braking.duration;
+        }
+
+        uint64_t endUs = elapsedUs + static_cast<uint64_t>(durationMs) * 1000;
+        size_t ticks = endUs / TICK_US - elapsedUs / TICK_US;
+        elapsedUs = endUs;
+
+        for (size_t i = 0; i < ticks && count < SAMPLES_MAX; i++) {
+            float t = static_cast<float>(i) / ticks;
+            float amplitude = startAmplitude + (endAmplitude - startAmplitude) * t;
+            float freqHz = startFrequency + (endFrequency - startFrequency) * t;
+
+            samples[count++] = {
+                    .rtpInput = static_cast<int8_t>(std::round(amplitude * MAX_RTP_INPUT)),
+                    .olLraPeriod = freqHz > 0.0f ? calibration::frequencyToPeriod(freqHz) : 0,
+            };
+        }
+    }
+
+    return count;
+}
+
+void PwleEngine::start(const std::vector<PrimitivePwle> &composite,
+                       const std::shared_ptr<IVibratorCallback> &callback) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    cancelLocked();
+
+    mCount = render(composite, mSamples.data());
+    mPosition = 0;
+    mCallback = callback;
+
+    if (!mCount) {
+        mCompletion->start(0, mCallback);
+        mCallback.reset();
+        return;
+    }
+
+    mCondition.notify_one();
+}
+
+void PwleEngine::cancel() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    cancelLocked();
+}
+
+void PwleEngine::debug(int fd) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+
+    dprintf(fd, "PWLE:\n");
+    dprintf(fd, "  Pending Samples: %zu\n", mCount - mPosition);
+    dprintf(fd, "  Played: %" PRIu32 "\n", mPlayed);
+    dprintf(fd, "  Cancelled: %" PRIu32 "\n", mCancelled);
+    dprintf(fd, "  Failed: %" PRIu32 "\n", mFailed);
+    dprintf(fd, "  Tick: %" PRIu32 "us\n", TICK_US);
+    if (mSchedError) {
+        dprintf(fd, "  Scheduling: default, SCHED_FIFO failed: %s\n", strerror(mSchedError));
+    } else {
+        dprintf(fd, "  Scheduling: SCHED_FIFO %d\n", THREAD_PRIORITY);
+    }
+    dprintf(fd, "  Jitter: mean %" PRId64 "us, max %" PRId64 "us over %" PRIu64 " ticks\n",
+            mTicks ? static_cast<int64_t>(duration_cast<microseconds>(mJitterTotal).count() /
+                                          static_cast<int64_t>(mTicks))
+                   : 0,
+            static_cast<int64_t>(duration_cast<microseconds>(mJitterMax).count()), mTicks);
+}
+
+void PwleEngine::cancelLocked() {
+    if (mPosition != mCount) {
+        mCancelled++;
+    }
+    mPosition = mCount = 0;
+    if (mActive) {
+        mOutput.stop();
+        mOutput.end();
+        mActive = false;
+    }
+    if (mCallback) {
+        mCompletion->start(0, mCallback);
+        mCallback.reset();
+    }
+}
+
+void PwleEngine::run() {
+    struct sched_param param = {.sched_priority = THREAD_PRIORITY};
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+    // Needs CAP_SYS_NICE, granted in the service's rc file.
+    if (error) {
+        ALOGW("Failed to set PWLE thread priority (%d): %s", error, strerror(error));
+    }
+
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    mSchedError = error;
+
+    while (!mExit) {
+        if (mPosition == mCount) {
+            mCondition.wait(lock);
+            continue;
+        }
+
+        Clock::time_point now = Clock::now();
+        bool ok;
+
+        // Samples are written with the lock held so that cancel() guarantees
+        // the engine no longer touches the hardware once it returns.
+        if (!mActive) {
+            ATRACE_NAME("Vibrator::composePwle begin");
+            ok = mOutput.write(mSamples[mPosition]) &&
+                 mOutput.begin((mCount * TICK_US + 999) / 1000);
+            mActive = true;
+            mDue = now;
+        } else if (now < mDue) {
+            mCondition.wait_until(lock, mDue);
+            continue;
+        } else {
+            Clock::duration jitter = now - mDue;
+            mTicks++;
+            mJitterTotal += jitter;
+            mJitterMax = std::max(mJitterMax, jitter);
+            ok = mOutput.write(mSamples[mPosition]);
+        }
+
+        if (!ok) {
+            ALOGE("Failed to stream PWLE sample");
+            mFailed++;
+            mPosition = mCount;
+        } else {
+            mPosition++;
+        }
+        mDue += std::chrono::microseconds(TICK_US);
+
+        if (mPosition == mCount) {
+            if (!ok) {
+                mOutput.stop();
+            }
+            mOutput.end();
+            mActive = false;
+            if (ok) {
+                mPlayed++;
+            }
+            mCompletion->start(ok ? TICK_US / 1000 : 0, mCallback);
+            mCallback.reset();
+        }
+    }
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
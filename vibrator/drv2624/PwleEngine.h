@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <aidl/android/hardware/vibrator/PrimitivePwle.h>
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CompletionEngine.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Plays PWLE compositions by streaming an amplitude and frequency envelope
+// into the RTP input and open-loop LRA period from a real-time thread, one
+// sample per fixed tick. The envelope is rendered up front into a buffer
+// sized for the longest composition, so playback never allocates.
+class PwleEngine {
+  public:
+    static constexpr uint32_t TICK_US = 5000;
+    static constexpr uint32_t PRIMITIVE_DURATION_MAX_MS = 1000;
+    static constexpr size_t COMPOSITION_SIZE_MAX = 16;
+    static constexpr size_t SAMPLES_MAX =
+            COMPOSITION_SIZE_MAX * PRIMITIVE_DURATION_MAX_MS * 1000 / TICK_US;
+
+    struct Sample {
+        int8_t rtpInput;
+        uint32_t olLraPeriod;
+    };
+
+    // Hardware access, invoked from the engine thread with the engine lock
+    // held.
+    struct Output {
+        // Prepares RTP playback lasting 'durationMs' and activates it.
+        std::function<bool(uint32_t durationMs)> begin;
+        std::function<bool(const Sample &sample)> write;
+        // Stops RTP playback cut short by a cancel or a failed write.
+        std::function<void()> stop;
+        // Restores the state changed by playback once streaming stops.
+        std::function<void()> end;
+    };
+
+    // Completion of each composition is reported through 'completion'.
+    PwleEngine(Output output, CompletionEngine *completion);
+    ~PwleEngine();
+
+    // Renders 'composite' into samples, which must fit in SAMPLES_MAX.
+    // Returns the number of samples written to 'samples'.
+    static size_t render(const std::vector<PrimitivePwle> &composite, Sample *samples);
+
+    // Replaces any composition in progress. 'composite' must have been
+    // validated against the limits above.
+    void start(const std::vector<PrimitivePwle> &composite,
+               const std::shared_ptr<IVibratorCallback> &callback);
+    // Stops streaming and completes the composition callback.
+    void cancel();
+    // Emit diagnostic information to the given file.
+    void debug(int fd);
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    void cancelLocked();
+    void run();
+
+    const Output mOutput;
+    CompletionEngine *const mCompletion;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::array<Sample, SAMPLES_MAX> mSamples;
+    size_t mPosition{0};
+    size_t mCount{0};
+    bool mActive{false};
+    Clock::time_point mDue;
+    std::shared_ptr<IVibratorCallback> mCallback;
+    bool mExit{false};
+    // Set by the thread once it has requested real-time scheduling.
+    int mSchedError{0};
+
+    uint32_t mPlayed{0};
+    uint32_t mCancelled{0};
+    uint32_t mFailed{0};
+    // Lateness of each tick against its schedule.
+    uint64_t mTicks{0};
+    Clock::duration mJitterTotal{0};
+    Clock::duration mJitterMax{0};
+
+    std::thread mThread;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ResonanceTracker.h"
+
+#include <log/log.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <cinttypes>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+ResonanceTracker::ResonanceTracker(Output output, std::chrono::milliseconds interval,
+                                   std::chrono::milliseconds idleTime,
+                                   std::chrono::milliseconds runTime)
+    : mOutput(std::move(output)), mInterval(interval), mIdleTime(idleTime), mRunTime(runTime) {
+    mLastActivity = mLastRun = Clock::now();
+    if (mInterval.count()) {
+        mThread = std::thread(&ResonanceTracker::run, this);
+    }
+}
+
+ResonanceTracker::~ResonanceTracker() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mExit = true;
+    }
+    mCondition.notify_one();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void ResonanceTracker::interrupt() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    // Playback which is still going keeps its end.
+    mLastActivity = std::max(mLastActivity, Clock::now());
+    if (mRunning) {
+        mOutput.abort();
+        mRunning = false;
+        mAborted++;
+        mCondition.notify_one();
+    }
+}
+
+void ResonanceTracker::hold(std::chrono::milliseconds duration) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mLastActivity = Clock::now() + duration;
+    mCondition.notify_one();
+}
+
+bool ResonanceTracker::takeLraPeriod(uint32_t *lraPeriod) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!mPending) {
+        return false;
+    }
+    mPending = false;
+    *lraPeriod = mLraPeriod;
+    return true;
+}
+
+void ResonanceTracker::debug(int fd) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    dprintf(fd, "Resonance:\n");
+    dprintf(fd, "  Interval: %" PRId64 "s\n",
+            static_cast<int64_t>(std::chrono::duration_cast<std::chrono::seconds>(mInterval)
+                                         .count()));
+    dprintf(fd, "  Measured LRA Period: %" PRIu32 "\n", mLraPeriod);
+    dprintf(fd, "  Runs: %" PRIu32 ", Aborted: %" PRIu32 ", Failed: %" PRIu32 "\n", mRuns,
+            mAborted, mFailed);
+}
+
+void ResonanceTracker::run() {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (!mExit) {
+        Clock::time_point due = std::max(mLastRun + mInterval, mLastActivity + mIdleTime);
+        if (Clock::now() < due) {
+            mCondition.wait_until(lock, due);
+            continue;
+        }
+
+        ATRACE_NAME("Vibrator::trackResonance");
+        mLastRun = Clock::now();
+        mRuns++;
+        if (!mOutput.begin()) {
+            ALOGE("Failed to start resonance measurement");
+            mOutput.abort();
+            mFailed++;
+            continue;
+        }
+
+        // Wait out the run unless the HAL takes the hardware back, in which
+        // case interrupt() has already aborted it.
+        mRunning = true;
+        mCondition.wait_for(lock, mRunTime, [this] { return !mRunning || mExit; });
+        if (!mRunning) {
+            continue;
+        }
+        mRunning = false;
+        if (mExit) {
+            mOutput.abort();
+            continue;
+        }
+
+        uint32_t lraPeriod;
+        if (!mOutput.finish(&lraPeriod)) {
+            ALOGE("Failed to read resonance measurement");
+            mOutput.abort();
+            mFailed++;
+            continue;
+        }
+        mLraPeriod = lraPeriod;
+        mPending = true;
+    }
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Periodically re-measures the LRA resonance by running the DRV2624 auto
+// calibration once the vibrator has been idle for a while. The idle period
+// starts when the last playback ends, so no run starts while the driver is
+// still active. A run is aborted as soon as the HAL needs the hardware again,
+// and its result is then dropped.
+class ResonanceTracker {
+  public:
+    // Hardware access, invoked with the tracker lock held.
+    struct Output {
+        // Starts a calibration run.
+        std::function<bool()> begin;
+        // Reads the LRA period measured by the finished run.
+        std::function<bool(uint32_t *lraPeriod)> finish;
+        // Stops a run which is cut short or fails, and restores the state it
+        // changed.
+        std::function<void()> abort;
+    };
+
+    // Time without vibrations before a run may start.
+    static constexpr std::chrono::milliseconds IDLE_TIME{std::chrono::minutes(5)};
+    // Upper bound on the duration of a calibration run.
+    static constexpr std::chrono::milliseconds RUN_TIME{1200};
+
+    // A zero 'interval' disables tracking.
+    ResonanceTracker(Output output, std::chrono::milliseconds interval,
+                     std::chrono::milliseconds idleTime = IDLE_TIME,
+                     std::chrono::milliseconds runTime = RUN_TIME);
+    ~ResonanceTracker();
+
+    // Aborts a run in progress and restarts the idle period. Must be called
+    // before the hardware is used, which is restored once it returns.
+    void interrupt();
+    // Records playback lasting 'duration' from now, which replaces the
+    // previous one, so that the idle period only starts once it ends. A zero
+    // 'duration' records that playback has stopped.
+    void hold(std::chrono::milliseconds duration);
+    // Returns the LRA period measured since the last call, if any.
+    bool takeLraPeriod(uint32_t *lraPeriod);
+    // Emit diagnostic information to the given file.
+    void debug(int fd);
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    void run();
+
+    const Output mOutput;
+    const Clock::duration mInterval;
+    const Clock::duration mIdleTime;
+    const Clock::duration mRunTime;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    // End of the last use of the hardware, in the future while playing.
+    Clock::time_point mLastActivity;
+    Clock::time_point mLastRun;
+    bool mRunning{false};
+    bool mPending{false};
+    uint32_t mLraPeriod{0};
+    bool mExit{false};
+
+    uint32_t mRuns{0};
+    uint32_t mAborted{0};
+    uint32_t mFailed{0};
+
+    std::thread mThread;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
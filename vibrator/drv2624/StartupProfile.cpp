@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StartupProfile.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <iterator>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+
+// Indexed by Phase.
+static constexpr const char *PHASE_NAMES[] = {
+        "open nodes",
+        "load calibration",
+        "build config",
+        "register service",
+};
+
+static_assert(std::size(PHASE_NAMES) == static_cast<size_t>(StartupProfile::Phase::COUNT));
+
+StartupProfile::Scope::Scope(StartupProfile *profile, Phase phase)
+    : mProfile(profile), mPhase(phase), mBegin(Clock::now()), mBefore(sampleUsage()) {}
+
+StartupProfile::Scope::~Scope() {
+    const auto end = Clock::now();
+    mProfile->record(mPhase, mBegin, end, mBefore, sampleUsage());
+}
+
+StartupProfile &StartupProfile::get() {
+    static StartupProfile profile;
+    return profile;
+}
+
+StartupProfile::Usage StartupProfile::sampleUsage() {
+    Usage usage{};
+
+    // The directory stream holds a descriptor of its own, which is not counted.
+    if (DIR *dir = opendir("/proc/self/fd")) {
+        while (const struct dirent *entry = readdir(dir)) {
+            if (entry->d_name[0] != '.') {
+                usage.fds++;
+            }
+        }
+        closedir(dir);
+        if (usage.fds) {
+            usage.fds--;
+        }
+    }
+
+    int fd = TEMP_FAILURE_RETRY(open("/proc/self/statm", O_RDONLY | O_CLOEXEC));
+    if (fd >= 0) {
+        char buf[128];
+        ssize_t len = TEMP_FAILURE_RETRY(read(fd, buf, sizeof(buf) - 1));
+        uint64_t size, resident;
+
+        if (len > 0) {
+            buf[len] = '\0';
+            if (sscanf(buf, "%" SCNu64 " %" SCNu64, &size, &resident) == 2) {
+                usage.rssBytes = resident * sysconf(_SC_PAGESIZE);
+            }
+        }
+        close(fd);
+    }
+    return usage;
+}
+
+void StartupProfile::record(Phase phase, Clock::time_point begin, Clock::time_point end,
+                            const Usage &before, const Usage &after) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Span &span = mSpans[static_cast<size_t>(phase)];
+
+    if (span.recorded) {
+        return;
+    }
+    span = {
+            .recorded = true,
+            .begin = begin - mCreated,
+            .elapsed = end - begin,
+            .before = before,
+            .after = after,
+    };
+}
+
+void StartupProfile::setNodes(uint32_t count, uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mNodeCount = count;
+    mNodeBytes = bytes;
+}
+
+StartupProfile::Span StartupProfile::span(Phase phase) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mSpans[static_cast<size_t>(phase)];
+}
+
+void StartupProfile::debug(int fd) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    dprintf(fd, "Startup Profile:\n");
+    for (size_t i = 0; i < mSpans.size(); i++) {
+        const Span &span = mSpans[i];
+        if (!span.recorded) {
+            continue;
+        }
+        dprintf(fd,
+                "  %s: at %" PRId64 "us, took %" PRId64 "us, fds %+" PRId64 ", rss %+" PRId64
+                "KiB\n",
+                PHASE_NAMES[i], static_cast<int64_t>(duration_cast<microseconds>(span.begin).count()),
+                static_cast<int64_t>(duration_cast<microseconds>(span.elapsed).count()),
+                static_cast<int64_t>(span.after.fds) - span.before.fds,
+                (static_cast<int64_t>(span.after.rssBytes) -
+                 static_cast<int64_t>(span.before.rssBytes)) /
+                        1024);
+    }
+    dprintf(fd, "  Nodes: %" PRIu32 " open, %" PRIu64 " bytes\n", mNodeCount, mNodeBytes);
+
+    const Usage usage = sampleUsage();
+    dprintf(fd, "  Now: fds %" PRIu32 ", rss %" PRIu64 "KiB\n", usage.fds, usage.rssBytes / 1024);
+}
+
+const char *StartupProfile::getName(Phase phase) {
+    return PHASE_NAMES[static_cast<size_t>(phase)];
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
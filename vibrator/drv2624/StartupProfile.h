@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Time taken by each phase of the HAL start, with the file descriptors and
+// resident memory it added, for dump(). Only the first run of a phase is
+// kept, so that later reloads do not overwrite the boot-time numbers. Phases
+// may run on different threads and overlap, e.g. the calibration is loaded
+// while the nodes are opened, in which case their usage deltas overlap too.
+class StartupProfile {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Phase : uint8_t {
+        OPEN_NODES,
+        LOAD_CALIBRATION,
+        BUILD_CONFIG,
+        REGISTER_SERVICE,
+        COUNT,
+    };
+
+    // Process-wide resource usage, from /proc/self.
+    struct Usage {
+        uint32_t fds;
+        uint64_t rssBytes;
+    };
+
+    struct Span {
+        bool recorded;
+        // Since the profile was created.
+        Clock::duration begin;
+        Clock::duration elapsed;
+        Usage before;
+        Usage after;
+    };
+
+    // Records a phase over its lifetime.
+    class Scope {
+      public:
+        Scope(StartupProfile *profile, Phase phase);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+      private:
+        StartupProfile *const mProfile;
+        const Phase mPhase;
+        const Clock::time_point mBegin;
+        const Usage mBefore;
+    };
+
+    // The profile of this process.
+    static StartupProfile &get();
+    static Usage sampleUsage();
+
+    void record(Phase phase, Clock::time_point begin, Clock::time_point end, const Usage &before,
+                const Usage &after);
+    // Hardware nodes held open, and the memory kept for them by the HAL.
+    void setNodes(uint32_t count, uint64_t bytes);
+    Span span(Phase phase) const;
+    // Emit diagnostic information to the given file.
+    void debug(int fd) const;
+
+    static const char *getName(Phase phase);
+
+  private:
+    const Clock::time_point mCreated{Clock::now()};
+    mutable std::mutex mMutex;
+    std::array<Span, static_cast<size_t>(Phase::COUNT)> mSpans{};
+    uint32_t mNodeCount{0};
+    uint64_t mNodeBytes{0};
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
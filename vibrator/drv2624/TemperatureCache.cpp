@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TemperatureCache.h"
+
+#include <cutils/uevent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <log/log.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <charconv>
+#include <cinttypes>
+#include <cstring>
+#include <string_view>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+static constexpr size_t UEVENT_MSG_LEN = 2048;
+
+static constexpr char THERMAL_ZONE_PATH[] = "/sys/devices/virtual/thermal/tz-by-name/";
+static constexpr char SYSFS_ROOT[] = "/sys";
+// Thermal zones only report their temperature through "change" uevents.
+static constexpr char UEVENT_ACTION[] = "change@";
+
+static constexpr uint32_t FILTER_ACCEPT = 0xffffffff;
+static constexpr uint32_t FILTER_DROP = 0;
+
+TemperatureCache::TemperatureCache(ReadFunction read, std::chrono::milliseconds maxAge,
+                                   const std::string &zone)
+    : mRead(std::move(read)), mMaxAge(maxAge), mZone(zone) {
+    struct epoll_event ev = {.events = EPOLLIN, .data = {}};
+
+    if (mZone.empty()) {
+        return;
+    }
+
+    if (!openUeventSocket()) {
+        ALOGW("Not listening to %s uevents, relying on the cache age", mZone.c_str());
+        return;
+    }
+
+    mEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEventFd < 0 || mEpollFd < 0) {
+        ALOGE("Failed to create temperature cache fds (%d): %s", errno, strerror(errno));
+        return;
+    }
+    ev.data.fd = mUeventFd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mUeventFd, &ev)) {
+        ALOGE("Failed to add uevent socket (%d): %s", errno, strerror(errno));
+        return;
+    }
+    ev.data.fd = mEventFd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mEventFd, &ev)) {
+        ALOGE("Failed to add eventfd (%d): %s", errno, strerror(errno));
+        return;
+    }
+
+    mThread = std::thread(&TemperatureCache::run, this);
+}
+
+TemperatureCache::~TemperatureCache() {
+    if (mThread.joinable()) {
+        uint64_t value = 1;
+        (void)TEMP_FAILURE_RETRY(write(mEventFd, &value, sizeof(value)));
+        mThread.join();
+    }
+    for (int fd : {mUeventFd, mEventFd, mEpollFd}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+bool TemperatureCache::get(int32_t *value) {
+    Clock::rep updated = mUpdated.load(std::memory_order_acquire);
+
+    if (updated && Clock::now().time_since_epoch().count() - updated < mMaxAge.count()) {
+        *value = mValue.load(std::memory_order_relaxed);
+        mHits++;
+        return true;
+    }
+
+    mReads++;
+    if (!mRead(value)) {
+        return false;
+    }
+    update(*value);
+    return true;
+}
+
+void TemperatureCache::onUevent(const char *msg, size_t len) {
+    const char *end = msg + len;
+    bool thermal = false, zone = false;
+    std::string_view temp;
+
+    for (const char *cp = msg; cp < end; cp += strnlen(cp, end - cp) + 1) {
+        std::string_view field(cp, strnlen(cp, end - cp));
+
+        if (field == "SUBSYSTEM=thermal") {
+            thermal = true;
+        } else if (field.substr(0, 5) == "NAME=") {
+            zone = field.substr(5) == mZone;
+        } else if (field.substr(0, 5) == "TEMP=") {
+            temp = field.substr(5);
+        }
+    }
+
+    if (!thermal || !zone) {
+        return;
+    }
+
+    mUevents++;
+    int32_t value;
+    auto [ptr, ec] = std::from_chars(temp.data(), temp.data() + temp.size(), value);
+    if (temp.empty() || ec != std::errc()) {
+        // The zone changed but did not report its temperature, so read it on
+        // the next request.
+        mUpdated.store(0, std::memory_order_release);
+        return;
+    }
+    update(value);
+}
+
+void TemperatureCache::debug(int fd) {
+    dprintf(fd, "Temperature:\n");
+    dprintf(fd, "  Value: %" PRId32 "\n", mValue.load());
+    dprintf(fd, "  Max Age: %" PRId64 "ms\n",
+            static_cast<int64_t>(
+                    std::chrono::duration_cast<std::chrono::milliseconds>(mMaxAge).count()));
+    dprintf(fd, "  Zone: %s\n", mZone.c_str());
+    dprintf(fd, "  Hits: %" PRIu32 ", Reads: %" PRIu32 ", Uevents: %" PRIu32 "\n", mHits.load(),
+            mReads.load(), mUevents.load());
+}
+
+std::vector<sock_filter> TemperatureCache::buildUeventFilter(const std::string &devpath) {
+    const std::string header = UEVENT_ACTION + devpath;
+    // The header is NUL terminated, so an exact match also checks that byte.
+    const uint32_t end = header.size() + 1;
+    std::vector<sock_filter> program;
+    std::vector<size_t> failJumps;
+    uint32_t offset = 0;
+
+    auto emitCheck = [&](uint32_t value) {
+        failJumps.push_back(program.size());
+        program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, value, 0, 0));
+    };
+
+    // Loads past the end of the message would abort the whole program.
+    program.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0));
+    failJumps.push_back(program.size());
+    program.push_back(BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, end, 0, 0));
+
+    // Absolute loads are big endian.
+    while (offset < end) {
+        const uint32_t size = end - offset >= 4 ? 4 : end - offset >= 2 ? 2 : 1;
+        const uint16_t width = size == 4 ? BPF_W : size == 2 ? BPF_H : BPF_B;
+        uint32_t value = 0;
+
+        for (uint32_t i = 0; i < size; i++) {
+            const uint32_t pos = offset + i;
+            value = (value << 8) | (pos < header.size() ? static_cast<uint8_t>(header[pos]) : 0);
+        }
+        program.push_back(BPF_STMT(BPF_LD | width | BPF_ABS, offset));
+        emitCheck(value);
+        offset += size;
+    }
+    program.push_back(BPF_STMT(BPF_RET | BPF_K, FILTER_ACCEPT));
+    program.push_back(BPF_STMT(BPF_RET | BPF_K, FILTER_DROP));
+
+    for (size_t jump : failJumps) {
+        const size_t skip = program.size() - 1 - (jump + 1);
+        if (skip > UINT8_MAX) {
+            ALOGE("Devpath too long for a uevent filter: %s", devpath.c_str());
+            return {};
+        }
+        program[jump].jf = skip;
+    }
+    return program;
+}
+
+bool TemperatureCache::openUeventSocket() {
+    const std::string link = THERMAL_ZONE_PATH + mZone;
+    char path[PATH_MAX];
+
+    if (!realpath(link.c_str(), path)) {
+        ALOGE("Failed to resolve %s (%d): %s", link.c_str(), errno, strerror(errno));
+        return false;
+    }
+    if (strncmp(path, SYSFS_ROOT, strlen(SYSFS_ROOT)) || path[strlen(SYSFS_ROOT)] != '/') {
+        ALOGE("Unexpected path for %s: %s", link.c_str(), path);
+        return false;
+    }
+
+    auto program = buildUeventFilter(path + strlen(SYSFS_ROOT));
+    const sock_fprog fprog = {
+            .len = static_cast<unsigned short>(program.size()),
+            .filter = program.data(),
+    };
+    if (program.empty()) {
+        return false;
+    }
+
+    mUeventFd = uevent_open_socket(64 * 1024, true);
+    if (mUeventFd < 0) {
+        ALOGE("Failed to open uevent socket (%d): %s", errno, strerror(errno));
+        return false;
+    }
+    if (setsockopt(mUeventFd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog))) {
+        ALOGE("Failed to attach uevent filter (%d): %s", errno, strerror(errno));
+        close(mUeventFd);
+        mUeventFd = -1;
+        return false;
+    }
+    fcntl(mUeventFd, F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+void TemperatureCache::update(int32_t value) {
+    mValue.store(value, std::memory_order_relaxed);
+    mUpdated.store(Clock::now().time_since_epoch().count(), std::memory_order_release);
+}
+
+void TemperatureCache::run() {
+    char msg[UEVENT_MSG_LEN + 2];
+
+    while (true) {
+        struct epoll_event ev;
+        int n = TEMP_FAILURE_RETRY(epoll_wait(mEpollFd, &ev, 1, -1));
+        if (n < 0) {
+            ALOGE("Failed to wait for uevents (%d): %s", errno, strerror(errno));
+            return;
+        }
+        if (ev.data.fd == mEventFd) {
+            return;
+        }
+
+        ssize_t len;
+        while ((len = uevent_kernel_multicast_recv(mUeventFd, msg, UEVENT_MSG_LEN)) > 0) {
+            if (len >= static_cast<ssize_t>(UEVENT_MSG_LEN)) {
+                // Overflow, drop the message.
+                continue;
+            }
+            msg[len] = '\0';
+            msg[len + 1] = '\0';
+            onUevent(msg, len);
+        }
+    }
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <linux/filter.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+// Serves the PA temperature from a cache which is refreshed at most once per
+// 'maxAge'. When given a thermal zone name, a uevent thread also applies the
+// temperature reported by that zone's uevents, so that trip point crossings
+// are seen without waiting for the cache to expire. The uevent socket is
+// filtered down to that zone, and without a filter the thread is not started,
+// leaving the cache age as the only bound.
+class TemperatureCache {
+  public:
+    using ReadFunction = std::function<bool(int32_t *)>;
+
+    TemperatureCache(ReadFunction read, std::chrono::milliseconds maxAge,
+                     const std::string &zone = "");
+    ~TemperatureCache();
+
+    // Returns the cached temperature, reading it again if it is too old.
+    bool get(int32_t *value);
+    // Applies a uevent received from the kernel. 'len' covers the whole
+    // message, including the NUL separators.
+    void onUevent(const char *msg, size_t len);
+    // Emit diagnostic information to the given file.
+    void debug(int fd);
+
+    // Returns a socket filter which only accepts the "change" uevents of the
+    // device at 'devpath', or an empty program if it cannot be built.
+    static std::vector<sock_filter> buildUeventFilter(const std::string &devpath);
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    void update(int32_t value);
+    bool openUeventSocket();
+    void run();
+
+    const ReadFunction mRead;
+    const Clock::duration mMaxAge;
+    const std::string mZone;
+
+    std::atomic<int32_t> mValue{0};
+    // Time of the last update, or zero if the cache must be refreshed.
+    std::atomic<Clock::rep> mUpdated{0};
+
+    std::atomic<uint32_t> mHits{0};
+    std::atomic<uint32_t> mReads{0};
+    std::atomic<uint32_t> mUevents{0};
+
+    int mUeventFd{-1};
+    int mEventFd{-1};
+    int mEpollFd{-1};
+    std::thread mThread;
+};
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -15,10 +15,9 @@
  */
 
 #include "Vibrator.h"
+#include "Calibration.h"
 #include "utils.h"
 
-#include <android/looper.h>
-#include <android/sensor.h>
 #include <cutils/properties.h>
 #include <hardware/hardware.h>
 #include <hardware/vibrator.h>
@@ -26,20 +25,17 @@
 #include <utils/Errors.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <cinttypes>
 #include <cmath>
 #include <fstream>
 #include <iostream>
-#include <numeric>
 
 namespace aidl {
 namespace android {
 namespace hardware {
 namespace vibrator {
 
-using ::android::NO_ERROR;
-using ::android::UNEXPECTED_NULL;
-
 static constexpr int8_t MAX_RTP_INPUT = 127;
 static constexpr int8_t MIN_RTP_INPUT = 0;
 
@@ -58,390 +54,435 @@ static constexpr char WAVEFORM_DOUBLE_CLICK_EFFECT_SEQ[] = "3 0";
 // Use effect #4 in the waveform library for HEAVY_CLICK effect
 static constexpr char WAVEFORM_HEAVY_CLICK_EFFECT_SEQ[] = "4 0";
 
-// UT team design those target G values
-static std::array<float, 5> EFFECT_TARGET_G = {0.275, 0.55, 0.6, 0.9, 1.12};
-static std::array<float, 3> STEADY_TARGET_G = {2.15, 1.145, 1.3};
+static constexpr uint8_t WAVEFORM_CLICK_EFFECT_INDEX = 1;
+static constexpr uint8_t WAVEFORM_TICK_EFFECT_INDEX = 2;
+static constexpr uint8_t WAVEFORM_DOUBLE_CLICK_EFFECT_INDEX = 3;
+static constexpr uint8_t WAVEFORM_HEAVY_CLICK_EFFECT_INDEX = 4;
 
-struct SensorContext {
-    ASensorEventQueue *queue;
-};
-static std::vector<float> sXAxleData;
-static std::vector<float> sYAxleData;
-static uint64_t sEndTime = 0;
-static struct timespec sGetTime;
-
-#define MAX_VOLTAGE 3.2
-#define FLOAT_EPS 1e-7
-#define SENSOR_DATA_NUM 20
-// Set sensing period to 2s
-#define SENSING_PERIOD 2000000000
-#define VIBRATION_MOTION_TIME_THRESHOLD 100
-#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+static constexpr uint32_t COMPOSE_DELAY_MAX_MS = 10000;
+static constexpr uint32_t COMPOSE_SIZE_MAX = CompositionEngine::STEPS_MAX;
 
-int GSensorCallback(__attribute__((unused)) int fd, __attribute__((unused)) int events,
-                    void *data) {
-    ASensorEvent event;
-    int event_count = 0;
-    SensorContext *context = reinterpret_cast<SensorContext *>(data);
-    event_count = ASensorEventQueue_getEvents(context->queue, &event, 1);
-    sXAxleData.push_back(event.data[0]);
-    sYAxleData.push_back(event.data[1]);
-    return 1;
-}
-// TODO: b/152305970
-int32_t PollGSensor() {
-    int err = NO_ERROR, counter = 0;
-    ASensorManager *sensorManager = nullptr;
-    ASensorRef GSensor;
-    ALooper *looper;
-    struct SensorContext context = {nullptr};
-
-    // Get proximity sensor events from the NDK
-    sensorManager = ASensorManager_getInstanceForPackage("");
-    if (!sensorManager) {
-        ALOGI("Chase %s: Sensor manager is NULL.\n", __FUNCTION__);
-        err = UNEXPECTED_NULL;
-        return 0;
-    }
-    GSensor = ASensorManager_getDefaultSensor(sensorManager, ASENSOR_TYPE_GRAVITY);
-    if (GSensor == nullptr) {
-        ALOGE("%s:Chase Unable to get g sensor\n", __func__);
-    } else {
-        looper = ALooper_forThread();
-        if (looper == nullptr) {
-            looper = ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
-        }
-        context.queue =
-            ASensorManager_createEventQueue(sensorManager, looper, 0, GSensorCallback, &context);
+// PWLE frequencies span this band around the resonant frequency, which the
+// bandwidth amplitude map samples at the given resolution.
+static constexpr float PWLE_BANDWIDTH_HZ = 100.0f;
+static constexpr float PWLE_FREQUENCY_RESOLUTION_HZ = 5.0f;
+// Nominal LRA quality factor, used when the calibration does not provide one
+static constexpr float DEFAULT_Q_FACTOR = 10.0f;
+// Measured LRA periods further than 1/N from the calibrated period are dropped
+static constexpr uint32_t RESONANCE_DEVIATION_MAX = 4;
+static constexpr char AUTOCAL_MODE[] = "autocal";
 
-        err = ASensorEventQueue_registerSensor(context.queue, GSensor, 0, 0);
-        if (err != NO_ERROR) {
-            ALOGE("Chase %s: Error %d registering G sensor with event queue.\n", __FUNCTION__, err);
-            return 0;
-        }
-        if (err < 0) {
-            ALOGE("%s:Chase Unable to register for G sensor events\n", __func__);
-        } else {
-            for (counter = 0; counter < SENSOR_DATA_NUM; counter++) {
-                ALooper_pollOnce(5, nullptr, nullptr, nullptr);
-            }
-        }
-    }
-    if (sensorManager != nullptr && context.queue != nullptr) {
-        ASensorEventQueue_disableSensor(context.queue, GSensor);
-        ASensorManager_destroyEventQueue(sensorManager, context.queue);
-    }
+// UT team design those target G values
+static constexpr std::array<float, 5> EFFECT_TARGET_G = {0.275, 0.55, 0.6, 0.9, 1.12};
+static constexpr std::array<float, 3> STEADY_TARGET_G = {2.15, 1.145, 1.3};
 
-    return 0;
-}
+#define VIBRATION_MOTION_TIME_THRESHOLD 100
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 
 // Temperature protection upper bound 10°C and lower bound 5°C
 static constexpr int32_t TEMP_UPPER_BOUND = 10000;
 static constexpr int32_t TEMP_LOWER_BOUND = 5000;
+// Thermal zone of the PA thermistor, as named in its uevents
+static constexpr char PA_THERMAL_ZONE[] = "pa-therm1";
 // Steady vibration's voltage in lower bound guarantee
-static uint32_t STEADY_VOLTAGE_LOWER_BOUND = 90;  // 1.8 Vpeak
+static constexpr uint32_t STEADY_VOLTAGE_LOWER_BOUND = 90;  // 1.8 Vpeak
 
-static std::uint32_t freqPeriodFormula(std::uint32_t in) {
-    return 1000000000 / (24615 * in);
-}
+using utils::toUnderlying;
 
-static std::uint32_t convertLevelsToOdClamp(float voltageLevel, uint32_t lraPeriod) {
-    float odClamp;
+using TraceApi = CommandTrace::Api;
+using TraceNode = CommandTrace::Node;
+using TraceRecord = CommandTrace::Record;
 
-    odClamp = voltageLevel /
-              ((21.32 / 1000.0) *
-               sqrt(1.0 - (static_cast<float>(freqPeriodFormula(lraPeriod)) * 8.0 / 10000.0)));
+// Times the hardware writes of the command traced on the calling thread, and
+// passes the others straight through.
+class TracedHwApi : public Vibrator::HwApi {
+  public:
+    explicit TracedHwApi(std::unique_ptr<Vibrator::HwApi> hwapi) : mHwApi(std::move(hwapi)) {}
 
-    return round(odClamp);
-}
+    bool setAutocal(std::string value) override {
+        return write(TraceNode::AUTOCAL, [&] { return mHwApi->setAutocal(value); });
+    }
+    bool setOlLraPeriod(uint32_t value) override {
+        return write(TraceNode::OL_LRA_PERIOD, [&] { return mHwApi->setOlLraPeriod(value); });
+    }
+    bool setActivate(bool value) override {
+        return write(TraceNode::ACTIVATE, [&] { return mHwApi->setActivate(value); });
+    }
+    bool setDuration(uint32_t value) override {
+        return write(TraceNode::DURATION, [&] { return mHwApi->setDuration(value); });
+    }
+    bool setState(bool value) override {
+        return write(TraceNode::STATE, [&] { return mHwApi->setState(value); });
+    }
+    bool hasRtpInput() override { return mHwApi->hasRtpInput(); }
+    bool setRtpInput(int8_t value) override {
+        return write(TraceNode::RTP_INPUT, [&] { return mHwApi->setRtpInput(value); });
+    }
+    bool setMode(std::string value) override {
+        return write(TraceNode::MODE, [&] { return mHwApi->setMode(value); });
+    }
+    bool setSequencer(std::string value) override {
+        return write(TraceNode::SEQUENCER, [&] { return mHwApi->setSequencer(value); });
+    }
+    bool setScale(uint8_t value) override {
+        return write(TraceNode::SCALE, [&] { return mHwApi->setScale(value); });
+    }
+    bool setCtrlLoop(bool value) override {
+        if (auto record = TraceRecord::current()) {
+            record->setLoopMode(value);
+        }
+        return write(TraceNode::CTRL_LOOP, [&] { return mHwApi->setCtrlLoop(value); });
+    }
+    bool setLpTriggerEffect(uint32_t value) override {
+        return write(TraceNode::LP_TRIGGER_EFFECT,
+                     [&] { return mHwApi->setLpTriggerEffect(value); });
+    }
+    bool setLraWaveShape(uint32_t value) override {
+        return write(TraceNode::LRA_WAVE_SHAPE, [&] { return mHwApi->setLraWaveShape(value); });
+    }
+    bool setOdClamp(uint32_t value) override {
+        if (auto record = TraceRecord::current()) {
+            record->setOdClamp(value);
+        }
+        return write(TraceNode::OD_CLAMP, [&] { return mHwApi->setOdClamp(value); });
+    }
+    bool getPATemp(int32_t *value) override { return mHwApi->getPATemp(value); }
+    bool getLraPeriod(uint32_t *value) override { return mHwApi->getLraPeriod(value); }
+    void debug(int fd) override { mHwApi->debug(fd); }
+
+  private:
+    template <typename F>
+    bool write(TraceNode node, F &&func) {
+        auto record = TraceRecord::current();
+        if (!record) {
+            return func();
+        }
+        auto begin = CommandTrace::Clock::now();
+        bool ok = func();
+        record->addWrite(node, CommandTrace::Clock::now() - begin);
+        return ok;
+    }
 
-static float targetGToVlevelsUnderLinearEquation(std::array<float, 4> inputCoeffs, float targetG) {
-    // Implement linear equation to get voltage levels, f(x) = ax + b
-    // 0 to 3.2 is our valid output
-    float outPutVal = 0.0f;
-    outPutVal = (targetG - inputCoeffs[1]) / inputCoeffs[0];
-    if ((outPutVal > FLOAT_EPS) && (outPutVal <= MAX_VOLTAGE)) {
-      return outPutVal;
-    } else {
-      return 0.0f;
+    const std::unique_ptr<Vibrator::HwApi> mHwApi;
+};
+
+Vibrator::Vibrator(std::unique_ptr<HwApi> hwapi, std::unique_ptr<HwCal> hwcal)
+    : mHwApi(std::make_unique<TracedHwApi>(std::move(hwapi))),
+      mHwCal(std::move(hwcal)),
+      mComposition(
+          [this](const CompositionEngine::Step &step) { return playCompositionStep(step); },
+          &mCompletion),
+      mPwle(
+          {
+              .begin = [this](uint32_t durationMs) { return beginPwle(durationMs); },
+              .write = [this](const PwleEngine::Sample &sample) { return writePwle(sample); },
+              .stop = [this]() { stopPwle(); },
+              .end = [this]() { endPwle(); },
+          },
+          &mCompletion),
+      mAlwaysOn([this](uint32_t waveform) { return mHwApi->setLpTriggerEffect(waveform); },
+                [this](const std::string &state) { return mHwCal->setAlwaysOnState(state); }) {
+    std::string alwaysOnState;
+    uint32_t lraPeriod = 0, lpTrigSupport = 0, resonanceInterval = 0;
+
+    if (!mHwApi->setState(true)) {
+        ALOGE("Failed to set state (%d): %s", errno, strerror(errno));
     }
-}
 
-static float targetGToVlevelsUnderCubicEquation(std::array<float, 4> inputCoeffs, float targetG) {
-    // Implement cubic equation to get voltage levels, f(x) = ax^3 + bx^2 + cx + d
-    // 0 to 3.2 is our valid output
-    float AA = 0.0f, BB = 0.0f, CC = 0.0f, Delta = 0.0f;
-    float Y1 = 0.0f, Y2 = 0.0f, K = 0.0f, T = 0.0f, sita = 0.0f;
-    float outPutVal = 0.0f;
-    float oneHalf = 1.0 / 2.0, oneThird = 1.0 / 3.0;
-    float cosSita = 0.0f, sinSitaSqrt3 = 0.0f, sqrtA = 0.0f;
+    restoreAutocal();
+    mHwCal->getLraPeriod(&lraPeriod);
 
-    AA = inputCoeffs[1] * inputCoeffs[1] - 3.0 * inputCoeffs[0] * inputCoeffs[2];
-    BB = inputCoeffs[1] * inputCoeffs[2] - 9.0 * inputCoeffs[0] * (inputCoeffs[3] - targetG);
-    CC = inputCoeffs[2] * inputCoeffs[2] - 3.0 * inputCoeffs[1] * (inputCoeffs[3] - targetG);
+    mHwCal->getDynamicConfig(&mDynamicConfig);
 
-    Delta = BB * BB - 4.0 * AA * CC;
+    if (mDynamicConfig) {
+        uint32_t temperatureMaxAge = 0;
+        std::string devHwVersion;
 
-    // There are four discriminants in Shengjin formula.
-    // https://zh.wikipedia.org/wiki/%E4%B8%89%E6%AC%A1%E6%96%B9%E7%A8%8B#%E7%9B%9B%E9%87%91%E5%85%AC%E5%BC%8F%E6%B3%95
-    if ((fabs(AA) <= FLOAT_EPS) && (fabs(BB) <= FLOAT_EPS)) {
-        // Case 1: A = B = 0
-        outPutVal = -inputCoeffs[1] / (3 * inputCoeffs[0]);
-        if ((outPutVal > FLOAT_EPS) && (outPutVal <= MAX_VOLTAGE)) {
-          return outPutVal;
-        }
-        return 0.0f;
-    } else if (Delta > FLOAT_EPS) {
-        // Case 2: Delta > 0
-        Y1 = AA * inputCoeffs[1] + 3.0 * inputCoeffs[0] * (-BB + pow(Delta, oneHalf)) / 2.0;
-        Y2 = AA * inputCoeffs[1] + 3.0 * inputCoeffs[0] * (-BB - pow(Delta, oneHalf)) / 2.0;
-
-        if ((Y1 < -FLOAT_EPS) && (Y2 > FLOAT_EPS)) {
-            return (-inputCoeffs[1] + pow(-Y1, oneThird) - pow(Y2, oneThird)) /
-                   (3.0 * inputCoeffs[0]);
-        } else if ((Y1 > FLOAT_EPS) && (Y2 < -FLOAT_EPS)) {
-            return (-inputCoeffs[1] - pow(Y1, oneThird) + pow(-Y2, oneThird)) /
-                   (3.0 * inputCoeffs[0]);
-        } else if ((Y1 < -FLOAT_EPS) && (Y2 < -FLOAT_EPS)) {
-            return (-inputCoeffs[1] + pow(-Y1, oneThird) + pow(-Y2, oneThird)) /
-                   (3.0 * inputCoeffs[0]);
+        // The version cannot change at runtime, so it is checked once rather
+        // than on every config rebuild.
+        mHwCal->getDevHwVer(&devHwVersion);
+        if ((devHwVersion.find("EVT") != std::string::npos) ||
+            (devHwVersion.find("PROTO") != std::string::npos)) {
+            mEvtDevice = true;
+            ALOGW("Device HW version: %s, this is an EVT device", devHwVersion.c_str());
         } else {
-            return (-inputCoeffs[1] - pow(Y1, oneThird) - pow(Y2, oneThird)) /
-                   (3.0 * inputCoeffs[0]);
-        }
-        return 0.0f;
-    } else if (Delta < -FLOAT_EPS) {
-        // Case 3: Delta < 0
-        T = (2 * AA * inputCoeffs[1] - 3 * inputCoeffs[0] * BB) / (2 * AA * sqrt(AA));
-        sita = acos(T);
-        cosSita = cos(sita / 3);
-        sinSitaSqrt3 = sqrt(3.0) * sin(sita / 3);
-        sqrtA = sqrt(AA);
-
-        outPutVal = (-inputCoeffs[1] - 2 * sqrtA * cosSita) / (3 * inputCoeffs[0]);
-        if ((outPutVal > FLOAT_EPS) && (outPutVal <= MAX_VOLTAGE)) {
-          return outPutVal;
+            ALOGW("Device HW version: %s, no need to change the target G values",
+                  devHwVersion.c_str());
         }
-        outPutVal = (-inputCoeffs[1] + sqrtA * (cosSita + sinSitaSqrt3)) / (3 * inputCoeffs[0]);
-        if ((outPutVal > FLOAT_EPS) && (outPutVal <= MAX_VOLTAGE)) {
-          return outPutVal;
-        }
-        outPutVal = (-inputCoeffs[1] + sqrtA * (cosSita - sinSitaSqrt3)) / (3 * inputCoeffs[0]);
-        if ((outPutVal > FLOAT_EPS) && (outPutVal <= MAX_VOLTAGE)) {
-          return outPutVal;
-        }
-        return 0.0f;
-    } else if (Delta <= FLOAT_EPS) {
-        // Case 4: Delta = 0
-        K = BB / AA;
-        outPutVal = (-inputCoeffs[1] / inputCoeffs[0] + K);
-        if ((outPutVal > FLOAT_EPS) && (outPutVal <= MAX_VOLTAGE)) {
-          return outPutVal;
-        }
-        outPutVal = (-K / 2);
-        if ((outPutVal > FLOAT_EPS) && (outPutVal <= MAX_VOLTAGE)) {
-          return outPutVal;
+
+        mMotionAwareness = std::make_unique<MotionAwareness>();
+        if (!mHwCal->getTemperatureMaxAge(&temperatureMaxAge)) {
+            temperatureMaxAge = 0;
         }
-        return 0.0f;
-    } else {
-        // Exception handling
-        return 0.0f;
+        mTemperature = std::make_unique<TemperatureCache>(
+                [this](int32_t *value) { return mHwApi->getPATemp(value); },
+                std::chrono::milliseconds(temperatureMaxAge), PA_THERMAL_ZONE);
     }
-}
 
-static float vLevelsToTargetGUnderCubicEquation(
-    std::array<float, 4> inputCoeffs, float vLevel) {
-  float inputVoltage = 0.0f;
-  inputVoltage = vLevel * MAX_VOLTAGE;
-  return inputCoeffs[0] * pow(inputVoltage, 3) +
-         inputCoeffs[1] * pow(inputVoltage, 2) + inputCoeffs[2] * inputVoltage +
-         inputCoeffs[3];
-}
-
-static bool motionAwareness() {
-    float avgX = 0.0, avgY = 0.0;
-    uint64_t current_time = 0;
-    clock_gettime(CLOCK_MONOTONIC, &sGetTime);
-    current_time = ((uint64_t)sGetTime.tv_sec * 1000 * 1000 * 1000) + sGetTime.tv_nsec;
-
-    if ((current_time - sEndTime) > SENSING_PERIOD) {
-        sXAxleData.clear();
-        sYAxleData.clear();
-        PollGSensor();
-        clock_gettime(CLOCK_MONOTONIC, &sGetTime);
-        sEndTime = ((uint64_t)sGetTime.tv_sec * 1000 * 1000 * 1000) + sGetTime.tv_nsec;
+    if (!mHwCal->getResonanceInterval(&resonanceInterval)) {
+        resonanceInterval = 0;
+    }
+    mResonance = std::make_unique<ResonanceTracker>(
+            ResonanceTracker::Output{
+                    .begin = [this]() { return beginResonanceMeasurement(); },
+                    .finish =
+                            [this](uint32_t *lraPeriod) {
+                                return finishResonanceMeasurement(lraPeriod);
+                            },
+                    .abort = [this]() { abortResonanceMeasurement(); },
+            },
+            std::chrono::milliseconds(resonanceInterval));
+
+    {
+        StartupProfile::Scope scope(&StartupProfile::get(), StartupProfile::Phase::BUILD_CONFIG);
+        configure(lraPeriod);
     }
 
-    avgX = std::accumulate(sXAxleData.begin(), sXAxleData.end(), 0.0) / sXAxleData.size();
-    avgY = std::accumulate(sYAxleData.begin(), sYAxleData.end(), 0.0) / sYAxleData.size();
-
-    if ((avgX > -1.3) && (avgX < 1.3) && (avgY > -0.8) && (avgY < 0.8)) {
-        return false;
-    } else {
-        return true;
+    // This enables effect #1 from the waveform library to be triggered by SLPI
+    // while the AP is in suspend mode
+    // For default setting, we will enable this feature if that project did not
+    // set the lptrigger config
+    // Once the framework has configured always-on effects, the stored table
+    // takes precedence so that a HAL restart does not reset the trigger.
+    mHwCal->getTriggerEffectSupport(&lpTrigSupport);
+    mHwCal->getAlwaysOnState(&alwaysOnState);
+    if (!mAlwaysOn.restore(alwaysOnState, lpTrigSupport)) {
+        ALOGW("Failed to set LP trigger mode (%d): %s", errno, strerror(errno));
     }
+
+    mHwCal->watch([this]() { reload(); });
 }
 
-using utils::toUnderlying;
+Vibrator::~Vibrator() {
+    // Stop reloads before any of the members they use goes away.
+    mHwCal->watch(nullptr);
+}
 
-Vibrator::Vibrator(std::unique_ptr<HwApi> hwapi, std::unique_ptr<HwCal> hwcal)
-    : mHwApi(std::move(hwapi)), mHwCal(std::move(hwcal)) {
-    std::string autocal;
-    uint32_t lraPeriod = 0, lpTrigSupport = 0;
+std::shared_ptr<Vibrator::Config> Vibrator::buildConfig(uint32_t lraPeriod) const {
+    auto config = std::make_shared<Config>();
     std::array<float, 4> effectCoeffs = {0.0f};
     std::array<float, 4> steadyCoeffs = {0.0f};
 
-    if (!mHwApi->setState(true)) {
-        ALOGE("Failed to set state (%d): %s", errno, strerror(errno));
-    }
-
-    if (mHwCal->getAutocal(&autocal)) {
-        mHwApi->setAutocal(autocal);
-    }
-    mHwCal->getLraPeriod(&lraPeriod);
-
-    mHwCal->getCloseLoopThreshold(&mCloseLoopThreshold);
-    mHwCal->getDynamicConfig(&mDynamicConfig);
+    mHwCal->getCloseLoopThreshold(&config->closeLoopThreshold);
+    mHwCal->getClickDuration(&config->clickDuration);
+    mHwCal->getTickDuration(&config->tickDuration);
+    mHwCal->getDoubleClickDuration(&config->doubleClickDuration);
+    mHwCal->getHeavyClickDuration(&config->heavyClickDuration);
 
     if (mDynamicConfig) {
-        uint8_t i = 0;
         bool hasEffectCoeffs = false, hasSteadyCoeffs = false,
              hasExternalEffectG = false, hasExternalSteadyG = false;
         std::array<float, 5> externalEffectTargetG = {0.0f};
         std::array<float, 3> externalSteadyTargetG = {0.0f};
-        float tempVolLevel = 0.0f, tempAmpMax = 0.0f;
+        float tempAmpMax = 0.0f;
         uint32_t longFreqencyShift = 0, shortVoltageMax = 0, longVoltageMax = 0,
                  shape = 0;
-        std::string devHwVersion;
 
         mHwCal->getLongFrequencyShift(&longFreqencyShift);
         mHwCal->getShortVoltageMax(&shortVoltageMax);
         mHwCal->getLongVoltageMax(&longVoltageMax);
 
+        config->effectTargetG = EFFECT_TARGET_G;
+        config->steadyTargetG = STEADY_TARGET_G;
+
         // TODO: This is a workaround for b/157610908
-        mHwCal->getDevHwVer(&devHwVersion);
-        if ((devHwVersion.find("EVT") != std::string::npos) ||
-            (devHwVersion.find("PROTO") != std::string::npos)) {
-          EFFECT_TARGET_G = {0.15, 0.27, 0.35, 0.54, 0.65};
-          STEADY_TARGET_G = {1.2, 1.145, 0.4};
-          ALOGW("Device HW version: %s, this is an EVT device",
-                devHwVersion.c_str());
-        } else {
-          ALOGW("Device HW version: %s, no need to change the target G values",
-                devHwVersion.c_str());
+        if (mEvtDevice) {
+          config->effectTargetG = {0.15, 0.27, 0.35, 0.54, 0.65};
+          config->steadyTargetG = {1.2, 1.145, 0.4};
         }
 
         hasEffectCoeffs = mHwCal->getEffectCoeffs(&effectCoeffs);
         hasExternalEffectG = mHwCal->getEffectTargetG(&externalEffectTargetG);
-        for (i = 0; i < 5; i++) {
-            if (hasEffectCoeffs) {
-              if (hasExternalEffectG) {
-                EFFECT_TARGET_G[i] = externalEffectTargetG[i];
-              }
-              // Use linear approach to get the target voltage levels
-              if ((effectCoeffs[2] == 0) && (effectCoeffs[3] == 0)) {
-                tempVolLevel = targetGToVlevelsUnderLinearEquation(
-                    effectCoeffs, EFFECT_TARGET_G[i]);
-                mEffectTargetOdClamp[i] =
-                    convertLevelsToOdClamp(tempVolLevel, lraPeriod);
-              } else {
-                // Use cubic approach to get the target voltage levels
-                tempVolLevel = targetGToVlevelsUnderCubicEquation(
-                    effectCoeffs, EFFECT_TARGET_G[i]);
-                mEffectTargetOdClamp[i] =
-                    convertLevelsToOdClamp(tempVolLevel, lraPeriod);
-              }
+        if (hasEffectCoeffs) {
+            std::array<float, 5> effectVolLevels;
+            if (hasExternalEffectG) {
+                config->effectTargetG = externalEffectTargetG;
+            }
+            // Use linear approach to get the target voltage levels
+            if ((effectCoeffs[2] == 0) && (effectCoeffs[3] == 0)) {
+                calibration::targetGToVLevelsLinear(effectCoeffs, config->effectTargetG.data(),
+                                                    effectVolLevels.data(),
+                                                    effectVolLevels.size());
             } else {
-                mEffectTargetOdClamp[i] = shortVoltageMax;
+                // Use cubic approach to get the target voltage levels
+                calibration::targetGToVLevelsCubic(effectCoeffs, config->effectTargetG.data(),
+                                                   effectVolLevels.data(),
+                                                   effectVolLevels.size());
             }
+            calibration::convertLevelsToOdClamp(effectVolLevels.data(), lraPeriod,
+                                                config->effectTargetOdClamp.data(),
+                                                effectVolLevels.size());
+        } else {
+            config->effectTargetOdClamp.fill(shortVoltageMax);
         }
         // Add a boundary protection for level 5 only, since
         // some devices might not be able to reach the maximum target G
-        if ((mEffectTargetOdClamp[4] <= 0) || (mEffectTargetOdClamp[4] > shortVoltageMax)) {
-            mEffectTargetOdClamp[4] = shortVoltageMax;
+        if ((config->effectTargetOdClamp[4] <= 0) ||
+            (config->effectTargetOdClamp[4] > shortVoltageMax)) {
+            config->effectTargetOdClamp[4] = shortVoltageMax;
         }
 
+        config->hasEffectCoeffs = hasEffectCoeffs;
+        config->effectCoeffs = effectCoeffs;
+        config->effectOdClampMax = shortVoltageMax;
+
         mHwCal->getEffectShape(&shape);
-        mEffectConfig.reset(new VibrationConfig({
+        config->effectConfig.reset(new VibrationConfig({
             .shape = (shape == UINT32_MAX) ? WaveShape::SINE : static_cast<WaveShape>(shape),
-            .odClamp = &mEffectTargetOdClamp[0],
+            .odClamp = &config->effectTargetOdClamp[0],
             .olLraPeriod = lraPeriod,
         }));
 
         hasSteadyCoeffs = mHwCal->getSteadyCoeffs(&steadyCoeffs);
         hasExternalSteadyG = mHwCal->getSteadyTargetG(&externalSteadyTargetG);
         if (hasSteadyCoeffs) {
-            for (i = 0; i < 3; i++) {
-              if (hasExternalSteadyG) {
-                STEADY_TARGET_G[i] = externalSteadyTargetG[i];
-              }
-              // Use cubic approach to get the steady target voltage levels
-              // For steady level 3 voltage which is used for non-motion
-              // voltage, we use interpolation method to calculate the voltage
-              // via 20% of MAX voltage, 60% of MAX voltage and steady level 3
-              // target G
-              if (i == 2) {
-                tempVolLevel =
-                    ((STEADY_TARGET_G[2] -
-                      vLevelsToTargetGUnderCubicEquation(steadyCoeffs, 0.2)) *
-                     0.4 * MAX_VOLTAGE) /
-                        (vLevelsToTargetGUnderCubicEquation(steadyCoeffs, 0.6) -
-                         vLevelsToTargetGUnderCubicEquation(steadyCoeffs,
-                                                            0.2)) +
-                    0.2 * MAX_VOLTAGE;
-              } else {
-                tempVolLevel = targetGToVlevelsUnderCubicEquation(
-                    steadyCoeffs, STEADY_TARGET_G[i]);
-              }
-              mSteadyTargetOdClamp[i] =
-                  convertLevelsToOdClamp(tempVolLevel, lraPeriod);
-              if ((mSteadyTargetOdClamp[i] <= 0) ||
-                  (mSteadyTargetOdClamp[i] > longVoltageMax)) {
-                mSteadyTargetOdClamp[i] = longVoltageMax;
-              }
+            std::array<float, 3> steadyVolLevels;
+            if (hasExternalSteadyG) {
+                config->steadyTargetG = externalSteadyTargetG;
+            }
+            // Use cubic approach to get the steady target voltage levels
+            calibration::targetGToVLevelsCubic(steadyCoeffs, config->steadyTargetG.data(),
+                                               steadyVolLevels.data(), 2);
+            // For steady level 3 voltage which is used for non-motion
+            // voltage, we use interpolation method to calculate the voltage
+            // via 20% of MAX voltage, 60% of MAX voltage and steady level 3
+            // target G
+            const float g20 = calibration::vLevelsToTargetGCubic(steadyCoeffs, 0.2);
+            const float g60 = calibration::vLevelsToTargetGCubic(steadyCoeffs, 0.6);
+            steadyVolLevels[2] = ((config->steadyTargetG[2] - g20) * 0.4 *
+                                  calibration::MAX_VOLTAGE) / (g60 - g20) +
+                                 0.2 * calibration::MAX_VOLTAGE;
+            calibration::convertLevelsToOdClamp(steadyVolLevels.data(), lraPeriod,
+                                                config->steadyTargetOdClamp.data(),
+                                                steadyVolLevels.size());
+            for (auto &odClamp : config->steadyTargetOdClamp) {
+                if ((odClamp <= 0) || (odClamp > longVoltageMax)) {
+                    odClamp = longVoltageMax;
+                }
             }
         } else {
           if (hasExternalSteadyG) {
-            STEADY_TARGET_G[0] = externalSteadyTargetG[0];
-            STEADY_TARGET_G[2] = externalSteadyTargetG[2];
+            config->steadyTargetG[0] = externalSteadyTargetG[0];
+            config->steadyTargetG[2] = externalSteadyTargetG[2];
           }
-          mSteadyTargetOdClamp[0] =
+          config->steadyTargetOdClamp[0] =
               mHwCal->getSteadyAmpMax(&tempAmpMax)
-                  ? round((STEADY_TARGET_G[0] / tempAmpMax) * longVoltageMax)
+                  ? round((config->steadyTargetG[0] / tempAmpMax) * longVoltageMax)
                   : longVoltageMax;
-            mSteadyTargetOdClamp[2] =
+            config->steadyTargetOdClamp[2] =
                 mHwCal->getSteadyAmpMax(&tempAmpMax)
-                    ? round((STEADY_TARGET_G[2] / tempAmpMax) * longVoltageMax)
+                    ? round((config->steadyTargetG[2] / tempAmpMax) * longVoltageMax)
                     : longVoltageMax;
         }
         mHwCal->getSteadyShape(&shape);
-        mSteadyConfig.reset(new VibrationConfig({
+        config->steadyConfig.reset(new VibrationConfig({
             .shape = (shape == UINT32_MAX) ? WaveShape::SQUARE : static_cast<WaveShape>(shape),
-            .odClamp = &mSteadyTargetOdClamp[0],
+            .odClamp = &config->steadyTargetOdClamp[0],
             .olLraPeriod = lraPeriod,
         }));
-        mSteadyOlLraPeriod = lraPeriod;
-        // 1. Change long lra period to frequency
-        // 2. Get frequency': subtract the frequency shift from the frequency
-        // 3. Get final long lra period after put the frequency' to formula
-        mSteadyOlLraPeriodShift =
-            freqPeriodFormula(freqPeriodFormula(lraPeriod) - longFreqencyShift);
-    } else {
-        mHwApi->setOlLraPeriod(lraPeriod);
+        // Below the lower bound, limit the voltage and drive at the long LRA
+        // period, which is the frequency shifted by the long frequency shift.
+        // Above the upper bound, use the steady calibration.
+        config->steadyTable = OdClampTable(
+                {
+                        .temperature = TEMP_LOWER_BOUND,
+                        .odClamp = STEADY_VOLTAGE_LOWER_BOUND,
+                        .flatOdClamp = STEADY_VOLTAGE_LOWER_BOUND,
+                        .olLraPeriod = calibration::freqPeriodFormula(
+                                calibration::freqPeriodFormula(lraPeriod) - longFreqencyShift),
+                },
+                {
+                        .temperature = TEMP_UPPER_BOUND,
+                        .odClamp = config->steadyTargetOdClamp[0],
+                        .flatOdClamp = config->steadyTargetOdClamp[2],
+                        .olLraPeriod = lraPeriod,
+                });
     }
 
-    mHwCal->getClickDuration(&mClickDuration);
-    mHwCal->getTickDuration(&mTickDuration);
-    mHwCal->getDoubleClickDuration(&mDoubleClickDuration);
-    mHwCal->getHeavyClickDuration(&mHeavyClickDuration);
+    if (!mHwCal->getQFactor(&config->qFactor)) {
+        config->qFactor = DEFAULT_Q_FACTOR;
+    }
+    config->lraPeriod = lraPeriod;
+    buildEffectPlans(config.get());
 
-    // This enables effect #1 from the waveform library to be triggered by SLPI
-    // while the AP is in suspend mode
-    // For default setting, we will enable this feature if that project did not
-    // set the lptrigger config
-    mHwCal->getTriggerEffectSupport(&lpTrigSupport);
-    if (!mHwApi->setLpTriggerEffect(lpTrigSupport)) {
-        ALOGW("Failed to set LP trigger mode (%d): %s", errno, strerror(errno));
+    return config;
+}
+
+void Vibrator::publishConfig(std::shared_ptr<Config> config) {
+    if (!mDynamicConfig) {
+        mHwApi->setOlLraPeriod(config->lraPeriod);
+    }
+    std::atomic_store(&mConfig, std::shared_ptr<const Config>(std::move(config)));
+}
+
+void Vibrator::reload() {
+    ATRACE_NAME("Vibrator::reload");
+    uint32_t lraPeriod = 0;
+
+    // The measured LRA period is dropped along with the old calibration.
+    mHwCal->getLraPeriod(&lraPeriod);
+    auto config = buildConfig(lraPeriod);
+
+    std::lock_guard<std::mutex> lock(mHwMutex);
+    preempt();
+    restoreAutocal();
+    publishConfig(std::move(config));
+    ALOGI("Reloaded calibration, LRA period %" PRIu32, lraPeriod);
+}
+
+void Vibrator::preempt() {
+    uint32_t lraPeriod, calibrated;
+
+    mComposition.cancel();
+    mPwle.cancel();
+    mResonance->interrupt();
+
+    // Apply a new resonance measurement now that nothing else is playing.
+    if (mResonance->takeLraPeriod(&lraPeriod) && mHwCal->getLraPeriod(&calibrated)) {
+        if (lraPeriod > calibrated + calibrated / RESONANCE_DEVIATION_MAX ||
+            lraPeriod < calibrated - calibrated / RESONANCE_DEVIATION_MAX) {
+            ALOGW("Ignoring measured LRA period %" PRIu32 " (calibrated %" PRIu32 ")", lraPeriod,
+                  calibrated);
+            // The run replaced the calibration the period is checked against.
+            restoreAutocal();
+        } else if (lraPeriod != loadConfig()->lraPeriod) {
+            configure(lraPeriod);
+        }
+    }
+}
+
+bool Vibrator::beginResonanceMeasurement() {
+    if (!mHwApi->setMode(AUTOCAL_MODE)) {
+        ALOGE("Failed to set autocal mode (%d): %s", errno, strerror(errno));
+        return false;
+    }
+    if (!mHwApi->setActivate(1)) {
+        ALOGE("Failed to start autocal (%d): %s", errno, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool Vibrator::finishResonanceMeasurement(uint32_t *lraPeriod) {
+    // Leave autocal mode so that the always-on trigger plays from the
+    // waveform library again.
+    mHwApi->setMode(WAVEFORM_MODE);
+    return mHwApi->getLraPeriod(lraPeriod);
+}
+
+void Vibrator::abortResonanceMeasurement() {
+    if (!mHwApi->setActivate(0)) {
+        ALOGE("Failed to stop autocal (%d): %s", errno, strerror(errno));
+    }
+    mHwApi->setMode(WAVEFORM_MODE);
+    restoreAutocal();
+}
+
+void Vibrator::restoreAutocal() {
+    std::string autocal;
+
+    if (mHwCal->getAutocal(&autocal)) {
+        mHwApi->setAutocal(autocal);
     }
 }
 
@@ -449,24 +490,18 @@ ndk::ScopedAStatus Vibrator::getCapabilities(int32_t *_aidl_return) {
     ATRACE_NAME("Vibrator::getCapabilities");
     int32_t ret = 0;
     if (mHwApi->hasRtpInput()) {
-        ret |= IVibrator::CAP_AMPLITUDE_CONTROL;
+        ret |= IVibrator::CAP_AMPLITUDE_CONTROL | IVibrator::CAP_FREQUENCY_CONTROL |
+               IVibrator::CAP_COMPOSE_PWLE_EFFECTS;
     }
-    ret |= IVibrator::CAP_GET_RESONANT_FREQUENCY;
+    ret |= IVibrator::CAP_ON_CALLBACK | IVibrator::CAP_PERFORM_CALLBACK |
+           IVibrator::CAP_COMPOSE_EFFECTS | IVibrator::CAP_GET_RESONANT_FREQUENCY |
+           IVibrator::CAP_GET_Q_FACTOR | IVibrator::CAP_ALWAYS_ON_CONTROL;
     *_aidl_return = ret;
     return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::on(uint32_t timeoutMs, const char mode[],
-                                const std::unique_ptr<VibrationConfig> &config,
-                                const int8_t volOffset) {
-    LoopControl loopMode = LoopControl::OPEN;
-
-    // Open-loop mode is used for short click for over-drive
-    // Close-loop mode is used for long notification for stability
-    if (mode == RTP_MODE && timeoutMs > mCloseLoopThreshold) {
-        loopMode = LoopControl::CLOSE;
-    }
-
+ndk::ScopedAStatus Vibrator::on(uint32_t timeoutMs, const char mode[], LoopControl loopMode,
+                                const VibrationConfig *config, const int8_t volOffset) {
     mHwApi->setCtrlLoop(toUnderlying(loopMode));
     if (!mHwApi->setDuration(timeoutMs)) {
         ALOGE("Failed to set duration (%d): %s", errno, strerror(errno));
@@ -491,36 +526,55 @@ ndk::ScopedAStatus Vibrator::on(uint32_t timeoutMs, const char mode[],
 ndk::ScopedAStatus Vibrator::on(int32_t timeoutMs,
                                 const std::shared_ptr<IVibratorCallback> &callback) {
     ATRACE_NAME("Vibrator::on");
-
-    if (callback) {
-        return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
-    }
-
-    if (mDynamicConfig) {
-        int temperature = 0;
-        mHwApi->getPATemp(&temperature);
-        if (temperature > TEMP_UPPER_BOUND) {
-            mSteadyConfig->odClamp = &mSteadyTargetOdClamp[0];
-            mSteadyConfig->olLraPeriod = mSteadyOlLraPeriod;
-            // TODO: b/162346934 This a compromise way to bypass the motion
-            // awareness delay
-            if ((timeoutMs > VIBRATION_MOTION_TIME_THRESHOLD) && (!motionAwareness())) {
-                return on(timeoutMs, RTP_MODE, mSteadyConfig, 2);
-            }
-        } else if (temperature < TEMP_LOWER_BOUND) {
-            mSteadyConfig->odClamp = &STEADY_VOLTAGE_LOWER_BOUND;
-            mSteadyConfig->olLraPeriod = mSteadyOlLraPeriodShift;
+    TraceRecord record(&mTrace, TraceApi::ON, timeoutMs);
+    std::lock_guard<std::mutex> lock(mHwMutex);
+    ndk::ScopedAStatus status;
+    VibrationConfig steadyConfig;
+    const VibrationConfig *vibrationConfig = nullptr;
+
+    preempt();
+
+    auto config = loadConfig();
+    if (config->steadyConfig) {
+        int32_t temperature = 0;
+        mTemperature->get(&temperature);
+        record.setTemperature(temperature);
+        const OdClampTable::Entry &entry = config->steadyTable.lookup(temperature);
+        steadyConfig = *config->steadyConfig;
+        steadyConfig.odClamp = &entry.odClamp;
+        steadyConfig.olLraPeriod = entry.olLraPeriod;
+        // Lower the strength of long vibrations while lying flat
+        if ((entry.flatOdClamp != entry.odClamp) &&
+            (timeoutMs > VIBRATION_MOTION_TIME_THRESHOLD) && !mMotionAwareness->isMoving()) {
+            steadyConfig.odClamp = &entry.flatOdClamp;
         }
+        vibrationConfig = &steadyConfig;
     }
 
-    return on(timeoutMs, RTP_MODE, mSteadyConfig, 0);
+    // Open-loop mode is used for short click for over-drive
+    // Close-loop mode is used for long notification for stability
+    LoopControl loopMode = static_cast<uint32_t>(timeoutMs) > config->closeLoopThreshold
+                                   ? LoopControl::CLOSE
+                                   : LoopControl::OPEN;
+
+    status = on(timeoutMs, RTP_MODE, loopMode, vibrationConfig, 0);
+    if (status.isOk()) {
+        mCompletion.start(timeoutMs, callback);
+        mResonance->hold(std::chrono::milliseconds(timeoutMs));
+    }
+    return record.finish(std::move(status));
 }
 
 ndk::ScopedAStatus Vibrator::off() {
     ATRACE_NAME("Vibrator::off");
+    TraceRecord record(&mTrace, TraceApi::OFF);
+    std::lock_guard<std::mutex> lock(mHwMutex);
+    preempt();
+    mCompletion.stop();
+    mResonance->hold(std::chrono::milliseconds::zero());
     if (!mHwApi->setActivate(0)) {
         ALOGE("Failed to turn vibrator off (%d): %s", errno, strerror(errno));
-        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+        return record.finish(ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE));
     }
     return ndk::ScopedAStatus::ok();
 }
@@ -533,9 +587,13 @@ ndk::ScopedAStatus Vibrator::setAmplitude(float amplitude) {
 
     int32_t rtp_input = std::round(amplitude * (MAX_RTP_INPUT - MIN_RTP_INPUT) + MIN_RTP_INPUT);
 
+    TraceRecord record(&mTrace, TraceApi::SET_AMPLITUDE, rtp_input);
+    std::lock_guard<std::mutex> lock(mHwMutex);
+    // Amplitude only applies to on(); keep engines from fighting over the RTP input.
+    preempt();
     if (!mHwApi->setRtpInput(rtp_input)) {
         ALOGE("Failed to set amplitude (%d): %s", errno, strerror(errno));
-        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+        return record.finish(ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE));
     }
 
     return ndk::ScopedAStatus::ok();
@@ -558,30 +616,52 @@ binder_status_t Vibrator::dump(int fd, const char **args, uint32_t numArgs) {
 
     dprintf(fd, "AIDL:\n");
 
-    dprintf(fd, "  Close Loop Thresh: %" PRIu32 "\n", mCloseLoopThreshold);
-    if (mSteadyConfig) {
-        dprintf(fd, "  Steady Shape: %" PRIu32 "\n", mSteadyConfig->shape);
+    auto config = loadConfig();
+    const auto &steadyTargetG = config->steadyTargetG;
+    const auto &effectTargetG = config->effectTargetG;
+
+    dprintf(fd, "  Close Loop Thresh: %" PRIu32 "\n", config->closeLoopThreshold);
+    dprintf(fd, "  LRA Period: %" PRIu32 "\n", config->lraPeriod);
+    dprintf(fd, "  Q Factor: %f\n", config->qFactor);
+    if (const auto &steadyConfig = config->steadyConfig) {
+        dprintf(fd, "  Steady Shape: %" PRIu32 "\n", steadyConfig->shape);
         dprintf(fd, "  Steady OD Clamp: %" PRIu32 " %" PRIu32 " %" PRIu32 "\n",
-                mSteadyConfig->odClamp[0], mSteadyConfig->odClamp[1], mSteadyConfig->odClamp[2]);
-        dprintf(fd, "  Steady target G: %f %f %f\n", STEADY_TARGET_G[0],
-                STEADY_TARGET_G[1], STEADY_TARGET_G[2]);
-        dprintf(fd, "  Steady OL LRA Period: %" PRIu32 "\n", mSteadyConfig->olLraPeriod);
+                steadyConfig->odClamp[0], steadyConfig->odClamp[1], steadyConfig->odClamp[2]);
+        dprintf(fd, "  Steady target G: %f %f %f\n", steadyTargetG[0], steadyTargetG[1],
+                steadyTargetG[2]);
+        dprintf(fd, "  Steady OL LRA Period: %" PRIu32 "\n", steadyConfig->olLraPeriod);
+        config->steadyTable.debug(fd);
     }
-    if (mEffectConfig) {
-        dprintf(fd, "  Effect Shape: %" PRIu32 "\n", mEffectConfig->shape);
+    if (const auto &effectConfig = config->effectConfig) {
+        dprintf(fd, "  Effect Shape: %" PRIu32 "\n", effectConfig->shape);
         dprintf(fd,
                 "  Effect OD Clamp: %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 "\n",
-                mEffectConfig->odClamp[0], mEffectConfig->odClamp[1], mEffectConfig->odClamp[2],
-                mEffectConfig->odClamp[3], mEffectConfig->odClamp[4]);
-        dprintf(fd, "  Effect target G: %f %f %f %f %f\n", EFFECT_TARGET_G[0],
-                EFFECT_TARGET_G[1], EFFECT_TARGET_G[2], EFFECT_TARGET_G[3],
-                EFFECT_TARGET_G[4]);
-        dprintf(fd, "  Effect OL LRA Period: %" PRIu32 "\n", mEffectConfig->olLraPeriod);
-    }
-    dprintf(fd, "  Click Duration: %" PRIu32 "\n", mClickDuration);
-    dprintf(fd, "  Tick Duration: %" PRIu32 "\n", mTickDuration);
-    dprintf(fd, "  Double Click Duration: %" PRIu32 "\n", mDoubleClickDuration);
-    dprintf(fd, "  Heavy Click Duration: %" PRIu32 "\n", mHeavyClickDuration);
+                effectConfig->odClamp[0], effectConfig->odClamp[1], effectConfig->odClamp[2],
+                effectConfig->odClamp[3], effectConfig->odClamp[4]);
+        dprintf(fd, "  Effect target G: %f %f %f %f %f\n", effectTargetG[0], effectTargetG[1],
+                effectTargetG[2], effectTargetG[3], effectTargetG[4]);
+        dprintf(fd, "  Effect OL LRA Period: %" PRIu32 "\n", effectConfig->olLraPeriod);
+    }
+    dprintf(fd, "  Click Duration: %" PRIu32 "\n", config->clickDuration);
+    dprintf(fd, "  Tick Duration: %" PRIu32 "\n", config->tickDuration);
+    dprintf(fd, "  Double Click Duration: %" PRIu32 "\n", config->doubleClickDuration);
+    dprintf(fd, "  Heavy Click Duration: %" PRIu32 "\n", config->heavyClickDuration);
+
+    dprintf(fd, "\n");
+
+    StartupProfile::get().debug(fd);
+    mTrace.debug(fd);
+    mCompletion.debug(fd);
+    mComposition.debug(fd);
+    mPwle.debug(fd);
+    mResonance->debug(fd);
+    mAlwaysOn.debug(fd);
+    if (mMotionAwareness) {
+        mMotionAwareness->debug(fd);
+    }
+    if (mTemperature) {
+        mTemperature->debug(fd);
+    }
 
     dprintf(fd, "\n");
 
@@ -596,8 +676,17 @@ binder_status_t Vibrator::dump(int fd, const char **args, uint32_t numArgs) {
 }
 
 ndk::ScopedAStatus Vibrator::getSupportedEffects(std::vector<Effect> *_aidl_return) {
-    *_aidl_return = {Effect::TEXTURE_TICK, Effect::TICK, Effect::CLICK, Effect::HEAVY_CLICK,
-                     Effect::DOUBLE_CLICK};
+    auto config = loadConfig();
+
+    _aidl_return->clear();
+    for (const auto &effect : ndk::enum_range<Effect>()) {
+        for (const auto &strength : ndk::enum_range<EffectStrength>()) {
+            if (getEffectPlan(*config, effect, strength)) {
+                _aidl_return->push_back(effect);
+                break;
+            }
+        }
+    }
     return ndk::ScopedAStatus::ok();
 }
 
@@ -605,109 +694,379 @@ ndk::ScopedAStatus Vibrator::perform(Effect effect, EffectStrength strength,
                                      const std::shared_ptr<IVibratorCallback> &callback,
                                      int32_t *_aidl_return) {
     ATRACE_NAME("Vibrator::perform");
+    TraceRecord record(&mTrace, TraceApi::PERFORM, static_cast<int32_t>(effect),
+                       static_cast<int8_t>(strength));
+    std::lock_guard<std::mutex> lock(mHwMutex);
     ndk::ScopedAStatus status;
 
-    if (callback) {
-        status = ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
-    } else {
-        status = performEffect(effect, strength, _aidl_return);
+    preempt();
+    status = performEffect(effect, strength, _aidl_return);
+    if (status.isOk()) {
+        mCompletion.start(*_aidl_return, callback);
+        mResonance->hold(std::chrono::milliseconds(*_aidl_return));
     }
 
-    return status;
+    return record.finish(std::move(status));
+}
+
+// Each strength is rendered as a scale step and an od_clamp. The strength
+// picks the scale step, and a target G between the two levels of its effect:
+// the lower one for LIGHT, the upper one for STRONG and halfway for MEDIUM.
+// With a G curve, od_clamp is then solved so that the scaled waveform reaches
+// that target. Overdrive and braking are sized for od_clamp, so attenuating
+// through the scale keeps the waveform shape at every strength.
+void Vibrator::buildEffectPlans(Config *config) const {
+    static constexpr std::array<uint8_t, EFFECT_STRENGTH_COUNT> STRENGTH_SCALE = {
+            2,  // LIGHT, 50%
+            1,  // MEDIUM, 75%
+            0,  // STRONG, 100%
+    };
+
+    for (auto &plans : config->effectPlans) {
+        plans.fill({});
+    }
+
+    for (const auto &effect : ndk::enum_range<Effect>()) {
+        for (const auto &strength : ndk::enum_range<EffectStrength>()) {
+            EffectPlan plan{};
+            uint32_t level, upper;
+            float targetG;
+
+            plan.supported = true;
+
+            switch (effect) {
+                case Effect::TEXTURE_TICK:
+                    plan.sequence = WAVEFORM_TICK_EFFECT_SEQ;
+                    plan.waveform = WAVEFORM_TICK_EFFECT_INDEX;
+                    plan.durationMs = config->tickDuration;
+                    level = TEXTURE_TICK;
+                    break;
+                case Effect::CLICK:
+                    plan.sequence = WAVEFORM_CLICK_EFFECT_SEQ;
+                    plan.waveform = WAVEFORM_CLICK_EFFECT_INDEX;
+                    plan.durationMs = config->clickDuration;
+                    level = CLICK;
+                    break;
+                case Effect::DOUBLE_CLICK:
+                    plan.sequence = WAVEFORM_DOUBLE_CLICK_EFFECT_SEQ;
+                    plan.waveform = WAVEFORM_DOUBLE_CLICK_EFFECT_INDEX;
+                    plan.durationMs = config->doubleClickDuration;
+                    level = CLICK;
+                    break;
+                case Effect::TICK:
+                    plan.sequence = WAVEFORM_TICK_EFFECT_SEQ;
+                    plan.waveform = WAVEFORM_TICK_EFFECT_INDEX;
+                    plan.durationMs = config->tickDuration;
+                    level = TICK;
+                    break;
+                case Effect::HEAVY_CLICK:
+                    plan.sequence = WAVEFORM_HEAVY_CLICK_EFFECT_SEQ;
+                    plan.waveform = WAVEFORM_HEAVY_CLICK_EFFECT_INDEX;
+                    plan.durationMs = config->heavyClickDuration;
+                    level = HEAVY_CLICK;
+                    break;
+                default:
+                    continue;
+            }
+
+            // Texture ticks only have the one level.
+            upper = level == TEXTURE_TICK ? level : level + 1;
+            switch (strength) {
+                case EffectStrength::LIGHT:
+                    targetG = config->effectTargetG[level];
+                    break;
+                case EffectStrength::MEDIUM:
+                    targetG = (config->effectTargetG[level] + config->effectTargetG[upper]) / 2.0f;
+                    level = upper;
+                    break;
+                case EffectStrength::STRONG:
+                    targetG = config->effectTargetG[upper];
+                    level = upper;
+                    break;
+                default:
+                    continue;
+            }
+            // Without a rendered strength, the level alone sets the strength
+            // and plays at full scale.
+            plan.scale = 0;
+
+            if (const auto &effectConfig = config->effectConfig) {
+                uint8_t scale = STRENGTH_SCALE[static_cast<size_t>(strength)];
+
+                plan.hasConfig = true;
+                plan.shape = effectConfig->shape;
+                plan.odClamp = effectConfig->odClamp[level];
+                plan.olLraPeriod = effectConfig->olLraPeriod;
+                // When even full scale cannot reach the target, play the
+                // level at full scale, as far as its od_clamp allows.
+                if (config->hasEffectCoeffs &&
+                    calibration::renderStrength(config->effectCoeffs, targetG,
+                                                effectConfig->olLraPeriod,
+                                                config->effectOdClampMax, &scale,
+                                                &plan.odClamp)) {
+                    plan.scale = scale;
+                }
+            }
+
+            config->effectPlans[static_cast<size_t>(effect)][static_cast<size_t>(strength)] =
+                    plan;
+        }
+    }
+}
+
+const Vibrator::EffectPlan *Vibrator::getEffectPlan(const Config &config, Effect effect,
+                                                    EffectStrength strength) {
+    auto effectIndex = static_cast<size_t>(effect);
+    auto strengthIndex = static_cast<size_t>(strength);
+
+    if (effectIndex >= EFFECT_COUNT || strengthIndex >= EFFECT_STRENGTH_COUNT) {
+        return nullptr;
+    }
+
+    const EffectPlan &plan = config.effectPlans[effectIndex][strengthIndex];
+    return plan.supported ? &plan : nullptr;
 }
 
 ndk::ScopedAStatus Vibrator::performEffect(Effect effect, EffectStrength strength,
                                            int32_t *outTimeMs) {
-    ndk::ScopedAStatus status;
-    uint32_t timeMS;
-    int8_t volOffset;
-
-    switch (strength) {
-        case EffectStrength::LIGHT:
-            volOffset = 0;
-            break;
-        case EffectStrength::MEDIUM:
-            volOffset = 1;
-            break;
-        case EffectStrength::STRONG:
-            volOffset = 1;
-            break;
-        default:
-            return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
-            break;
-    }
-
-    switch (effect) {
-        case Effect::TEXTURE_TICK:
-            mHwApi->setSequencer(WAVEFORM_TICK_EFFECT_SEQ);
-            timeMS = mTickDuration;
-            volOffset = TEXTURE_TICK;
-            break;
-        case Effect::CLICK:
-            mHwApi->setSequencer(WAVEFORM_CLICK_EFFECT_SEQ);
-            timeMS = mClickDuration;
-            volOffset += CLICK;
-            break;
-        case Effect::DOUBLE_CLICK:
-            mHwApi->setSequencer(WAVEFORM_DOUBLE_CLICK_EFFECT_SEQ);
-            timeMS = mDoubleClickDuration;
-            volOffset += CLICK;
-            break;
-        case Effect::TICK:
-            mHwApi->setSequencer(WAVEFORM_TICK_EFFECT_SEQ);
-            timeMS = mTickDuration;
-            volOffset += TICK;
-            break;
-        case Effect::HEAVY_CLICK:
-            mHwApi->setSequencer(WAVEFORM_HEAVY_CLICK_EFFECT_SEQ);
-            timeMS = mHeavyClickDuration;
-            volOffset += HEAVY_CLICK;
-            break;
-        default:
-            return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    auto config = loadConfig();
+    const EffectPlan *plan = getEffectPlan(*config, effect, strength);
+
+    if (!plan) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
     }
-    status = on(timeMS, WAVEFORM_MODE, mEffectConfig, volOffset);
-    if (!status.isOk()) {
-        return status;
+
+    // Effects always play in open loop; see on().
+    mHwApi->setSequencer(plan->sequence);
+    mHwApi->setScale(plan->scale);
+    mHwApi->setCtrlLoop(toUnderlying(LoopControl::OPEN));
+    if (!mHwApi->setDuration(plan->durationMs)) {
+        ALOGE("Failed to set duration (%d): %s", errno, strerror(errno));
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
+
+    mHwApi->setMode(WAVEFORM_MODE);
+    if (plan->hasConfig) {
+        mHwApi->setLraWaveShape(toUnderlying(plan->shape));
+        mHwApi->setOdClamp(plan->odClamp);
+        mHwApi->setOlLraPeriod(plan->olLraPeriod);
+    }
+
+    if (!mHwApi->setActivate(1)) {
+        ALOGE("Failed to activate (%d): %s", errno, strerror(errno));
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
 
-    *outTimeMs = timeMS;
+    *outTimeMs = plan->durationMs;
 
     return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::getSupportedAlwaysOnEffects(std::vector<Effect> * /*_aidl_return*/) {
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+// The low-power trigger plays straight from the waveform library, so any
+// effect with a waveform plan can be always-on. The strength only selects the
+// plan; the library waveform is played at its stored amplitude.
+ndk::ScopedAStatus Vibrator::getSupportedAlwaysOnEffects(std::vector<Effect> *_aidl_return) {
+    return getSupportedEffects(_aidl_return);
 }
 
-ndk::ScopedAStatus Vibrator::alwaysOnEnable(int32_t /*id*/, Effect /*effect*/,
-                                            EffectStrength /*strength*/) {
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ndk::ScopedAStatus Vibrator::alwaysOnEnable(int32_t id, Effect effect, EffectStrength strength) {
+    ATRACE_NAME("Vibrator::alwaysOnEnable");
+    TraceRecord record(&mTrace, TraceApi::ALWAYS_ON_ENABLE, static_cast<int32_t>(effect),
+                       static_cast<int8_t>(strength));
+    std::lock_guard<std::mutex> lock(mHwMutex);
+    const EffectPlan *plan = getEffectPlan(*loadConfig(), effect, strength);
+
+    if (!plan) {
+        return record.finish(ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION));
+    }
+    if (!mAlwaysOn.enable(id, plan->waveform)) {
+        return record.finish(ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE));
+    }
+    return ndk::ScopedAStatus::ok();
 }
-ndk::ScopedAStatus Vibrator::alwaysOnDisable(int32_t /*id*/) {
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+
+ndk::ScopedAStatus Vibrator::alwaysOnDisable(int32_t id) {
+    ATRACE_NAME("Vibrator::alwaysOnDisable");
+    TraceRecord record(&mTrace, TraceApi::ALWAYS_ON_DISABLE, id);
+    std::lock_guard<std::mutex> lock(mHwMutex);
+    if (!mAlwaysOn.disable(id)) {
+        return record.finish(ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE));
+    }
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::getCompositionDelayMax(int32_t * /*maxDelayMs*/) {
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ndk::ScopedAStatus Vibrator::getCompositionDelayMax(int32_t *maxDelayMs) {
+    *maxDelayMs = COMPOSE_DELAY_MAX_MS;
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::getCompositionSizeMax(int32_t * /*maxSize*/) {
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ndk::ScopedAStatus Vibrator::getCompositionSizeMax(int32_t *maxSize) {
+    *maxSize = COMPOSE_SIZE_MAX;
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::getSupportedPrimitives(std::vector<CompositePrimitive> * /*supported*/) {
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+// Primitives are scaled by the composition itself, so they use the full scale
+// rendering of their effect.
+const Vibrator::EffectPlan *Vibrator::getPrimitivePlan(const Config &config,
+                                                       CompositePrimitive primitive) {
+    switch (primitive) {
+        case CompositePrimitive::CLICK:
+            return getEffectPlan(config, Effect::CLICK, EffectStrength::STRONG);
+        case CompositePrimitive::LIGHT_TICK:
+            return getEffectPlan(config, Effect::TICK, EffectStrength::STRONG);
+        default:
+            return nullptr;
+    }
 }
 
-ndk::ScopedAStatus Vibrator::getPrimitiveDuration(CompositePrimitive /*primitive*/,
-                                                  int32_t * /*durationMs*/) {
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ndk::ScopedAStatus Vibrator::getSupportedPrimitives(std::vector<CompositePrimitive> *supported) {
+    auto config = loadConfig();
+
+    supported->clear();
+    for (const auto &primitive : ndk::enum_range<CompositePrimitive>()) {
+        if (primitive == CompositePrimitive::NOOP || getPrimitivePlan(*config, primitive)) {
+            supported->push_back(primitive);
+        }
+    }
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::compose(const std::vector<CompositeEffect> & /*composite*/,
-                                     const std::shared_ptr<IVibratorCallback> & /*callback*/) {
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ndk::ScopedAStatus Vibrator::getPrimitiveDuration(CompositePrimitive primitive,
+                                                  int32_t *durationMs) {
+    const EffectPlan *plan;
+
+    if (primitive == CompositePrimitive::NOOP) {
+        *durationMs = 0;
+        return ndk::ScopedAStatus::ok();
+    }
+
+    plan = getPrimitivePlan(*loadConfig(), primitive);
+    if (!plan) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    }
+
+    *durationMs = plan->durationMs;
+    return ndk::ScopedAStatus::ok();
+}
+
+// Maps a composition scale onto the nearest hardware scale step:
+// 0 - 100%, 1 - 75%, 2 - 50%, 3 - 25%.
+static uint8_t scaleToRegister(float scale) {
+    return std::clamp<int>(std::round((1.0f - scale) * 4), 0, 3);
+}
+
+ndk::ScopedAStatus Vibrator::compose(const std::vector<CompositeEffect> &composite,
+                                     const std::shared_ptr<IVibratorCallback> &callback) {
+    ATRACE_NAME("Vibrator::compose");
+    auto config = loadConfig();
+    std::array<CompositionEngine::Step, CompositionEngine::STEPS_MAX> steps;
+    size_t count = 0;
+    uint32_t delayMs = 0;
+    uint32_t totalMs = 0;
+
+    if (composite.size() > COMPOSE_SIZE_MAX) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+
+    for (const auto &e : composite) {
+        const EffectPlan *plan;
+        CompositionEngine::Step *step;
+        uint8_t scale;
+
+        if (e.delayMs < 0 || static_cast<uint32_t>(e.delayMs) > COMPOSE_DELAY_MAX_MS) {
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+        }
+        delayMs += e.delayMs;
+        totalMs += e.delayMs;
+
+        if (e.primitive == CompositePrimitive::NOOP) {
+            continue;
+        }
+
+        if (e.scale < 0.0f || e.scale > 1.0f) {
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+        }
+        plan = getPrimitivePlan(*config, e.primitive);
+        if (!plan) {
+            return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+        }
+        totalMs += plan->durationMs;
+        scale = scaleToRegister(e.scale);
+
+        // Pack back-to-back primitives into a single sequencer activation
+        // until a delay, a scale change or a full sequencer forces a new one.
+        step = count ? &steps[count - 1] : nullptr;
+        if (!step || delayMs || step->scale != scale ||
+            step->count == CompositionEngine::SEQUENCER_SIZE) {
+            step = &steps[count++];
+            *step = {
+                .delayMs = delayMs,
+                .durationMs = 0,
+                .scale = scale,
+                .count = 0,
+                .waveforms = {},
+                .hasConfig = plan->hasConfig,
+                .shape = toUnderlying(plan->shape),
+                .odClamp = 0,
+                .olLraPeriod = plan->olLraPeriod,
+            };
+            delayMs = 0;
+        }
+        step->waveforms[step->count++] = plan->waveform;
+        step->durationMs += plan->durationMs;
+        step->odClamp = std::max(step->odClamp, plan->odClamp);
+    }
+
+    // Trailing delays still count towards the composition's completion.
+    if (delayMs) {
+        steps[count++] = {};
+        steps[count - 1].delayMs = delayMs;
+    }
+
+    TraceRecord record(&mTrace, TraceApi::COMPOSE, count);
+    std::lock_guard<std::mutex> lock(mHwMutex);
+    preempt();
+    mCompletion.stop();
+    mComposition.start(steps.data(), count, callback);
+    mResonance->hold(std::chrono::milliseconds(totalMs));
+
+    return ndk::ScopedAStatus::ok();
+}
+
+bool Vibrator::playCompositionStep(const CompositionEngine::Step &step) {
+    // Room for SEQUENCER_SIZE "<index> <count> " pairs.
+    char sequence[CompositionEngine::SEQUENCER_SIZE * 8];
+    size_t len = 0;
+    TraceRecord record(&mTrace, TraceApi::COMPOSITION_STEP, step.count);
+
+    for (size_t i = 0; i < step.count; i++) {
+        len += snprintf(sequence + len, sizeof(sequence) - len, "%s%" PRIu8 " 0", i ? " " : "",
+                        step.waveforms[i]);
+    }
+
+    mHwApi->setScale(step.scale);
+    mHwApi->setSequencer(sequence);
+    mHwApi->setCtrlLoop(toUnderlying(LoopControl::OPEN));
+    if (!mHwApi->setDuration(step.durationMs)) {
+        ALOGE("Failed to set duration (%d): %s", errno, strerror(errno));
+        record.setStatus(EX_ILLEGAL_STATE);
+        return false;
+    }
+
+    mHwApi->setMode(WAVEFORM_MODE);
+    if (step.hasConfig) {
+        mHwApi->setLraWaveShape(step.shape);
+        mHwApi->setOdClamp(step.odClamp);
+        mHwApi->setOlLraPeriod(step.olLraPeriod);
+    }
+
+    if (!mHwApi->setActivate(1)) {
+        ALOGE("Failed to activate (%d): %s", errno, strerror(errno));
+        record.setStatus(EX_ILLEGAL_STATE);
+        return false;
+    }
+
+    return true;
 }
 
 static float freqPeriodFormulaFloat(std::uint32_t in) {
@@ -715,46 +1074,169 @@ static float freqPeriodFormulaFloat(std::uint32_t in) {
 }
 
 ndk::ScopedAStatus Vibrator::getResonantFrequency(float *resonantFreqHz) {
-    uint32_t lraPeriod;
-    if(!mHwCal->getLraPeriod(&lraPeriod)) {
-        ALOGE("Failed to get resonant frequency (%d): %s", errno, strerror(errno));
-        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
-    }
-    *resonantFreqHz = freqPeriodFormulaFloat(lraPeriod);
+    *resonantFreqHz = freqPeriodFormulaFloat(loadConfig()->lraPeriod);
     return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::getQFactor(float * /*qFactor*/) {
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ndk::ScopedAStatus Vibrator::getQFactor(float *qFactor) {
+    *qFactor = loadConfig()->qFactor;
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::getFrequencyResolution(float * /*freqResolutionHz*/) {
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ndk::ScopedAStatus Vibrator::getFrequencyResolution(float *freqResolutionHz) {
+    *freqResolutionHz = PWLE_FREQUENCY_RESOLUTION_HZ;
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::getFrequencyMinimum(float * /*freqMinimumHz*/) {
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ndk::ScopedAStatus Vibrator::getFrequencyMinimum(float *freqMinimumHz) {
+    *freqMinimumHz = loadConfig()->pwleLimits().frequencyMin;
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::getBandwidthAmplitudeMap(std::vector<float> * /*_aidl_return*/) {
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ndk::ScopedAStatus Vibrator::getBandwidthAmplitudeMap(std::vector<float> *_aidl_return) {
+    *_aidl_return = loadConfig()->pwleLimits().bandwidthAmplitudeMap;
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::getPwlePrimitiveDurationMax(int32_t * /*durationMs*/) {
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ndk::ScopedAStatus Vibrator::getPwlePrimitiveDurationMax(int32_t *durationMs) {
+    *durationMs = PwleEngine::PRIMITIVE_DURATION_MAX_MS;
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::getPwleCompositionSizeMax(int32_t * /*maxSize*/) {
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ndk::ScopedAStatus Vibrator::getPwleCompositionSizeMax(int32_t *maxSize) {
+    *maxSize = PwleEngine::COMPOSITION_SIZE_MAX;
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::getSupportedBraking(std::vector<Braking> * /*supported*/) {
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ndk::ScopedAStatus Vibrator::getSupportedBraking(std::vector<Braking> *supported) {
+    *supported = {Braking::NONE};
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::composePwle(const std::vector<PrimitivePwle> & /*composite*/,
-                                         const std::shared_ptr<IVibratorCallback> & /*callback*/) {
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ndk::ScopedAStatus Vibrator::composePwle(const std::vector<PrimitivePwle> &composite,
+                                         const std::shared_ptr<IVibratorCallback> &callback) {
+    ATRACE_NAME("Vibrator::composePwle");
+    auto config = loadConfig();
+
+    if (!mHwApi->hasRtpInput()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    }
+    if (composite.empty() || composite.size() > PwleEngine::COMPOSITION_SIZE_MAX) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+
+    const auto &limits = config->pwleLimits();
+    uint32_t totalMs = 0;
+    for (const auto &pwle : composite) {
+        int32_t durationMs;
+
+        if (pwle.getTag() == PrimitivePwle::active) {
+            const auto &active = pwle.get<PrimitivePwle::active>();
+            for (float amplitude : {active.startAmplitude, active.endAmplitude}) {
+                if (amplitude < 0.0f || amplitude > 1.0f) {
+                    return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+                }
+            }
+            for (float frequency : {active.startFrequency, active.endFrequency}) {
+                if (frequency < limits.frequencyMin || frequency > limits.frequencyMax) {
+                    return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+                }
+            }
+            durationMs = active.duration;
+        } else {
+            const auto &braking = pwle.get<PrimitivePwle::braking>();
+            if (braking.braking != Braking::NONE) {
+                return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+            }
+            durationMs = braking.duration;
+        }
+
+        if (durationMs < 0 ||
+            static_cast<uint32_t>(durationMs) > PwleEngine::PRIMITIVE_DURATION_MAX_MS) {
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+        }
+        totalMs += durationMs;
+    }
+
+    TraceRecord record(&mTrace, TraceApi::COMPOSE_PWLE, composite.size());
+    std::lock_guard<std::mutex> lock(mHwMutex);
+    preempt();
+    mCompletion.stop();
+    mPwle.start(composite, callback);
+    mResonance->hold(std::chrono::milliseconds(totalMs));
+
+    return ndk::ScopedAStatus::ok();
+}
+
+const Vibrator::Config::PwleLimits &Vibrator::Config::pwleLimits() const {
+    std::call_once(pwleOnce, [this] { buildBandwidthAmplitudeMap(*this, &pwle); });
+    return pwle;
+}
+
+void Vibrator::buildBandwidthAmplitudeMap(const Config &config, Config::PwleLimits *limits) {
+    float resonantFreqHz = freqPeriodFormulaFloat(config.lraPeriod);
+    float qFactor = config.qFactor;
+    size_t count = PWLE_BANDWIDTH_HZ / PWLE_FREQUENCY_RESOLUTION_HZ + 1;
+
+    limits->frequencyMin =
+        std::round((resonantFreqHz - PWLE_BANDWIDTH_HZ / 2) / PWLE_FREQUENCY_RESOLUTION_HZ) *
+        PWLE_FREQUENCY_RESOLUTION_HZ;
+    limits->frequencyMax = limits->frequencyMin + (count - 1) * PWLE_FREQUENCY_RESOLUTION_HZ;
+
+    // Response of a driven resonator relative to its peak of Q at resonance.
+    limits->bandwidthAmplitudeMap.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        float ratio = (limits->frequencyMin + i * PWLE_FREQUENCY_RESOLUTION_HZ) / resonantFreqHz;
+        float detune = 1.0f - ratio * ratio;
+        float response = 1.0f / std::sqrt(detune * detune + std::pow(ratio / qFactor, 2));
+        limits->bandwidthAmplitudeMap[i] = std::min(response / qFactor, 1.0f);
+    }
+}
+
+bool Vibrator::beginPwle(uint32_t durationMs) {
+    auto config = loadConfig();
+
+    // The LRA period only applies in open loop.
+    mHwApi->setCtrlLoop(toUnderlying(LoopControl::OPEN));
+    if (!mHwApi->setDuration(durationMs)) {
+        ALOGE("Failed to set duration (%d): %s", errno, strerror(errno));
+        return false;
+    }
+    mHwApi->setMode(RTP_MODE);
+    if (const auto &steadyConfig = config->steadyConfig) {
+        mHwApi->setLraWaveShape(toUnderlying(steadyConfig->shape));
+        mHwApi->setOdClamp(steadyConfig->odClamp[0]);
+    }
+    if (!mHwApi->setActivate(1)) {
+        ALOGE("Failed to activate (%d): %s", errno, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool Vibrator::writePwle(const PwleEngine::Sample &sample) {
+    if (sample.olLraPeriod) {
+        mHwApi->setOlLraPeriod(sample.olLraPeriod);
+    }
+    if (!mHwApi->setRtpInput(sample.rtpInput)) {
+        ALOGE("Failed to set RTP input (%d): %s", errno, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void Vibrator::stopPwle() {
+    if (!mHwApi->setActivate(0)) {
+        ALOGE("Failed to stop PWLE (%d): %s", errno, strerror(errno));
+    }
+}
+
+void Vibrator::endPwle() {
+    // Effects rely on the configured period without dynamic config, and on()
+    // writes its own period otherwise.
+    if (!mDynamicConfig) {
+        mHwApi->setOlLraPeriod(loadConfig()->lraPeriod);
+    }
 }
 
 }  // namespace vibrator
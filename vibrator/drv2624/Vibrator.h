@@ -18,6 +18,19 @@
 #include <aidl/android/hardware/vibrator/BnVibrator.h>
 
 #include <fstream>
+#include <functional>
+#include <mutex>
+
+#include "AlwaysOnEffects.h"
+#include "CommandTrace.h"
+#include "CompletionEngine.h"
+#include "CompositionEngine.h"
+#include "MotionAwareness.h"
+#include "OdClampTable.h"
+#include "PwleEngine.h"
+#include "ResonanceTracker.h"
+#include "StartupProfile.h"
+#include "TemperatureCache.h"
 
 namespace aidl {
 namespace android {
@@ -80,6 +93,8 @@ class Vibrator : public BnVibrator {
         virtual bool setOdClamp(uint32_t value) = 0;
         // Get usb temperature sensor value
         virtual bool getPATemp(int32_t *value) = 0;
+        // Reads the LRA period measured by the last auto calibration.
+        virtual bool getLraPeriod(uint32_t *value) = 0;
         // Emit diagnostic information to the given file.
         virtual void debug(int fd) = 0;
     };
@@ -128,6 +143,20 @@ class Vibrator : public BnVibrator {
         virtual bool getTriggerEffectSupport(uint32_t *value) = 0;
         // Obtains device hardware version
         virtual bool getDevHwVer(std::string *value) = 0;
+        // Obtains how long in ms a PA temperature reading may be reused.
+        virtual bool getTemperatureMaxAge(uint32_t *value) = 0;
+        // Obtains the quality factor of the LRA.
+        virtual bool getQFactor(float *value) = 0;
+        // Obtains the interval in ms between resonance measurements, or 0.
+        virtual bool getResonanceInterval(uint32_t *value) = 0;
+        // Obtains the always-on effect table stored by a previous instance.
+        virtual bool getAlwaysOnState(std::string *value) = 0;
+        // Stores the always-on effect table for future instances.
+        virtual bool setAlwaysOnState(const std::string &value) = 0;
+        // Calls 'onChange' from a background thread whenever the calibration
+        // or a tuning property changes, once the getters return the new
+        // values. An empty function stops watching.
+        virtual void watch(std::function<void()> onChange) = 0;
         // Emit diagnostic information to the given file.
         virtual void debug(int fd) = 0;
     };
@@ -145,7 +174,7 @@ class Vibrator : public BnVibrator {
 
     struct VibrationConfig {
         WaveShape shape;
-        uint32_t *odClamp;
+        const uint32_t *odClamp;
         uint32_t olLraPeriod;
     };
 
@@ -156,8 +185,69 @@ class Vibrator : public BnVibrator {
         HEAVY_CLICK,
     };
 
+    // Register values resolved at construction for playing an effect at a
+    // given strength. Replayed by performEffect() in the same order as on().
+    struct EffectPlan {
+        bool supported;
+        const char *sequence;
+        // Waveform library index played by 'sequence'.
+        uint8_t waveform;
+        uint32_t durationMs;
+        // Value for HwApi::setScale().
+        uint8_t scale;
+        // Shape, OD clamp and LRA period are only written with dynamic config.
+        bool hasConfig;
+        WaveShape shape;
+        uint32_t odClamp;
+        uint32_t olLraPeriod;
+    };
+
+    static constexpr size_t EFFECT_COUNT = static_cast<size_t>(Effect::TEXTURE_TICK) + 1;
+    static constexpr size_t EFFECT_STRENGTH_COUNT =
+        static_cast<size_t>(EffectStrength::STRONG) + 1;
+    using EffectPlans = std::array<std::array<EffectPlan, EFFECT_STRENGTH_COUNT>, EFFECT_COUNT>;
+
+    // Everything derived from the calibration for one LRA period. A snapshot
+    // is never modified once published, so readers on any thread only need
+    // to keep their reference for the duration of a call.
+    struct Config {
+        uint32_t lraPeriod;
+        float qFactor;
+        uint32_t closeLoopThreshold;
+        uint32_t clickDuration;
+        uint32_t tickDuration;
+        uint32_t doubleClickDuration;
+        uint32_t heavyClickDuration;
+        std::array<float, 5> effectTargetG;
+        std::array<float, 3> steadyTargetG;
+        std::array<uint32_t, 5> effectTargetOdClamp;
+        std::array<uint32_t, 3> steadyTargetOdClamp;
+        // Only set with dynamic config. 'odClamp' points into the arrays above.
+        std::unique_ptr<VibrationConfig> steadyConfig;
+        std::unique_ptr<VibrationConfig> effectConfig;
+        // G curve and od_clamp limit from which effect strengths are rendered;
+        // only set with dynamic config and effect coefficients.
+        bool hasEffectCoeffs = false;
+        std::array<float, 4> effectCoeffs;
+        uint32_t effectOdClampMax;
+        OdClampTable steadyTable;
+        EffectPlans effectPlans;
+
+        // PWLE limits are derived on first use, since most clients never
+        // compose PWLEs.
+        struct PwleLimits {
+            float frequencyMin;
+            float frequencyMax;
+            std::vector<float> bandwidthAmplitudeMap;
+        };
+        const PwleLimits &pwleLimits() const;
+        mutable std::once_flag pwleOnce;
+        mutable PwleLimits pwle;
+    };
+
   public:
     Vibrator(std::unique_ptr<HwApi> hwapi, std::unique_ptr<HwCal> hwcal);
+    ~Vibrator();
 
     ndk::ScopedAStatus getCapabilities(int32_t *_aidl_return) override;
     ndk::ScopedAStatus off() override;
@@ -169,8 +259,8 @@ class Vibrator : public BnVibrator {
     ndk::ScopedAStatus getSupportedEffects(std::vector<Effect> *_aidl_return) override;
     ndk::ScopedAStatus setAmplitude(float amplitude) override;
     ndk::ScopedAStatus setExternalControl(bool enabled) override;
-    ndk::ScopedAStatus getCompositionDelayMax(int32_t *maxDelayMs);
-    ndk::ScopedAStatus getCompositionSizeMax(int32_t *maxSize);
+    ndk::ScopedAStatus getCompositionDelayMax(int32_t *maxDelayMs) override;
+    ndk::ScopedAStatus getCompositionSizeMax(int32_t *maxSize) override;
     ndk::ScopedAStatus getSupportedPrimitives(std::vector<CompositePrimitive> *supported) override;
     ndk::ScopedAStatus getPrimitiveDuration(CompositePrimitive primitive,
                                             int32_t *durationMs) override;
@@ -193,24 +283,54 @@ class Vibrator : public BnVibrator {
     binder_status_t dump(int fd, const char **args, uint32_t numArgs) override;
 
   private:
-    ndk::ScopedAStatus on(uint32_t timeoutMs, const char mode[],
-                          const std::unique_ptr<VibrationConfig> &config, const int8_t volOffset);
+    ndk::ScopedAStatus on(uint32_t timeoutMs, const char mode[], LoopControl loopMode,
+                          const VibrationConfig *config, const int8_t volOffset);
     ndk::ScopedAStatus performEffect(Effect effect, EffectStrength strength, int32_t *outTimeMs);
+    // Derives all register values from the calibration for the given period.
+    // Only reads the calibration, so it may run without holding mHwMutex.
+    std::shared_ptr<Config> buildConfig(uint32_t lraPeriod) const;
+    // Publishes 'config' as the current configuration. Called with mHwMutex
+    // held, since the static config writes the LRA period to the hardware.
+    void publishConfig(std::shared_ptr<Config> config);
+    void configure(uint32_t lraPeriod) { publishConfig(buildConfig(lraPeriod)); }
+    // Applies a changed calibration, see HwCal::watch().
+    void reload();
+    std::shared_ptr<const Config> loadConfig() const { return std::atomic_load(&mConfig); }
+    // Stops background playback and measurement before taking the hardware.
+    void preempt();
+    bool beginResonanceMeasurement();
+    bool finishResonanceMeasurement(uint32_t *lraPeriod);
+    void abortResonanceMeasurement();
+    void restoreAutocal();
+    void buildEffectPlans(Config *config) const;
+    static const EffectPlan *getEffectPlan(const Config &config, Effect effect,
+                                           EffectStrength strength);
+    static const EffectPlan *getPrimitivePlan(const Config &config, CompositePrimitive primitive);
+    bool playCompositionStep(const CompositionEngine::Step &step);
+    static void buildBandwidthAmplitudeMap(const Config &config, Config::PwleLimits *limits);
+    bool beginPwle(uint32_t durationMs);
+    bool writePwle(const PwleEngine::Sample &sample);
+    void stopPwle();
+    void endPwle();
 
     std::unique_ptr<HwApi> mHwApi;
     std::unique_ptr<HwCal> mHwCal;
-    uint32_t mCloseLoopThreshold;
-    std::unique_ptr<VibrationConfig> mSteadyConfig;
-    std::unique_ptr<VibrationConfig> mEffectConfig;
-    uint32_t mClickDuration;
-    uint32_t mTickDuration;
-    uint32_t mDoubleClickDuration;
-    uint32_t mHeavyClickDuration;
-    std::array<uint32_t, 5> mEffectTargetOdClamp;
-    std::array<uint32_t, 3> mSteadyTargetOdClamp;
-    uint32_t mSteadyOlLraPeriod;
-    uint32_t mSteadyOlLraPeriodShift;
     bool mDynamicConfig;
+    // Set for EVT and PROTO builds, which need their own target G values.
+    bool mEvtDevice{false};
+    std::unique_ptr<MotionAwareness> mMotionAwareness;
+    std::unique_ptr<TemperatureCache> mTemperature;
+    // Only accessed through std::atomic_load() and std::atomic_store().
+    std::shared_ptr<const Config> mConfig;
+    // Serializes hardware commands issued from binder threads. Engine threads
+    // are kept out by preempt() instead, which waits for their current write.
+    std::mutex mHwMutex;
+    CommandTrace mTrace;
+    CompletionEngine mCompletion;
+    CompositionEngine mComposition;
+    PwleEngine mPwle;
+    AlwaysOnEffects mAlwaysOn;
+    std::unique_ptr<ResonanceTracker> mResonance;
 };
 
 }  // namespace vibrator
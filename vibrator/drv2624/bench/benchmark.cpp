@@ -17,8 +17,21 @@
 #include <android-base/file.h>
 #include <android-base/properties.h>
 #include <cutils/fs.h>
-
+#include <utils/SystemClock.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "Calibration.h"
+#include "CalibrationSnapshot.h"
+#include "CommandTrace.h"
+#include "DriverSimulator.h"
 #include "Hardware.h"
+#include "MotionAwareness.h"
 #include "Vibrator.h"
 
 namespace aidl {
@@ -28,6 +41,67 @@ namespace vibrator {
 
 using ::android::base::SetProperty;
 
+// A complete calibration, so that the constructor derives every table.
+static constexpr char CALIBRATION_DATA[] =
+        "autocal: 12 130 35\n"
+        "lra_period: 262\n"
+        "haptic_coefficient: -0.04 0.22 0.22 0.0\n"
+        "haptic_target_G: 0.275 0.55 0.6 0.9 1.12\n"
+        "vibration_amp_max: 0.95\n"
+        "vibration_coefficient: -0.06 0.28 0.19 0.0\n"
+        "vibration_target_G: 0.6 0.9 1.2\n"
+        "q_factor: 12.5\n";
+// Reported by the simulated driver, as calibrated above.
+static constexpr uint32_t LRA_PERIOD = 262;
+
+// Records the latency of every iteration and reports the percentiles as
+// counters, since the mean hides the outliers that are felt on hardware. Only
+// the first SAMPLES_MAX iterations are kept.
+class Latency {
+  public:
+    explicit Latency(benchmark::State &state) : mState(state) {
+        mSamples.reserve(std::min<size_t>(state.max_iterations, SAMPLES_MAX));
+    }
+
+    ~Latency() {
+        if (mSamples.empty()) {
+            return;
+        }
+        std::sort(mSamples.begin(), mSamples.end());
+        // Each thread records its own samples; report the average across threads.
+        mState.counters["p50_us"] = benchmark::Counter(percentile(50), kPerThread);
+        mState.counters["p99_us"] = benchmark::Counter(percentile(99), kPerThread);
+        mState.counters["max_us"] = benchmark::Counter(percentile(100), kPerThread);
+    }
+
+    using Clock = std::chrono::steady_clock;
+
+    template <typename F>
+    void measure(F &&func) {
+        auto begin = Clock::now();
+        func();
+        add(Clock::now() - begin);
+    }
+
+    void add(Clock::duration sample) {
+        if (mSamples.size() < SAMPLES_MAX) {
+            mSamples.push_back(std::chrono::duration<double, std::micro>(sample).count());
+        }
+    }
+
+  private:
+
+    static constexpr size_t SAMPLES_MAX = 1 << 18;
+    static constexpr auto kPerThread = benchmark::Counter::kAvgThreads;
+
+    double percentile(size_t p) const {
+        return mSamples[std::min(mSamples.size() * p / 100, mSamples.size() - 1)];
+    }
+
+    benchmark::State &mState;
+    std::vector<double> mSamples;
+};
+
 class VibratorBench : public benchmark::Fixture {
   private:
     static constexpr const char *FILE_NAMES[]{
@@ -44,6 +118,7 @@ class VibratorBench : public benchmark::Fixture {
         "device/lp_trigger_effect",
         "device/lra_wave_shape",
         "device/od_clamp",
+        "device/lra_period",
     };
     static constexpr char PROPERTY_PREFIX[] = "test.vibrator.hal.";
 
@@ -61,21 +136,31 @@ class VibratorBench : public benchmark::Fixture {
             symlink("/dev/null", path.c_str());
         }
 
+        std::ofstream{mCalFile.path} << CALIBRATION_DATA;
+        setenv("CALIBRATION_FILEPATH", mCalFile.path, true);
+
         setenv("PROPERTY_PREFIX", PROPERTY_PREFIX, true);
 
         SetProperty(std::string() + PROPERTY_PREFIX + "config.dynamic", getDynamicConfig(state));
+        // Read the temperature on every vibration, as a cold cache would.
+        SetProperty(std::string() + PROPERTY_PREFIX + "temperature.maxage", "0");
 
-        mVibrator = ndk::SharedRefBase::make<Vibrator>(HwApi::Create(), std::make_unique<HwCal>());
+        mVibrator = createVibrator(state);
     }
 
+    void TearDown(::benchmark::State & /*state*/) override { mVibrator.reset(); }
+
     static void DefaultConfig(benchmark::internal::Benchmark *b) {
         b->Unit(benchmark::kMicrosecond);
     }
 
     static void DefaultArgs(benchmark::internal::Benchmark *b) {
-        b->ArgNames({"DynamicConfig"});
-        b->Args({false});
-        b->Args({true});
+        b->ArgNames({"DynamicConfig", "FdBackend"});
+        for (const auto &dynamic : {false, true}) {
+            for (const auto &fdBackend : {false, true}) {
+                b->Args({dynamic, fdBackend});
+            }
+        }
     }
 
   protected:
@@ -83,12 +168,26 @@ class VibratorBench : public benchmark::Fixture {
         return std::to_string(state.range(0));
     }
 
+    bool getFdBackend(const ::benchmark::State &state) const { return state.range(1); }
+
+    virtual std::unique_ptr<Vibrator::HwApi> createHwApi(const ::benchmark::State &state) const {
+        if (getFdBackend(state)) {
+            return HwApiFd::Create();
+        }
+        return HwApi::Create();
+    }
+
+    std::shared_ptr<IVibrator> createVibrator(const ::benchmark::State &state) const {
+        return ndk::SharedRefBase::make<Vibrator>(createHwApi(state), std::make_unique<HwCal>());
+    }
+
     auto getOtherArg(const ::benchmark::State &state, std::size_t index) const {
-        return state.range(index + 1);
+        return state.range(index + 2);
     }
 
   protected:
     TemporaryDir mFilesDir;
+    TemporaryFile mCalFile;
     std::shared_ptr<IVibrator> mVibrator;
 };
 
@@ -101,23 +200,27 @@ class VibratorBench : public benchmark::Fixture {
 
 BENCHMARK_WRAPPER(VibratorBench, on, {
     uint32_t duration = std::rand() ?: 1;
+    Latency latency(state);
 
     for (auto _ : state) {
-        mVibrator->on(duration, nullptr);
+        latency.measure([&] { mVibrator->on(duration, nullptr); });
     }
 });
 
 BENCHMARK_WRAPPER(VibratorBench, off, {
+    Latency latency(state);
+
     for (auto _ : state) {
-        mVibrator->off();
+        latency.measure([&] { mVibrator->off(); });
     }
 });
 
 BENCHMARK_WRAPPER(VibratorBench, setAmplitude, {
     uint8_t amplitude = std::rand() ?: 1;
+    Latency latency(state);
 
     for (auto _ : state) {
-        mVibrator->setAmplitude(amplitude);
+        latency.measure([&] { mVibrator->setAmplitude(amplitude); });
     }
 });
 
@@ -141,14 +244,160 @@ BENCHMARK_WRAPPER(VibratorBench, getCapabilities, {
     }
 });
 
+// Startup with a full calibration: reading the calibration file, solving the
+// OD clamps for every effect and temperature bucket, and starting the engine
+// threads. Destruction is not measured.
+BENCHMARK_WRAPPER(VibratorBench, constructor, {
+    Latency latency(state);
+
+    for (auto _ : state) {
+        std::shared_ptr<IVibrator> vibrator;
+
+        latency.measure([&] { vibrator = createVibrator(state); });
+
+        state.PauseTiming();
+        vibrator.reset();
+        state.ResumeTiming();
+    }
+});
+
+// Feeds getPATemp() from the benchmark so that every temperature bucket of
+// the steady OD clamp table is exercised.
+class VibratorThermalBench : public VibratorBench {
+  public:
+    static void DefaultArgs(benchmark::internal::Benchmark *b) {
+        b->ArgNames({"DynamicConfig", "FdBackend", "Temperature"});
+        for (const auto &fdBackend : {false, true}) {
+            // Below the lower bound, between the bounds, above the upper bound.
+            for (const auto &temperature : {0, 7500, 20000}) {
+                b->Args({true, fdBackend, temperature});
+            }
+        }
+    }
+
+  protected:
+    class ThermalApi : public Vibrator::HwApi {
+      public:
+        ThermalApi(std::unique_ptr<Vibrator::HwApi> hwapi, int32_t temperature)
+            : mHwApi(std::move(hwapi)), mTemperature(temperature) {}
+
+        bool setAutocal(std::string value) override { return mHwApi->setAutocal(value); }
+        bool setOlLraPeriod(uint32_t value) override { return mHwApi->setOlLraPeriod(value); }
+        bool setActivate(bool value) override { return mHwApi->setActivate(value); }
+        bool setDuration(uint32_t value) override { return mHwApi->setDuration(value); }
+        bool setState(bool value) override { return mHwApi->setState(value); }
+        bool hasRtpInput() override { return mHwApi->hasRtpInput(); }
+        bool setRtpInput(int8_t value) override { return mHwApi->setRtpInput(value); }
+        bool setMode(std::string value) override { return mHwApi->setMode(value); }
+        bool setSequencer(std::string value) override { return mHwApi->setSequencer(value); }
+        bool setScale(uint8_t value) override { return mHwApi->setScale(value); }
+        bool setCtrlLoop(bool value) override { return mHwApi->setCtrlLoop(value); }
+        bool setLpTriggerEffect(uint32_t value) override {
+            return mHwApi->setLpTriggerEffect(value);
+        }
+        bool setLraWaveShape(uint32_t value) override { return mHwApi->setLraWaveShape(value); }
+        bool setOdClamp(uint32_t value) override { return mHwApi->setOdClamp(value); }
+        bool getPATemp(int32_t *value) override {
+            *value = mTemperature;
+            return true;
+        }
+        bool getLraPeriod(uint32_t *value) override { return mHwApi->getLraPeriod(value); }
+        void debug(int fd) override { mHwApi->debug(fd); }
+
+      private:
+        std::unique_ptr<Vibrator::HwApi> mHwApi;
+        const int32_t mTemperature;
+    };
+
+    std::unique_ptr<Vibrator::HwApi> createHwApi(
+            const ::benchmark::State &state) const override {
+        return std::make_unique<ThermalApi>(VibratorBench::createHwApi(state),
+                                            getOtherArg(state, 0));
+    }
+};
+
+BENCHMARK_WRAPPER(VibratorThermalBench, on, {
+    uint32_t duration = std::rand() ?: 1;
+    Latency latency(state);
+
+    for (auto _ : state) {
+        latency.measure([&] { mVibrator->on(duration, nullptr); });
+    }
+});
+
+// The HAL in front of the simulated driver, with or without its modeled
+// transfer times. Latency is taken from the call to the completion of the
+// activate write, as felt by the user.
+class VibratorSimBench : public VibratorBench {
+  public:
+    void SetUp(::benchmark::State &state) override {
+        mSim = std::make_unique<DriverSimulator>(getModeled(state) ? DriverSimulator::DEFAULT_TIMING
+                                                                   : DriverSimulator::Timing{});
+        // Created ahead of the /dev/null nodes of the base fixture, so that
+        // the simulator sees which writes reach the driver.
+        DriverSimulator::createNodes(mFilesDir.path, LRA_PERIOD);
+        VibratorBench::SetUp(state);
+    }
+
+    void TearDown(::benchmark::State &state) override {
+        VibratorBench::TearDown(state);
+        mSim.reset();
+    }
+
+    static void DefaultArgs(benchmark::internal::Benchmark *b) {
+        b->ArgNames({"DynamicConfig", "FdBackend", "Modeled"});
+        for (const auto &dynamic : {false, true}) {
+            for (const auto &fdBackend : {false, true}) {
+                for (const auto &modeled : {false, true}) {
+                    b->Args({dynamic, fdBackend, modeled});
+                }
+            }
+        }
+    }
+
+  protected:
+    bool getModeled(const ::benchmark::State &state) const { return getOtherArg(state, 0); }
+
+    std::unique_ptr<Vibrator::HwApi> createHwApi(
+            const ::benchmark::State &state) const override {
+        return mSim->wrap(VibratorBench::createHwApi(state));
+    }
+
+    std::unique_ptr<DriverSimulator> mSim;
+};
+
+BENCHMARK_WRAPPER(VibratorSimBench, on, {
+    Latency latency(state);
+
+    for (auto _ : state) {
+        auto begin = Latency::Clock::now();
+        mVibrator->on(100, nullptr);
+        latency.add(mSim->lastActivation() - begin);
+    }
+});
+
+BENCHMARK_WRAPPER(VibratorSimBench, perform, {
+    int32_t lengthMs;
+    Latency latency(state);
+
+    for (auto _ : state) {
+        auto begin = Latency::Clock::now();
+        mVibrator->perform(Effect::CLICK, EffectStrength::MEDIUM, nullptr, &lengthMs);
+        latency.add(mSim->lastActivation() - begin);
+    }
+});
+
 class VibratorEffectsBench : public VibratorBench {
   public:
     static void DefaultArgs(benchmark::internal::Benchmark *b) {
-        b->ArgNames({"DynamicConfig", "Effect", "Strength"});
+        b->ArgNames({"DynamicConfig", "FdBackend", "Effect", "Strength"});
         for (const auto &dynamic : {false, true}) {
-            for (const auto &effect : ndk::enum_range<Effect>()) {
-                for (const auto &strength : ndk::enum_range<EffectStrength>()) {
-                    b->Args({dynamic, static_cast<long>(effect), static_cast<long>(strength)});
+            for (const auto &fdBackend : {false, true}) {
+                for (const auto &effect : ndk::enum_range<Effect>()) {
+                    for (const auto &strength : ndk::enum_range<EffectStrength>()) {
+                        b->Args({dynamic, fdBackend, static_cast<long>(effect),
+                                 static_cast<long>(strength)});
+                    }
                 }
             }
         }
@@ -172,14 +421,168 @@ BENCHMARK_WRAPPER(VibratorEffectsBench, perform, {
     ndk::ScopedAStatus status = mVibrator->perform(effect, strength, nullptr, &lengthMs);
 
     if (status.getExceptionCode() == EX_UNSUPPORTED_OPERATION) {
+        state.SkipWithError("effect is not supported");
         return;
     }
 
+    Latency latency(state);
+
     for (auto _ : state) {
-        mVibrator->perform(effect, strength, nullptr, &lengthMs);
+        latency.measure([&] { mVibrator->perform(effect, strength, nullptr, &lengthMs); });
     }
 });
 
+// Several haptic clients at once: every thread cycles through on(), perform(),
+// setAmplitude() and off() on a shared instance. The fixture is shared by all
+// threads, so only the first one sets it up; the others wait for it at the
+// start of the measurement loop.
+class VibratorContentionBench : public VibratorBench {
+  public:
+    void SetUp(::benchmark::State &state) override {
+        if (state.thread_index() == 0) {
+            VibratorBench::SetUp(state);
+        }
+    }
+
+    void TearDown(::benchmark::State &state) override {
+        if (state.thread_index() == 0) {
+            VibratorBench::TearDown(state);
+        }
+    }
+
+    static void DefaultArgs(benchmark::internal::Benchmark *b) {
+        VibratorBench::DefaultArgs(b);
+        b->ThreadRange(1, 8)->UseRealTime();
+    }
+};
+
+BENCHMARK_WRAPPER(VibratorContentionBench, mixed, {
+    uint32_t i = state.thread_index();
+    int32_t lengthMs;
+    Latency latency(state);
+
+    for (auto _ : state) {
+        latency.measure([&] {
+            switch (i++ % 4) {
+                case 0:
+                    mVibrator->on(100, nullptr);
+                    break;
+                case 1:
+                    mVibrator->perform(Effect::CLICK, EffectStrength::MEDIUM, nullptr, &lengthMs);
+                    break;
+                case 2:
+                    mVibrator->setAmplitude(0.5f);
+                    break;
+                default:
+                    mVibrator->off();
+                    break;
+            }
+        });
+    }
+
+    state.SetItemsProcessed(state.iterations());
+});
+
+// Motion awareness as seen by on(): reading the gravity average while a thread
+// keeps pushing samples in place of the sensor, for a device lying flat or in
+// motion.
+static void MotionBench_isMoving(benchmark::State &state) {
+    const bool moving = state.range(0);
+    std::atomic<bool> exit{false};
+    MotionAwareness motion(false);
+    Latency latency(state);
+
+    std::thread sensor([&] {
+        uint32_t i = 0;
+
+        while (!exit.load(std::memory_order_relaxed)) {
+            float noise = (i++ % 16) * 0.01f;
+            int64_t timestampNs = ::android::elapsedRealtimeNano();
+            if (moving) {
+                motion.push(3.0f + noise, 6.0f - noise, timestampNs);
+            } else {
+                motion.push(0.1f + noise, 0.2f - noise, timestampNs);
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+
+    for (auto _ : state) {
+        bool result;
+
+        latency.measure([&] { result = motion.isMoving(); });
+        benchmark::DoNotOptimize(result);
+    }
+
+    exit = true;
+    sensor.join();
+}
+BENCHMARK(MotionBench_isMoving)->ArgName("Moving")->Arg(false)->Arg(true);
+
+static constexpr calibration::Coeffs CALIBRATION_COEFFS = {-0.04f, 0.22f, 0.22f, 0.0f};
+static constexpr std::array<float, 5> CALIBRATION_TARGET_G = {0.275, 0.55, 0.6, 0.9, 1.12};
+static constexpr uint32_t CALIBRATION_LRA_PERIOD = 262;
+
+static void CalibrationBench_scalar(benchmark::State &state) {
+    std::array<uint32_t, 5> odClamps;
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < odClamps.size(); i++) {
+            float vLevel =
+                    calibration::targetGToVLevelsCubic(CALIBRATION_COEFFS, CALIBRATION_TARGET_G[i]);
+            odClamps[i] = calibration::convertLevelsToOdClamp(vLevel, CALIBRATION_LRA_PERIOD);
+        }
+        benchmark::DoNotOptimize(odClamps);
+    }
+}
+BENCHMARK(CalibrationBench_scalar);
+
+static void CalibrationBench_batch(benchmark::State &state) {
+    std::array<float, 5> vLevels;
+    std::array<uint32_t, 5> odClamps;
+
+    for (auto _ : state) {
+        calibration::targetGToVLevelsCubic(CALIBRATION_COEFFS, CALIBRATION_TARGET_G.data(),
+                                           vLevels.data(), vLevels.size());
+        calibration::convertLevelsToOdClamp(vLevels.data(), CALIBRATION_LRA_PERIOD,
+                                            odClamps.data(), odClamps.size());
+        benchmark::DoNotOptimize(odClamps);
+    }
+}
+BENCHMARK(CalibrationBench_batch);
+
+// Loading of the persisted calibration, from the text file or its binary copy.
+static void CalibrationBench_load(benchmark::State &state) {
+    const bool cached = state.range(0);
+    TemporaryFile calFile;
+    TemporaryDir cacheDir;
+    const std::string cachePath = cached ? std::string(cacheDir.path) + "/cal.snapshot" : "";
+
+    std::ofstream{calFile.path} << CALIBRATION_DATA;
+    CalibrationSnapshot::load(calFile.path, cachePath);
+
+    for (auto _ : state) {
+        auto snapshot = CalibrationSnapshot::load(calFile.path, cachePath);
+        benchmark::DoNotOptimize(snapshot);
+    }
+}
+BENCHMARK(CalibrationBench_load)->ArgName("Cached")->Arg(false)->Arg(true);
+
+// Cost of tracing one command with a typical number of hardware writes.
+static void CommandTraceBench_record(benchmark::State &state) {
+    CommandTrace trace;
+
+    for (auto _ : state) {
+        CommandTrace::Record record(&trace, CommandTrace::Api::ON, 100);
+        record.setTemperature(25000);
+        record.setOdClamp(90);
+        for (int64_t i = 0; i < state.range(0); i++) {
+            record.addWrite(CommandTrace::Node::ACTIVATE, std::chrono::microseconds(1));
+        }
+    }
+}
+BENCHMARK(CommandTraceBench_record)->ArgName("Writes")->Arg(0)->Arg(7)->ThreadRange(1, 4);
+
 }  // namespace vibrator
 }  // namespace hardware
 }  // namespace android
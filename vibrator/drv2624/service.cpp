@@ -20,25 +20,42 @@
 #include <android/binder_process.h>
 #include <log/log.h>
 
-using aidl::android::hardware::vibrator::HwApi;
+using aidl::android::hardware::vibrator::HwApiFd;
 using aidl::android::hardware::vibrator::HwCal;
+using aidl::android::hardware::vibrator::StartupProfile;
 using aidl::android::hardware::vibrator::Vibrator;
 
 int main() {
-    auto hwapi = HwApi::Create();
+    StartupProfile &profile = StartupProfile::get();
+    std::unique_ptr<HwApiFd> hwapi;
+    uint32_t nodeCount;
+    uint64_t nodeBytes;
+
+    // Created first, so that the calibration is loaded while the nodes are opened.
+    auto hwcal = std::make_unique<HwCal>();
+    {
+        StartupProfile::Scope scope(&profile, StartupProfile::Phase::OPEN_NODES);
+        hwapi = HwApiFd::Create();
+    }
 
     if (!hwapi) {
         return EXIT_FAILURE;
     }
+    hwapi->getNodeUsage(&nodeCount, &nodeBytes);
+    profile.setNodes(nodeCount, nodeBytes);
 
-    // One thread for vibrator APIs and one for sensor callback
-    // WARN: there could be an issue if two vibrator APIs are called simultaneously
+    // One binder thread for vibrator APIs; the sensor has a looper thread of
+    // its own. Simultaneous vibrator API calls are serialized by the HAL itself
     ABinderProcess_setThreadPoolMaxThreadCount(1);
     std::shared_ptr<Vibrator> vib =
-        ndk::SharedRefBase::make<Vibrator>(std::move(hwapi), std::make_unique<HwCal>());
+        ndk::SharedRefBase::make<Vibrator>(std::move(hwapi), std::move(hwcal));
 
     const std::string instance = std::string() + Vibrator::descriptor + "/default";
-    binder_status_t status = AServiceManager_addService(vib->asBinder().get(), instance.c_str());
+    binder_status_t status;
+    {
+        StartupProfile::Scope scope(&profile, StartupProfile::Phase::REGISTER_SERVICE);
+        status = AServiceManager_addService(vib->asBinder().get(), instance.c_str());
+    }
     LOG_ALWAYS_FATAL_IF(status != STATUS_OK);
 
     ABinderProcess_joinThreadPool();
@@ -16,6 +16,8 @@
 #ifndef ANDROID_HARDWARE_VIBRATOR_TEST_MOCKS_H
 #define ANDROID_HARDWARE_VIBRATOR_TEST_MOCKS_H
 
+#include <aidl/android/hardware/vibrator/BnVibratorCallback.h>
+
 #include "Vibrator.h"
 
 class MockApi : public ::aidl::android::hardware::vibrator::Vibrator::HwApi {
@@ -36,6 +38,7 @@ class MockApi : public ::aidl::android::hardware::vibrator::Vibrator::HwApi {
     MOCK_METHOD1(setLraWaveShape, bool(uint32_t value));
     MOCK_METHOD1(setOdClamp, bool(uint32_t value));
     MOCK_METHOD1(getPATemp, bool(int32_t *value));
+    MOCK_METHOD1(getLraPeriod, bool(uint32_t *value));
     MOCK_METHOD1(debug, void(int fd));
 
     ~MockApi() override { destructor(); };
@@ -47,8 +50,10 @@ class MockCal : public ::aidl::android::hardware::vibrator::Vibrator::HwCal {
     MOCK_METHOD1(getAutocal, bool(std::string &value));  // NOLINT
     MOCK_METHOD1(getLraPeriod, bool(uint32_t *value));
     MOCK_METHOD1(getEffectCoeffs, bool(std::array<float, 4> *value));
+    MOCK_METHOD1(getEffectTargetG, bool(std::array<float, 5> *value));
     MOCK_METHOD1(getSteadyAmpMax, bool(float *value));
     MOCK_METHOD1(getSteadyCoeffs, bool(std::array<float, 4> *value));
+    MOCK_METHOD1(getSteadyTargetG, bool(std::array<float, 3> *value));
     MOCK_METHOD1(getCloseLoopThreshold, bool(uint32_t *value));
     MOCK_METHOD1(getDynamicConfig, bool(bool *value));
     MOCK_METHOD1(getLongFrequencyShift, bool(uint32_t *value));
@@ -61,7 +66,13 @@ class MockCal : public ::aidl::android::hardware::vibrator::Vibrator::HwCal {
     MOCK_METHOD1(getEffectShape, bool(uint32_t *value));
     MOCK_METHOD1(getSteadyShape, bool(uint32_t *value));
     MOCK_METHOD1(getTriggerEffectSupport, bool(uint32_t *value));
-    MOCK_METHOD1(getDevHwVer, bool(std::string &value));
+    MOCK_METHOD1(getDevHwVer, bool(std::string *value));
+    MOCK_METHOD1(getTemperatureMaxAge, bool(uint32_t *value));
+    MOCK_METHOD1(getQFactor, bool(float *value));
+    MOCK_METHOD1(getResonanceInterval, bool(uint32_t *value));
+    MOCK_METHOD1(getAlwaysOnState, bool(std::string *value));
+    MOCK_METHOD1(setAlwaysOnState, bool(const std::string &value));
+    MOCK_METHOD1(watch, void(std::function<void()> onChange));
     MOCK_METHOD1(debug, void(int fd));
 
     ~MockCal() override { destructor(); };
@@ -69,4 +80,9 @@ class MockCal : public ::aidl::android::hardware::vibrator::Vibrator::HwCal {
     bool getAutocal(std::string *value) { return getAutocal(*value); }
 };
 
+class MockVibratorCallback : public ::aidl::android::hardware::vibrator::BnVibratorCallback {
+  public:
+    MOCK_METHOD(ndk::ScopedAStatus, onComplete, ());
+};
+
 #endif  // ANDROID_HARDWARE_VIBRATOR_TEST_MOCKS_H
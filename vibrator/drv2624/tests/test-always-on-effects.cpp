@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "AlwaysOnEffects.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using ::testing::Test;
+
+class AlwaysOnEffectsTest : public Test {
+  protected:
+    AlwaysOnEffects create() {
+        return AlwaysOnEffects(
+                [this](uint32_t waveform) {
+                    mPrograms.push_back(waveform);
+                    return mProgrammable;
+                },
+                [this](const std::string &state) {
+                    if (!mStorable) {
+                        return false;
+                    }
+                    mState = state;
+                    return true;
+                });
+    }
+
+    std::vector<uint32_t> mPrograms;
+    bool mProgrammable{true};
+    bool mStorable{true};
+    std::string mState;
+};
+
+TEST_F(AlwaysOnEffectsTest, restore_emptyProgramsDefault) {
+    auto alwaysOn = create();
+
+    EXPECT_TRUE(alwaysOn.restore("", 1));
+
+    EXPECT_EQ(std::vector<uint32_t>{1}, mPrograms);
+    EXPECT_EQ(1u, alwaysOn.waveform());
+    EXPECT_TRUE(mState.empty());
+}
+
+TEST_F(AlwaysOnEffectsTest, restore_resumesStoredTable) {
+    auto alwaysOn = create();
+
+    EXPECT_TRUE(alwaysOn.restore("3:2 7:4", 1));
+    EXPECT_EQ(4u, alwaysOn.waveform());
+
+    EXPECT_TRUE(alwaysOn.disable(7));
+    EXPECT_EQ(2u, alwaysOn.waveform());
+    EXPECT_EQ("3:2", mState);
+}
+
+TEST_F(AlwaysOnEffectsTest, restore_disabledStaysDisabled) {
+    auto alwaysOn = create();
+
+    EXPECT_TRUE(alwaysOn.restore("none", 1));
+
+    EXPECT_EQ(std::vector<uint32_t>{AlwaysOnEffects::WAVEFORM_NONE}, mPrograms);
+}
+
+TEST_F(AlwaysOnEffectsTest, restore_malformedProgramsDefault) {
+    auto alwaysOn = create();
+
+    EXPECT_TRUE(alwaysOn.restore("3:2 x", 1));
+
+    EXPECT_EQ(1u, alwaysOn.waveform());
+    EXPECT_TRUE(alwaysOn.enable(5, 3));
+    EXPECT_EQ("5:3", mState);
+}
+
+TEST_F(AlwaysOnEffectsTest, enable_mostRecentOwnsTrigger) {
+    auto alwaysOn = create();
+
+    EXPECT_TRUE(alwaysOn.restore("", AlwaysOnEffects::WAVEFORM_NONE));
+    EXPECT_TRUE(alwaysOn.enable(1, 2));
+    EXPECT_TRUE(alwaysOn.enable(2, 3));
+    EXPECT_TRUE(alwaysOn.enable(1, 4));
+    EXPECT_EQ("2:3 1:4", mState);
+    EXPECT_EQ(4u, alwaysOn.waveform());
+
+    EXPECT_TRUE(alwaysOn.disable(1));
+    EXPECT_TRUE(alwaysOn.disable(2));
+    EXPECT_TRUE(alwaysOn.disable(9));
+    EXPECT_EQ("none", mState);
+
+    EXPECT_EQ((std::vector<uint32_t>{0, 2, 3, 4, 3, 0}), mPrograms);
+}
+
+TEST_F(AlwaysOnEffectsTest, enable_failureKeepsTable) {
+    auto alwaysOn = create();
+
+    EXPECT_TRUE(alwaysOn.restore("1:2", 1));
+    mProgrammable = false;
+
+    EXPECT_FALSE(alwaysOn.enable(2, 3));
+    EXPECT_EQ(2u, alwaysOn.waveform());
+    EXPECT_EQ("1:2", mState);
+
+    mProgrammable = true;
+    EXPECT_TRUE(alwaysOn.disable(2));
+    EXPECT_EQ(2u, alwaysOn.waveform());
+}
+
+TEST_F(AlwaysOnEffectsTest, enable_storeFailureKeepsTrigger) {
+    auto alwaysOn = create();
+
+    EXPECT_TRUE(alwaysOn.restore("1:2", 1));
+    mStorable = false;
+
+    EXPECT_FALSE(alwaysOn.enable(2, 3));
+    EXPECT_EQ(2u, alwaysOn.waveform());
+    EXPECT_EQ("1:2", mState);
+    EXPECT_EQ((std::vector<uint32_t>{2, 3, 2}), mPrograms);
+
+    mStorable = true;
+    EXPECT_TRUE(alwaysOn.disable(2));
+    EXPECT_EQ(2u, alwaysOn.waveform());
+}
+
+TEST_F(AlwaysOnEffectsTest, enable_full) {
+    auto alwaysOn = create();
+
+    EXPECT_TRUE(alwaysOn.restore("none", 1));
+    for (size_t i = 0; i < AlwaysOnEffects::IDS_MAX; i++) {
+        EXPECT_TRUE(alwaysOn.enable(i, 1));
+    }
+
+    EXPECT_FALSE(alwaysOn.enable(AlwaysOnEffects::IDS_MAX, 2));
+    EXPECT_TRUE(alwaysOn.enable(0, 2));
+    EXPECT_EQ(2u, alwaysOn.waveform());
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+
+#include <fstream>
+
+#include "CalibrationSnapshot.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using ::testing::Test;
+
+using Field = CalibrationSnapshot::Field;
+using Source = CalibrationSnapshot::Source;
+
+static constexpr char CALIBRATION_DATA[] =
+        "autocal: 12 130 35\n"
+        "lra_period: 262\n"
+        "haptic_coefficient: -0.04 0.22 0.22 0.0\n"
+        "vibration_target_G: 0.6 0.9 1.2\n"
+        "q_factor: 12.5\n";
+
+class CalibrationSnapshotTest : public Test {
+  protected:
+    void write(const std::string &text) { std::ofstream{mCalFile.path} << text; }
+
+    // Moves the modification time, as a rewrite within the same tick would not.
+    void touch(time_t offset) {
+        struct stat st;
+        ASSERT_EQ(0, stat(mCalFile.path, &st));
+        struct timespec times[2] = {st.st_atim, st.st_mtim};
+        times[1].tv_sec += offset;
+        ASSERT_EQ(0, utimensat(AT_FDCWD, mCalFile.path, times, 0));
+    }
+
+    CalibrationSnapshot load() { return CalibrationSnapshot::load(mCalFile.path, mCachePath); }
+
+    TemporaryFile mCalFile;
+    TemporaryDir mCacheDir;
+    const std::string mCachePath = std::string(mCacheDir.path) + "/cal.snapshot";
+};
+
+TEST_F(CalibrationSnapshotTest, parse_fields) {
+    auto data = CalibrationSnapshot::parse(CALIBRATION_DATA);
+
+    EXPECT_EQ(Field::AUTOCAL | Field::LRA_PERIOD | Field::EFFECT_COEFFS | Field::STEADY_TARGET_G |
+                      Field::Q_FACTOR,
+              data.fields);
+    EXPECT_STREQ("12 130 35", data.autocal);
+    EXPECT_EQ(262u, data.lraPeriod);
+    EXPECT_FLOAT_EQ(-0.04f, data.effectCoeffs[0]);
+    EXPECT_FLOAT_EQ(0.0f, data.effectCoeffs[3]);
+    EXPECT_FLOAT_EQ(1.2f, data.steadyTargetG[2]);
+    EXPECT_FLOAT_EQ(12.5f, data.qFactor);
+}
+
+TEST_F(CalibrationSnapshotTest, parse_rejectsMalformed) {
+    auto data = CalibrationSnapshot::parse(
+            "lra_period: 262x\n"
+            "haptic_coefficient: 1 2 3\n"
+            "vibration_coefficient: 1 2 3 4 5\n"
+            "vibration_target_G:\n"
+            "0.6 0.9 1.2\n"
+            "q_factor: 12.5\n");
+
+    EXPECT_EQ(Field::Q_FACTOR, data.fields);
+}
+
+TEST_F(CalibrationSnapshotTest, load_missing) {
+    auto snapshot = CalibrationSnapshot::load("/nonexistent", mCachePath);
+
+    EXPECT_EQ(Source::MISSING, snapshot.source());
+    EXPECT_FALSE(snapshot.has(Field::LRA_PERIOD));
+}
+
+TEST_F(CalibrationSnapshotTest, load_usesCacheOnceWritten) {
+    write(CALIBRATION_DATA);
+
+    auto first = load();
+    auto second = load();
+
+    EXPECT_EQ(Source::TEXT, first.source());
+    EXPECT_EQ(Source::CACHE, second.source());
+    EXPECT_EQ(0, memcmp(&first.data(), &second.data(), sizeof(first.data())));
+}
+
+TEST_F(CalibrationSnapshotTest, load_reparsesModifiedFile) {
+    write(CALIBRATION_DATA);
+    load();
+
+    write("lra_period: 270\n");
+    touch(1);
+    auto snapshot = load();
+
+    EXPECT_EQ(Source::TEXT, snapshot.source());
+    EXPECT_EQ(270u, snapshot.data().lraPeriod);
+    EXPECT_FALSE(snapshot.has(Field::AUTOCAL));
+}
+
+TEST_F(CalibrationSnapshotTest, load_ignoresCorruptCache) {
+    write(CALIBRATION_DATA);
+    load();
+
+    std::fstream cache{mCachePath, std::ios::in | std::ios::out | std::ios::binary};
+    cache.seekp(-1, std::ios::end);
+    cache.put('\x7f');
+    cache.close();
+    auto snapshot = load();
+
+    EXPECT_EQ(Source::TEXT, snapshot.source());
+    EXPECT_STREQ("12 130 35", snapshot.data().autocal);
+}
+
+TEST_F(CalibrationSnapshotTest, load_withoutCache) {
+    write(CALIBRATION_DATA);
+
+    CalibrationSnapshot::load(mCalFile.path, "");
+    auto snapshot = CalibrationSnapshot::load(mCalFile.path, "");
+
+    EXPECT_EQ(Source::TEXT, snapshot.source());
+    EXPECT_EQ(262u, snapshot.data().lraPeriod);
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <array>
+
+#include "Calibration.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+namespace calibration {
+
+using ::testing::Test;
+
+static constexpr Coeffs EFFECT_COEFFS = {-0.04f, 0.22f, 0.22f, 0.0f};
+static constexpr Coeffs STEADY_COEFFS = {0.02f, 0.1f, 0.3f, 0.0f};
+static constexpr std::array<float, 5> EFFECT_TARGET_G = {0.275, 0.55, 0.6, 0.9, 1.12};
+static constexpr std::array<float, 3> STEADY_TARGET_G = {2.15, 1.145, 1.3};
+static constexpr uint32_t LRA_PERIOD = 262;
+
+// Double precision bisection over a curve increasing within (0, MAX_VOLTAGE].
+static double referenceSolve(const Coeffs &c, double targetG) {
+    double lo = 0.0, hi = MAX_VOLTAGE;
+    for (int i = 0; i < 100; i++) {
+        double mid = (lo + hi) / 2.0;
+        double g = ((c[0] * mid + c[1]) * mid + c[2]) * mid + c[3];
+        (g < targetG ? lo : hi) = mid;
+    }
+    return (lo + hi) / 2.0;
+}
+
+static float evalCubic(const Coeffs &c, float x) {
+    return ((c[0] * x + c[1]) * x + c[2]) * x + c[3];
+}
+
+class CalibrationTest : public Test {};
+
+TEST_F(CalibrationTest, freqPeriodFormula) {
+    EXPECT_EQ(155, freqPeriodFormula(LRA_PERIOD));
+    EXPECT_EQ(LRA_PERIOD, freqPeriodFormula(freqPeriodFormula(LRA_PERIOD)));
+}
+
+TEST_F(CalibrationTest, linear) {
+    Coeffs coeffs = {0.5f, 0.1f, 0.0f, 0.0f};
+
+    EXPECT_FLOAT_EQ(1.0f, targetGToVLevelsLinear(coeffs, 0.6f));
+    EXPECT_EQ(0.0f, targetGToVLevelsLinear(coeffs, 0.05f));
+    EXPECT_EQ(0.0f, targetGToVLevelsLinear(coeffs, 2.0f));
+}
+
+TEST_F(CalibrationTest, linear_batchMatchesScalar) {
+    Coeffs coeffs = {0.5f, 0.1f, 0.0f, 0.0f};
+    std::array<float, 5> vLevels;
+
+    targetGToVLevelsLinear(coeffs, EFFECT_TARGET_G.data(), vLevels.data(), vLevels.size());
+
+    for (size_t i = 0; i < vLevels.size(); i++) {
+        EXPECT_EQ(targetGToVLevelsLinear(coeffs, EFFECT_TARGET_G[i]), vLevels[i]);
+    }
+}
+
+TEST_F(CalibrationTest, cubic_matchesReference) {
+    for (auto &targetG : EFFECT_TARGET_G) {
+        EXPECT_NEAR(referenceSolve(EFFECT_COEFFS, targetG),
+                    targetGToVLevelsCubic(EFFECT_COEFFS, targetG), 1e-4);
+    }
+    for (auto &targetG : STEADY_TARGET_G) {
+        EXPECT_NEAR(referenceSolve(STEADY_COEFFS, targetG),
+                    targetGToVLevelsCubic(STEADY_COEFFS, targetG), 1e-4);
+    }
+}
+
+TEST_F(CalibrationTest, cubic_batchMatchesScalar) {
+    std::array<float, 5> vLevels;
+
+    targetGToVLevelsCubic(EFFECT_COEFFS, EFFECT_TARGET_G.data(), vLevels.data(), vLevels.size());
+
+    for (size_t i = 0; i < vLevels.size(); i++) {
+        EXPECT_EQ(targetGToVLevelsCubic(EFFECT_COEFFS, EFFECT_TARGET_G[i]), vLevels[i]);
+    }
+}
+
+TEST_F(CalibrationTest, cubic_tripleRoot) {
+    // f(x) = (x - 1)^3
+    Coeffs coeffs = {1.0f, -3.0f, 3.0f, -1.0f};
+    std::array<float, 2> targetG = {0.0f, 1.0f};
+    std::array<float, 2> vLevels;
+
+    EXPECT_FLOAT_EQ(1.0f, targetGToVLevelsCubic(coeffs, 0.0f));
+
+    targetGToVLevelsCubic(coeffs, targetG.data(), vLevels.data(), vLevels.size());
+
+    EXPECT_FLOAT_EQ(1.0f, vLevels[0]);
+    EXPECT_NEAR(2.0f, vLevels[1], 1e-4);
+}
+
+TEST_F(CalibrationTest, cubic_doubleRoot) {
+    // f(x) = (x - 1)^2 * (x - 3)
+    Coeffs coeffs = {1.0f, -5.0f, 7.0f, -3.0f};
+    float vLevel = targetGToVLevelsCubic(coeffs, 0.0f);
+
+    EXPECT_GT(vLevel, 0.0f);
+    EXPECT_LE(vLevel, MAX_VOLTAGE);
+    EXPECT_NEAR(0.0f, evalCubic(coeffs, vLevel), 1e-4);
+}
+
+TEST_F(CalibrationTest, cubic_outOfRange) {
+    std::array<float, 2> targetG = {-1.0f, 10.0f};
+    std::array<float, 2> vLevels;
+
+    targetGToVLevelsCubic(EFFECT_COEFFS, targetG.data(), vLevels.data(), vLevels.size());
+
+    for (size_t i = 0; i < vLevels.size(); i++) {
+        EXPECT_EQ(targetGToVLevelsCubic(EFFECT_COEFFS, targetG[i]), vLevels[i]);
+    }
+}
+
+TEST_F(CalibrationTest, vLevelsToTargetGCubic) {
+    for (auto &targetG : STEADY_TARGET_G) {
+        float vLevel = targetGToVLevelsCubic(STEADY_COEFFS, targetG);
+        EXPECT_NEAR(targetG, vLevelsToTargetGCubic(STEADY_COEFFS, vLevel / MAX_VOLTAGE), 1e-4);
+    }
+}
+
+TEST_F(CalibrationTest, convertLevelsToOdClamp) {
+    std::array<float, 4> vLevels = {0.0f, 1.0f, 2.0f, MAX_VOLTAGE};
+    std::array<uint32_t, 4> odClamps;
+
+    EXPECT_EQ(50, convertLevelsToOdClamp(1.0f, LRA_PERIOD));
+
+    convertLevelsToOdClamp(vLevels.data(), LRA_PERIOD, odClamps.data(), odClamps.size());
+
+    for (size_t i = 0; i < odClamps.size(); i++) {
+        EXPECT_EQ(convertLevelsToOdClamp(vLevels[i], LRA_PERIOD), odClamps[i]);
+    }
+}
+
+TEST_F(CalibrationTest, renderStrength) {
+    const float targetG = EFFECT_TARGET_G[2];
+    const float vLevel = targetGToVLevelsCubic(EFFECT_COEFFS, targetG);
+    uint8_t scale = 2;
+    uint32_t odClamp = 0;
+
+    // Half scale needs twice the voltage of the target.
+    ASSERT_TRUE(renderStrength(EFFECT_COEFFS, targetG, LRA_PERIOD, 255, &scale, &odClamp));
+    EXPECT_EQ(2, scale);
+    EXPECT_EQ(convertLevelsToOdClamp(vLevel * 2.0f, LRA_PERIOD), odClamp);
+
+    // Steps up the scale when od_clamp would exceed the limit.
+    const uint32_t threeQuarterScale = convertLevelsToOdClamp(vLevel / 0.75f, LRA_PERIOD);
+    scale = 2;
+    ASSERT_TRUE(renderStrength(EFFECT_COEFFS, targetG, LRA_PERIOD, threeQuarterScale, &scale,
+                               &odClamp));
+    EXPECT_EQ(1, scale);
+    EXPECT_EQ(threeQuarterScale, odClamp);
+
+    // Out of reach, even at full scale.
+    const uint32_t fullScale = convertLevelsToOdClamp(vLevel, LRA_PERIOD);
+    scale = 2;
+    odClamp = 0;
+    EXPECT_FALSE(renderStrength(EFFECT_COEFFS, targetG, LRA_PERIOD, fullScale - 1, &scale,
+                                &odClamp));
+    EXPECT_EQ(2, scale);
+    EXPECT_EQ(0u, odClamp);
+}
+
+}  // namespace calibration
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
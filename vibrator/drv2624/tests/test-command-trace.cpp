@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "CommandTrace.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using ::testing::Test;
+
+using namespace std::chrono_literals;
+
+using Api = CommandTrace::Api;
+using Node = CommandTrace::Node;
+using Record = CommandTrace::Record;
+
+struct Status {
+    int32_t getExceptionCode() const { return code; }
+    int32_t code;
+};
+
+class CommandTraceTest : public Test {
+  protected:
+    CommandTrace mTrace;
+};
+
+TEST_F(CommandTraceTest, record_entry) {
+    {
+        Record record(&mTrace, Api::PERFORM, 1, 2);
+        EXPECT_EQ(&record, Record::current());
+        record.setTemperature(25000);
+        record.setLoopMode(true);
+        record.setOdClamp(90);
+        record.addWrite(Node::SEQUENCER, 3us);
+        record.addWrite(Node::ACTIVATE, 5us);
+        EXPECT_EQ(-4, record.finish(Status{-4}).code);
+    }
+    EXPECT_EQ(nullptr, Record::current());
+
+    auto entries = mTrace.entries();
+    ASSERT_EQ(1u, entries.size());
+    const auto &entry = entries[0];
+    EXPECT_EQ(Api::PERFORM, entry.api);
+    EXPECT_EQ(1, entry.arg);
+    EXPECT_EQ(2, entry.strength);
+    EXPECT_EQ(-4, entry.status);
+    EXPECT_TRUE(entry.hasTemperature);
+    EXPECT_EQ(25000, entry.temperature);
+    EXPECT_EQ(1, entry.loopMode);
+    EXPECT_TRUE(entry.hasOdClamp);
+    EXPECT_EQ(90u, entry.odClamp);
+    ASSERT_EQ(2u, entry.writeCount);
+    EXPECT_EQ(Node::SEQUENCER, entry.writes[0].node);
+    EXPECT_EQ(3000u, entry.writes[0].elapsedNs);
+    EXPECT_EQ(Node::ACTIVATE, entry.writes[1].node);
+}
+
+TEST_F(CommandTraceTest, record_nested) {
+    {
+        Record outer(&mTrace, Api::COMPOSE);
+        {
+            Record inner(&mTrace, Api::COMPOSITION_STEP);
+            EXPECT_EQ(&inner, Record::current());
+        }
+        EXPECT_EQ(&outer, Record::current());
+    }
+
+    auto entries = mTrace.entries();
+    ASSERT_EQ(2u, entries.size());
+    EXPECT_EQ(Api::COMPOSITION_STEP, entries[0].api);
+    EXPECT_EQ(Api::COMPOSE, entries[1].api);
+}
+
+TEST_F(CommandTraceTest, record_writesBeyondMax) {
+    {
+        Record record(&mTrace, Api::PERFORM);
+        for (size_t i = 0; i < CommandTrace::WRITES_MAX + 2; i++) {
+            record.addWrite(Node::SCALE, 1us);
+        }
+    }
+
+    EXPECT_EQ(CommandTrace::WRITES_MAX + 2, mTrace.entries()[0].writeCount);
+}
+
+TEST_F(CommandTraceTest, ring_keepsMostRecent) {
+    for (int32_t i = 0; i < static_cast<int32_t>(CommandTrace::CAPACITY) + 10; i++) {
+        Record record(&mTrace, Api::ON, i);
+    }
+
+    auto entries = mTrace.entries();
+    ASSERT_EQ(CommandTrace::CAPACITY, entries.size());
+    EXPECT_EQ(10, entries.front().arg);
+    EXPECT_EQ(static_cast<int32_t>(CommandTrace::CAPACITY) + 9, entries.back().arg);
+}
+
+TEST_F(CommandTraceTest, histogram_buckets) {
+    {
+        Record record(&mTrace, Api::OFF);
+    }
+    {
+        Record record(&mTrace, Api::OFF);
+        std::this_thread::sleep_for(3ms);
+    }
+
+    auto histogram = mTrace.histogram(Api::OFF);
+    EXPECT_EQ(2u, histogram.count);
+    EXPECT_GE(histogram.maxUs, 3000u);
+    // 3ms falls in [2048us, 4096us).
+    EXPECT_EQ(1u, histogram.buckets[12]);
+    EXPECT_EQ(0u, mTrace.histogram(Api::ON).count);
+}
+
+TEST_F(CommandTraceTest, concurrent_readsAreConsistent) {
+    std::atomic<bool> done{false};
+    std::vector<std::thread> writers;
+
+    for (int32_t t = 0; t < 4; t++) {
+        writers.emplace_back([&, t]() {
+            for (int32_t i = 0; i < 2000; i++) {
+                Record record(&mTrace, Api::ON, t);
+                record.setOdClamp(t);
+                record.setTemperature(t);
+            }
+        });
+    }
+    std::thread reader([&]() {
+        while (!done) {
+            for (const auto &entry : mTrace.entries()) {
+                EXPECT_EQ(static_cast<uint32_t>(entry.arg), entry.odClamp);
+                EXPECT_EQ(entry.arg, entry.temperature);
+            }
+        }
+    });
+
+    for (auto &writer : writers) {
+        writer.join();
+    }
+    done = true;
+    reader.join();
+
+    EXPECT_EQ(8000u, mTrace.histogram(Api::ON).count);
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
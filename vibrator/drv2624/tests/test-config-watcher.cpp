@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+
+#include "ConfigWatcher.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using ::testing::Test;
+
+using namespace std::chrono_literals;
+
+class ConfigWatcherTest : public Test {
+  protected:
+    std::unique_ptr<ConfigWatcher> createWatcher(std::chrono::milliseconds interval) {
+        return std::make_unique<ConfigWatcher>(
+                mPath,
+                [this]() {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    return mSample;
+                },
+                interval,
+                [this]() {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    mChanges++;
+                    mCondition.notify_all();
+                });
+    }
+
+    void setSample(const std::string &sample) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mSample = sample;
+    }
+
+    bool waitForChanges(uint32_t count, std::chrono::milliseconds timeout = 2s) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        return mCondition.wait_for(lock, timeout, [&]() { return mChanges >= count; });
+    }
+
+    uint32_t changes() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mChanges;
+    }
+
+    TemporaryDir mDir;
+    const std::string mPath = std::string(mDir.path) + "/drv2624.cal";
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::string mSample;
+    uint32_t mChanges{0};
+};
+
+TEST_F(ConfigWatcherTest, fileWrite_reportsOnce) {
+    auto watcher = createWatcher(0ms);
+
+    {
+        std::ofstream file{mPath};
+        file << "lra_period: 262\n";
+    }
+    std::ofstream{mPath, std::ios_base::app} << "q_factor: 12.5\n";
+
+    EXPECT_TRUE(waitForChanges(1));
+    std::this_thread::sleep_for(ConfigWatcher::SETTLE_TIME * 2);
+    EXPECT_EQ(1u, changes());
+}
+
+TEST_F(ConfigWatcherTest, fileRename_reports) {
+    const std::string temp = mPath + ".tmp";
+    auto watcher = createWatcher(0ms);
+
+    std::ofstream{temp} << "lra_period: 262\n";
+    ASSERT_EQ(0, std::rename(temp.c_str(), mPath.c_str()));
+
+    EXPECT_TRUE(waitForChanges(1));
+}
+
+TEST_F(ConfigWatcherTest, otherFile_ignored) {
+    auto watcher = createWatcher(0ms);
+
+    std::ofstream{std::string(mDir.path) + "/other.cal"} << "lra_period: 262\n";
+
+    EXPECT_FALSE(waitForChanges(1, ConfigWatcher::SETTLE_TIME * 3));
+}
+
+TEST_F(ConfigWatcherTest, property_reportsChange) {
+    auto watcher = createWatcher(10ms);
+
+    std::this_thread::sleep_for(50ms);
+    EXPECT_EQ(0u, changes());
+
+    setSample("click.duration=8");
+
+    EXPECT_TRUE(waitForChanges(1));
+    std::this_thread::sleep_for(50ms);
+    EXPECT_EQ(1u, changes());
+}
+
+TEST_F(ConfigWatcherTest, disabled_noThread) {
+    ConfigWatcher watcher("", nullptr, 0ms, []() { FAIL(); });
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+
+#include "DriverSimulator.h"
+#include "Hardware.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using ::testing::Bool;
+using ::testing::Test;
+using ::testing::TestParamInfo;
+using ::testing::WithParamInterface;
+
+using namespace std::chrono_literals;
+
+using Node = DriverSimulator::Node;
+
+static constexpr uint32_t LRA_PERIOD = 262;
+
+static constexpr char CALIBRATION_DATA[] =
+        "autocal: 12 130 35\n"
+        "lra_period: 262\n"
+        "vibration_target_G: 0.6 0.9 1.2\n";
+
+// Runs on the FD backend when the parameter is set, on the stream one otherwise.
+class DriverSimulatorTest : public Test, public WithParamInterface<bool> {
+  protected:
+    void SetUp() override {
+        ASSERT_TRUE(DriverSimulator::createNodes(mFilesDir.path, LRA_PERIOD));
+        setenv("HWAPI_PATH_PREFIX", (std::string(mFilesDir.path) + "/").c_str(), true);
+    }
+
+    std::unique_ptr<Vibrator::HwApi> createHwApi(DriverSimulator *sim) {
+        if (GetParam()) {
+            return sim->wrap(HwApiFd::Create());
+        }
+        return sim->wrap(HwApi::Create());
+    }
+
+    static DriverSimulator::Timing timing(Node node, std::chrono::microseconds latency) {
+        DriverSimulator::Timing timing{};
+        timing[static_cast<size_t>(node)] = latency;
+        return timing;
+    }
+
+    TemporaryDir mFilesDir;
+};
+
+TEST_P(DriverSimulatorTest, activate_requiresState) {
+    DriverSimulator sim(DriverSimulator::Timing{});
+    auto hwapi = createHwApi(&sim);
+
+    ASSERT_NE(nullptr, hwapi);
+    EXPECT_TRUE(hwapi->setDuration(1000));
+    EXPECT_FALSE(hwapi->setActivate(true));
+    EXPECT_EQ(EINVAL, errno);
+    EXPECT_FALSE(sim.isPlaying());
+
+    EXPECT_TRUE(hwapi->setState(true));
+    EXPECT_TRUE(hwapi->setActivate(true));
+    EXPECT_TRUE(sim.isPlaying());
+
+    EXPECT_TRUE(hwapi->setState(false));
+    EXPECT_FALSE(sim.isPlaying());
+}
+
+TEST_P(DriverSimulatorTest, activate_endsAfterDuration) {
+    DriverSimulator sim(DriverSimulator::Timing{});
+    auto hwapi = createHwApi(&sim);
+
+    hwapi->setState(true);
+    hwapi->setDuration(20);
+    hwapi->setActivate(true);
+    EXPECT_TRUE(sim.isPlaying());
+
+    std::this_thread::sleep_for(40ms);
+    EXPECT_FALSE(sim.isPlaying());
+
+    hwapi->setDuration(1000);
+    hwapi->setActivate(true);
+    hwapi->setActivate(false);
+    EXPECT_FALSE(sim.isPlaying());
+}
+
+TEST_P(DriverSimulatorTest, trace_recordsCommands) {
+    DriverSimulator sim(DriverSimulator::Timing{});
+    auto hwapi = createHwApi(&sim);
+
+    hwapi->setDuration(100);
+    hwapi->setMode("rtp");
+    hwapi->setRtpInput(-12);
+    hwapi->setActivate(true);
+    auto trace = sim.trace();
+
+    ASSERT_EQ(4u, trace.size());
+    EXPECT_EQ(Node::DURATION, trace[0].node);
+    EXPECT_EQ("100", trace[0].value);
+    EXPECT_EQ(Node::MODE, trace[1].node);
+    EXPECT_EQ("rtp", trace[1].value);
+    EXPECT_EQ("-12", trace[2].value);
+    EXPECT_EQ(Node::ACTIVATE, trace[3].node);
+    EXPECT_FALSE(trace[3].accepted);
+    for (size_t i = 1; i < trace.size(); i++) {
+        EXPECT_LE(trace[i - 1].time + trace[i - 1].elapsed, trace[i].time);
+    }
+
+    sim.clearTrace();
+    EXPECT_TRUE(sim.trace().empty());
+}
+
+TEST_P(DriverSimulatorTest, timing_delaysWrite) {
+    DriverSimulator sim(timing(Node::SEQUENCER, 2ms));
+    auto hwapi = createHwApi(&sim);
+
+    auto begin = DriverSimulator::Clock::now();
+    hwapi->setSequencer("1 1");
+    hwapi->setScale(1);
+    auto trace = sim.trace();
+
+    EXPECT_GE(DriverSimulator::Clock::now() - begin, 2ms);
+    ASSERT_EQ(2u, trace.size());
+    EXPECT_GE(trace[0].elapsed, 2ms);
+    EXPECT_LT(trace[1].elapsed, 2ms);
+}
+
+// The FD backend skips a repeated value, so the driver only sees it once.
+TEST_P(DriverSimulatorTest, timing_onlyChargesWritesThatReachTheNode) {
+    DriverSimulator sim(timing(Node::SEQUENCER, 2ms));
+    auto hwapi = createHwApi(&sim);
+
+    auto begin = DriverSimulator::Clock::now();
+    EXPECT_TRUE(hwapi->setSequencer("1 1"));
+    EXPECT_TRUE(hwapi->setSequencer("1 1"));
+    auto elapsed = DriverSimulator::Clock::now() - begin;
+    auto trace = sim.trace();
+
+    if (GetParam()) {
+        ASSERT_EQ(1u, trace.size());
+        EXPECT_LT(elapsed, 4ms);
+    } else {
+        ASSERT_EQ(2u, trace.size());
+        EXPECT_GE(elapsed, 4ms);
+    }
+    EXPECT_EQ("1 1", trace.back().value);
+}
+
+// End to end, from the binder call to the completion of activate=1.
+TEST_P(DriverSimulatorTest, vibratorOn_activationLatency) {
+    TemporaryFile calFile;
+    std::ofstream{calFile.path} << CALIBRATION_DATA;
+    setenv("CALIBRATION_FILEPATH", calFile.path, true);
+
+    DriverSimulator sim;
+    auto vibrator = ndk::SharedRefBase::make<Vibrator>(createHwApi(&sim),
+                                                       std::make_unique<HwCal>());
+    sim.clearTrace();
+
+    auto begin = DriverSimulator::Clock::now();
+    EXPECT_TRUE(vibrator->on(100, nullptr).isOk());
+    auto latency = sim.lastActivation() - begin;
+    auto trace = sim.trace();
+
+    ASSERT_FALSE(trace.empty());
+    EXPECT_EQ(Node::ACTIVATE, trace.back().node);
+    EXPECT_TRUE(trace.back().accepted);
+    EXPECT_TRUE(sim.isPlaying());
+
+    std::chrono::nanoseconds modeled{0};
+    for (auto &command : trace) {
+        modeled += DriverSimulator::DEFAULT_TIMING[static_cast<size_t>(command.node)];
+    }
+    EXPECT_GE(latency, modeled);
+}
+
+INSTANTIATE_TEST_CASE_P(DriverSimulatorTests, DriverSimulatorTest, Bool(),
+                        [](const TestParamInfo<DriverSimulatorTest::ParamType> &info) {
+                            return info.param ? "FdBackend" : "StreamBackend";
+                        });
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
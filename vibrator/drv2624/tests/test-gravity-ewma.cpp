@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#include "GravityEwma.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using ::testing::Test;
+
+class GravityEwmaTest : public Test {
+  protected:
+    static constexpr int64_t TIME_CONSTANT_NS = 1000;
+    static constexpr int64_t GAP_NS = 500;
+
+    GravityEwma mGravity{TIME_CONSTANT_NS, GAP_NS};
+};
+
+TEST_F(GravityEwmaTest, empty) {
+    float x, y;
+
+    EXPECT_FALSE(mGravity.average(&x, &y, 0));
+    EXPECT_EQ(0u, mGravity.size());
+}
+
+TEST_F(GravityEwmaTest, firstSample) {
+    float x, y;
+
+    mGravity.push(1.0f, -2.0f, 100);
+
+    EXPECT_TRUE(mGravity.average(&x, &y, 100));
+    EXPECT_FLOAT_EQ(1.0f, x);
+    EXPECT_FLOAT_EQ(-2.0f, y);
+    EXPECT_EQ(1u, mGravity.size());
+}
+
+TEST_F(GravityEwmaTest, followsStep) {
+    float x, y;
+    int64_t now = 0;
+
+    mGravity.push(0.0f, 0.0f, now);
+    // One time constant, in samples of a tenth of it.
+    for (int i = 0; i < 10; i++) {
+        now += TIME_CONSTANT_NS / 10;
+        mGravity.push(10.0f, -10.0f, now);
+    }
+
+    EXPECT_TRUE(mGravity.average(&x, &y, now));
+    EXPECT_FLOAT_EQ(10.0f * (1.0f - std::exp(-1.0f)), x);
+    EXPECT_FLOAT_EQ(-10.0f * (1.0f - std::exp(-1.0f)), y);
+    EXPECT_EQ(11u, mGravity.size());
+}
+
+TEST_F(GravityEwmaTest, weighsByElapsedTime) {
+    GravityEwma even{TIME_CONSTANT_NS, GAP_NS};
+    float x, evenX, y;
+
+    // Two samples a fifth apart weigh as much as one sample after the same time.
+    mGravity.push(0.0f, 0.0f, 0);
+    mGravity.push(5.0f, 5.0f, TIME_CONSTANT_NS / 5);
+    even.push(0.0f, 0.0f, 0);
+    even.push(5.0f, 5.0f, TIME_CONSTANT_NS / 10);
+    even.push(5.0f, 5.0f, TIME_CONSTANT_NS / 5);
+
+    EXPECT_TRUE(mGravity.average(&x, &y, TIME_CONSTANT_NS / 5));
+    EXPECT_TRUE(even.average(&evenX, &y, TIME_CONSTANT_NS / 5));
+    EXPECT_FLOAT_EQ(evenX, x);
+}
+
+TEST_F(GravityEwmaTest, gap_restartsAverage) {
+    float x, y;
+
+    mGravity.push(1.0f, 1.0f, 0);
+    mGravity.push(1.0f, 1.0f, GAP_NS);
+    mGravity.push(5.0f, 6.0f, 2 * GAP_NS + 1);
+
+    EXPECT_TRUE(mGravity.average(&x, &y, 2 * GAP_NS + 1));
+    EXPECT_FLOAT_EQ(5.0f, x);
+    EXPECT_FLOAT_EQ(6.0f, y);
+    EXPECT_EQ(1u, mGravity.size());
+}
+
+TEST_F(GravityEwmaTest, gap_averageGoesStale) {
+    float x, y;
+
+    mGravity.push(1.0f, 1.0f, 0);
+
+    EXPECT_TRUE(mGravity.average(&x, &y, GAP_NS));
+    EXPECT_FALSE(mGravity.average(&x, &y, GAP_NS + 1));
+}
+
+TEST_F(GravityEwmaTest, reset) {
+    float x, y;
+
+    mGravity.push(1.0f, 1.0f, 0);
+    mGravity.reset();
+
+    EXPECT_FALSE(mGravity.average(&x, &y, 0));
+
+    mGravity.push(5.0f, 6.0f, 10);
+
+    EXPECT_TRUE(mGravity.average(&x, &y, 10));
+    EXPECT_FLOAT_EQ(5.0f, x);
+    EXPECT_FLOAT_EQ(6.0f, y);
+}
+
+TEST_F(GravityEwmaTest, concurrentReader) {
+    std::atomic<int64_t> now{0};
+    std::atomic<bool> done{false};
+    std::thread producer([this, &now, &done] {
+        for (int i = 0; i < 100000; i++) {
+            float value = i % 10;
+            mGravity.push(value, -value, ++now);
+        }
+        done = true;
+    });
+
+    // Every snapshot must be self-consistent, i.e. x and y from the same pushes.
+    while (!done) {
+        float x, y;
+        if (mGravity.average(&x, &y, now)) {
+            ASSERT_FLOAT_EQ(x, -y);
+        }
+    }
+
+    producer.join();
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -15,11 +15,14 @@
  */
 
 #include <android-base/file.h>
+#include <android-base/unique_fd.h>
 #include <cutils/fs.h>
 #include <gtest/gtest.h>
 
 #include <cstdlib>
+#include <filesystem>
 #include <fstream>
+#include <thread>
 
 #include "Hardware.h"
 
@@ -49,6 +52,7 @@ class HwApiTest : public Test {
         "device/lp_trigger_effect",
         "device/lra_wave_shape",
         "device/od_clamp",
+        "device/lra_period",
     };
 
     static constexpr const char *REQUIRED[]{
@@ -175,6 +179,32 @@ TEST_P(CreateTest, file_missing) {
     }
 }
 
+TEST_P(CreateTest, fd_file_missing) {
+    auto skip = std::string(GetParam());
+    TemporaryDir dir;
+    std::unique_ptr<HwApiFd> hwapi;
+    std::string prefix;
+
+    for (auto n : FILE_NAMES) {
+        auto name = std::string(n);
+        auto path = std::string(dir.path) + "/" + name;
+        if (name == skip) {
+            continue;
+        }
+        fs_mkdirs(path.c_str(), S_IRWXU);
+        std::ofstream touch{path};
+    }
+
+    prefix = std::filesystem::path(dir.path) / "";
+    setenv("HWAPI_PATH_PREFIX", prefix.c_str(), true);
+    hwapi = HwApiFd::Create();
+    if (isRequired(skip)) {
+        EXPECT_EQ(nullptr, hwapi);
+    } else {
+        EXPECT_NE(nullptr, hwapi);
+    }
+}
+
 INSTANTIATE_TEST_CASE_P(HwApiTests, CreateTest, ValuesIn(CreateTest::AllParams()),
                         CreateTest::PrintParam);
 
@@ -393,6 +423,113 @@ INSTANTIATE_TEST_CASE_P(
     }),
     SetStringTest::PrintParam);
 
+class HwApiFdTest : public HwApiTest {
+  public:
+    void SetUp() override {
+        std::string prefix;
+
+        HwApiTest::SetUp();
+
+        prefix = std::filesystem::path(mFilesDir.path) / "";
+        setenv("HWAPI_PATH_PREFIX", prefix.c_str(), true);
+        mHwApi = HwApiFd::Create();
+
+        prefix = std::filesystem::path(mEmptyDir.path) / "";
+        setenv("HWAPI_PATH_PREFIX", prefix.c_str(), true);
+        mNoApi = HwApiFd::Create();
+    }
+};
+
+TEST_F(HwApiFdTest, setOdClamp_writesValue) {
+    uint32_t value = std::rand();
+
+    expectContent("device/od_clamp", value);
+
+    EXPECT_TRUE(mHwApi->setOdClamp(value));
+}
+
+TEST_F(HwApiFdTest, setOdClamp_coalescesRepeatedValue) {
+    uint32_t value = std::rand();
+
+    expectContent("device/od_clamp", value);
+    expectContent("device/od_clamp", value + 1);
+
+    EXPECT_TRUE(mHwApi->setOdClamp(value));
+    EXPECT_TRUE(mHwApi->setOdClamp(value));
+    EXPECT_TRUE(mHwApi->setOdClamp(value + 1));
+}
+
+TEST_F(HwApiFdTest, setRtpInput_writesSignedValue) {
+    int8_t value = -1;
+
+    expectContent("device/rtp_input", +value);
+
+    EXPECT_TRUE(mHwApi->setRtpInput(value));
+}
+
+TEST_F(HwApiFdTest, setMode_coalescesRepeatedValue) {
+    expectContent("device/mode", "rtp");
+    expectContent("device/mode", "waveform");
+    expectContent("device/mode", "rtp");
+
+    EXPECT_TRUE(mHwApi->setMode("rtp"));
+    EXPECT_TRUE(mHwApi->setMode("rtp"));
+    EXPECT_TRUE(mHwApi->setMode("waveform"));
+    EXPECT_TRUE(mHwApi->setMode("rtp"));
+}
+
+TEST_F(HwApiFdTest, setActivate_neverCoalesced) {
+    expectContent("activate", "1");
+    expectContent("activate", "1");
+
+    EXPECT_TRUE(mHwApi->setActivate(true));
+    EXPECT_TRUE(mHwApi->setActivate(true));
+}
+
+TEST_F(HwApiFdTest, hasRtpInput) {
+    EXPECT_TRUE(mHwApi->hasRtpInput());
+    EXPECT_FALSE(mNoApi->hasRtpInput());
+}
+
+TEST_F(HwApiFdTest, getLraPeriod_readsValue) {
+    uint32_t expect = std::rand();
+    uint32_t actual;
+
+    expectAndUpdateContent("device/lra_period", expect);
+
+    EXPECT_TRUE(mHwApi->getLraPeriod(&actual));
+    EXPECT_EQ(expect, actual);
+}
+
+TEST_F(HwApiFdTest, debug_concurrentWithWrites) {
+    static constexpr uint32_t WRITES = 100;
+    ::android::base::unique_fd devNull(TEMP_FAILURE_RETRY(open("/dev/null", O_WRONLY | O_CLOEXEC)));
+
+    ASSERT_GE(devNull.get(), 0);
+
+    for (uint32_t i = 0; i < WRITES; i++) {
+        expectContent("device/od_clamp", i);
+    }
+
+    std::thread writer([this] {
+        for (uint32_t i = 0; i < WRITES; i++) {
+            EXPECT_TRUE(mHwApi->setOdClamp(i));
+        }
+    });
+    for (uint32_t i = 0; i < WRITES; i++) {
+        mHwApi->debug(devNull.get());
+    }
+    writer.join();
+}
+
+TEST_F(HwApiFdTest, failure) {
+    uint32_t value;
+
+    EXPECT_FALSE(mNoApi->setOdClamp(std::rand()));
+    EXPECT_FALSE(mNoApi->setMode("rtp"));
+    EXPECT_FALSE(mNoApi->getLraPeriod(&value));
+}
+
 }  // namespace vibrator
 }  // namespace hardware
 }  // namespace android
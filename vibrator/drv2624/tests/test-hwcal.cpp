@@ -19,6 +19,7 @@
 #include <gtest/gtest.h>
 
 #include <fstream>
+#include <future>
 
 #include "Hardware.h"
 
@@ -43,7 +44,7 @@ class HwCalTest : public Test {
 
     static constexpr uint32_t DEFAULT_CLICK_DURATION_MS = 6;
     static constexpr uint32_t DEFAULT_TICK_DURATION_MS = 2;
-    static constexpr uint32_t DEFAULT_DOUBLE_CLICK_DURATION_MS = 135;
+    static constexpr uint32_t DEFAULT_DOUBLE_CLICK_DURATION_MS = 159;
     static constexpr uint32_t DEFAULT_HEAVY_CLICK_DURATION_MS = 8;
 
   public:
@@ -103,6 +104,31 @@ TEST_F(HwCalTest, closeloop_missing) {
     EXPECT_EQ(expect, actual);
 }
 
+TEST_F(HwCalTest, closeloop_override) {
+    std::string prefix{PROPERTY_PREFIX};
+    std::string override{"test.vibrator.override."};
+    uint32_t base = std::rand();
+    uint32_t expect = ~base;
+    uint32_t actual = base;
+
+    setenv("OVERRIDE_PROPERTY_PREFIX", override.c_str(), true);
+    EXPECT_TRUE(SetProperty(prefix + "closeloop.threshold", std::to_string(base)));
+    EXPECT_TRUE(SetProperty(override + "closeloop.threshold", std::to_string(expect)));
+
+    createHwCal();
+
+    EXPECT_TRUE(mHwCal->getCloseLoopThreshold(&actual));
+    EXPECT_EQ(expect, actual);
+
+    // A malformed override falls back to the base property.
+    EXPECT_TRUE(SetProperty(override + "closeloop.threshold", "x"));
+    EXPECT_TRUE(mHwCal->getCloseLoopThreshold(&actual));
+    EXPECT_EQ(base, actual);
+
+    EXPECT_TRUE(SetProperty(override + "closeloop.threshold", std::string()));
+    unsetenv("OVERRIDE_PROPERTY_PREFIX");
+}
+
 TEST_F(HwCalTest, dynamicconfig_presentFalse) {
     std::string prefix{PROPERTY_PREFIX};
     bool expect = false;
@@ -388,6 +414,77 @@ TEST_F(HwCalTest, trimming) {
     EXPECT_EQ(lraPeriodExpect, lraPeriodActual);
 }
 
+TEST_F(HwCalTest, alwaysOnState_roundTrip) {
+    TemporaryDir dir;
+    std::string state = "unset";
+
+    setenv("ALWAYSON_FILEPATH", (std::string(dir.path) + "/alwayson").c_str(), true);
+    createHwCal();
+
+    // Never configured.
+    EXPECT_TRUE(mHwCal->getAlwaysOnState(&state));
+    EXPECT_EQ("", state);
+
+    EXPECT_TRUE(mHwCal->setAlwaysOnState("1:2 3:4"));
+    EXPECT_TRUE(mHwCal->setAlwaysOnState("3:4"));
+    EXPECT_TRUE(mHwCal->getAlwaysOnState(&state));
+    EXPECT_EQ("3:4", state);
+
+    unsetenv("ALWAYSON_FILEPATH");
+}
+
+TEST_F(HwCalTest, alwaysOnState_unwritable) {
+    TemporaryDir dir;
+
+    setenv("ALWAYSON_FILEPATH", (std::string(dir.path) + "/missing/alwayson").c_str(), true);
+    createHwCal();
+
+    EXPECT_FALSE(mHwCal->setAlwaysOnState("1:2"));
+
+    unsetenv("ALWAYSON_FILEPATH");
+}
+
+TEST_F(HwCalTest, watch_reloadsPersist) {
+    uint32_t expect = std::rand();
+    uint32_t actual = ~expect;
+    std::promise<void> changed;
+
+    write("lra_period", ~expect);
+
+    createHwCal();
+    mHwCal->watch([&]() { changed.set_value(); });
+
+    write("lra_period", expect);
+
+    ASSERT_EQ(std::future_status::ready,
+              changed.get_future().wait_for(std::chrono::seconds(2)));
+    mHwCal->watch(nullptr);
+    EXPECT_TRUE(mHwCal->getLraPeriod(&actual));
+    EXPECT_EQ(expect, actual);
+}
+
+TEST_F(HwCalTest, watch_reportsOverrideChange) {
+    std::string prefix{PROPERTY_PREFIX};
+    std::string override{"test.vibrator.override."};
+    std::promise<void> changed;
+
+    setenv("OVERRIDE_PROPERTY_PREFIX", override.c_str(), true);
+    EXPECT_TRUE(SetProperty(prefix + "reload.interval", "10"));
+
+    createHwCal();
+    mHwCal->watch([&]() { changed.set_value(); });
+
+    EXPECT_TRUE(SetProperty(override + "click.duration", std::to_string(std::rand())));
+
+    EXPECT_EQ(std::future_status::ready,
+              changed.get_future().wait_for(std::chrono::seconds(2)));
+    mHwCal->watch(nullptr);
+
+    EXPECT_TRUE(SetProperty(override + "click.duration", std::string()));
+    EXPECT_TRUE(SetProperty(prefix + "reload.interval", std::string()));
+    unsetenv("OVERRIDE_PROPERTY_PREFIX");
+}
+
 }  // namespace vibrator
 }  // namespace hardware
 }  // namespace android
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Calibration.h"
+#include "OdClampTable.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using ::testing::Test;
+
+class OdClampTableTest : public Test {
+  protected:
+    static constexpr int32_t COLD = 5000;
+    static constexpr int32_t HOT = 10000;
+    static constexpr uint32_t LRA_PERIOD = 262;
+    static constexpr uint32_t LRA_PERIOD_SHIFT = 288;
+
+    OdClampTable mTable{
+            {.temperature = COLD, .odClamp = 90, .flatOdClamp = 90,
+             .olLraPeriod = LRA_PERIOD_SHIFT},
+            {.temperature = HOT, .odClamp = 150, .flatOdClamp = 120,
+             .olLraPeriod = LRA_PERIOD},
+    };
+};
+
+TEST_F(OdClampTableTest, bounds) {
+    const auto &cold = mTable.lookup(COLD - 1);
+    const auto &hot = mTable.lookup(HOT + 1);
+
+    EXPECT_EQ(90, cold.odClamp);
+    EXPECT_EQ(90, cold.flatOdClamp);
+    EXPECT_EQ(LRA_PERIOD_SHIFT, cold.olLraPeriod);
+
+    EXPECT_EQ(150, hot.odClamp);
+    EXPECT_EQ(120, hot.flatOdClamp);
+    EXPECT_EQ(LRA_PERIOD, hot.olLraPeriod);
+
+    EXPECT_EQ(0, mTable.bucket(INT32_MIN));
+    EXPECT_EQ(OdClampTable::BUCKET_COUNT - 1, mTable.bucket(INT32_MAX));
+}
+
+TEST_F(OdClampTableTest, innerBuckets) {
+    EXPECT_EQ(1, mTable.bucket(COLD));
+    EXPECT_EQ(OdClampTable::BUCKET_COUNT - 2, mTable.bucket(HOT));
+}
+
+TEST_F(OdClampTableTest, monotonic) {
+    const OdClampTable::Entry *prev = &mTable.lookup(COLD - 1);
+
+    for (int32_t temperature = COLD; temperature <= HOT + 1; temperature += 100) {
+        const OdClampTable::Entry *entry = &mTable.lookup(temperature);
+        EXPECT_GE(entry->odClamp, prev->odClamp);
+        EXPECT_GE(entry->flatOdClamp, prev->flatOdClamp);
+        EXPECT_LE(calibration::freqPeriodFormula(prev->olLraPeriod),
+                  calibration::freqPeriodFormula(entry->olLraPeriod));
+        prev = entry;
+    }
+}
+
+TEST_F(OdClampTableTest, periodWithoutFrequency) {
+    OdClampTable table{
+            {.temperature = COLD, .odClamp = 90, .flatOdClamp = 90, .olLraPeriod = 0},
+            {.temperature = HOT, .odClamp = 150, .flatOdClamp = 120, .olLraPeriod = LRA_PERIOD},
+    };
+
+    // Every bucket falls back to the period of the hot bound.
+    EXPECT_EQ(LRA_PERIOD, table.lookup(COLD - 1).olLraPeriod);
+    for (int32_t temperature = COLD; temperature <= HOT + 1; temperature += 100) {
+        EXPECT_EQ(LRA_PERIOD, table.lookup(temperature).olLraPeriod) << temperature;
+    }
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <future>
+#include <string>
+#include <vector>
+
+#include "Calibration.h"
+#include "PwleEngine.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using ::testing::Test;
+
+class PwleEngineTest : public Test {
+  protected:
+    static ActivePwle active(float startAmplitude, float endAmplitude, float startFrequency,
+                             float endFrequency, int32_t duration) {
+        ActivePwle pwle;
+        pwle.startAmplitude = startAmplitude;
+        pwle.endAmplitude = endAmplitude;
+        pwle.startFrequency = startFrequency;
+        pwle.endFrequency = endFrequency;
+        pwle.duration = duration;
+        return pwle;
+    }
+
+    static BrakingPwle braking(int32_t duration) {
+        BrakingPwle pwle;
+        pwle.braking = Braking::NONE;
+        pwle.duration = duration;
+        return pwle;
+    }
+
+    std::vector<PwleEngine::Sample> render(const std::vector<PrimitivePwle> &composite) {
+        std::vector<PwleEngine::Sample> samples(PwleEngine::SAMPLES_MAX);
+        samples.resize(PwleEngine::render(composite, samples.data()));
+        return samples;
+    }
+};
+
+TEST_F(PwleEngineTest, constant) {
+    auto samples = render({active(1.0f, 1.0f, 150.0f, 150.0f, 100)});
+
+    ASSERT_EQ(100 * 1000 / PwleEngine::TICK_US, samples.size());
+    for (const auto &sample : samples) {
+        EXPECT_EQ(127, sample.rtpInput);
+        EXPECT_EQ(calibration::frequencyToPeriod(150.0f), sample.olLraPeriod);
+    }
+}
+
+TEST_F(PwleEngineTest, ramp) {
+    auto samples = render({active(0.0f, 1.0f, 120.0f, 180.0f, 100)});
+
+    ASSERT_FALSE(samples.empty());
+    EXPECT_EQ(0, samples.front().rtpInput);
+    EXPECT_EQ(calibration::frequencyToPeriod(120.0f), samples.front().olLraPeriod);
+    for (size_t i = 1; i < samples.size(); i++) {
+        EXPECT_GE(samples[i].rtpInput, samples[i - 1].rtpInput);
+        EXPECT_LE(samples[i].olLraPeriod, samples[i - 1].olLraPeriod);
+    }
+}
+
+TEST_F(PwleEngineTest, brakingKeepsFrequency) {
+    auto samples = render({active(1.0f, 1.0f, 150.0f, 150.0f, 10), braking(10)});
+
+    ASSERT_EQ(20 * 1000 / PwleEngine::TICK_US, samples.size());
+    EXPECT_EQ(0, samples.back().rtpInput);
+    EXPECT_EQ(calibration::frequencyToPeriod(150.0f), samples.back().olLraPeriod);
+}
+
+TEST_F(PwleEngineTest, leadingBrakingKeepsPeriod) {
+    auto samples = render({braking(10)});
+
+    ASSERT_FALSE(samples.empty());
+    EXPECT_EQ(0, samples.front().olLraPeriod);
+}
+
+TEST_F(PwleEngineTest, carriesPartialTicks) {
+    // Three 3ms segments span 9ms, i.e. one full tick in total.
+    auto samples = render({active(1.0f, 1.0f, 150.0f, 150.0f, 3),
+                           active(1.0f, 1.0f, 150.0f, 150.0f, 3),
+                           active(1.0f, 1.0f, 150.0f, 150.0f, 3)});
+
+    EXPECT_EQ(9 * 1000 / PwleEngine::TICK_US, samples.size());
+}
+
+TEST_F(PwleEngineTest, longest) {
+    std::vector<PrimitivePwle> composite(
+            PwleEngine::COMPOSITION_SIZE_MAX,
+            active(1.0f, 1.0f, 150.0f, 150.0f, PwleEngine::PRIMITIVE_DURATION_MAX_MS));
+
+    EXPECT_EQ(PwleEngine::SAMPLES_MAX, render(composite).size());
+}
+
+TEST_F(PwleEngineTest, cancelStopsPlayback) {
+    CompletionEngine completion;
+    std::vector<std::string> calls;
+    std::promise<void> streaming;
+    PwleEngine engine(
+            {
+                    .begin = [&](uint32_t) { return calls.push_back("begin"), true; },
+                    .write =
+                            [&](const PwleEngine::Sample &) {
+                                calls.push_back("write");
+                                if (calls.size() == 3) {
+                                    streaming.set_value();
+                                }
+                                return true;
+                            },
+                    .stop = [&]() { calls.push_back("stop"); },
+                    .end = [&]() { calls.push_back("end"); },
+            },
+            &completion);
+
+    engine.start({active(1.0f, 1.0f, 150.0f, 150.0f, PwleEngine::PRIMITIVE_DURATION_MAX_MS)},
+                 nullptr);
+    streaming.get_future().wait();
+    engine.cancel();
+
+    // Samples are written with the engine lock held, so the calls are stable
+    // once cancel() returns.
+    ASSERT_GE(calls.size(), 5u);
+    EXPECT_EQ("stop", calls[calls.size() - 2]);
+    EXPECT_EQ("end", calls.back());
+
+    // Nothing is left to stop afterwards.
+    const size_t count = calls.size();
+    engine.cancel();
+    EXPECT_EQ(count, calls.size());
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
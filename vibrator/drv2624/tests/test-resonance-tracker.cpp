@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include "ResonanceTracker.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using ::testing::Test;
+
+class ResonanceTrackerTest : public Test {
+  protected:
+    ResonanceTracker::Output output() {
+        return {
+                .begin =
+                        [this] {
+                            mBegins++;
+                            return true;
+                        },
+                .finish =
+                        [this](uint32_t *lraPeriod) {
+                            mFinishes++;
+                            *lraPeriod = LRA_PERIOD;
+                            return true;
+                        },
+                .abort = [this] { mAborts++; },
+        };
+    }
+
+    // Polls 'done' until it holds or a generous deadline passes.
+    template <typename Predicate>
+    static bool waitFor(Predicate done) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+        while (!done()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    static constexpr uint32_t LRA_PERIOD = 262;
+
+    std::atomic<uint32_t> mBegins{0};
+    std::atomic<uint32_t> mFinishes{0};
+    std::atomic<uint32_t> mAborts{0};
+};
+
+TEST_F(ResonanceTrackerTest, disabled_neverMeasures) {
+    ResonanceTracker tracker(output(), std::chrono::milliseconds::zero());
+    uint32_t lraPeriod;
+
+    tracker.interrupt();
+
+    EXPECT_FALSE(tracker.takeLraPeriod(&lraPeriod));
+    EXPECT_EQ(0u, mBegins);
+}
+
+TEST_F(ResonanceTrackerTest, enabled_waitsForIdle) {
+    ResonanceTracker tracker(output(), std::chrono::milliseconds(1));
+    uint32_t lraPeriod;
+
+    tracker.interrupt();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    EXPECT_FALSE(tracker.takeLraPeriod(&lraPeriod));
+    EXPECT_EQ(0u, mBegins);
+}
+
+TEST_F(ResonanceTrackerTest, hold_waitsForPlaybackToEnd) {
+    ResonanceTracker tracker(output(), std::chrono::milliseconds(1), std::chrono::milliseconds(20),
+                             std::chrono::milliseconds(1));
+    uint32_t lraPeriod;
+
+    tracker.hold(std::chrono::milliseconds(200));
+    // Past the idle time since the playback started, but not since it ends.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(0u, mBegins);
+
+    // Using the hardware meanwhile does not end the playback either.
+    tracker.interrupt();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(0u, mBegins);
+
+    ASSERT_TRUE(waitFor([&] { return tracker.takeLraPeriod(&lraPeriod); }));
+    EXPECT_EQ(LRA_PERIOD, lraPeriod);
+}
+
+TEST_F(ResonanceTrackerTest, hold_stoppedPlaybackStartsIdle) {
+    ResonanceTracker tracker(output(), std::chrono::milliseconds(1), std::chrono::milliseconds(20),
+                             std::chrono::milliseconds(1));
+    uint32_t lraPeriod;
+
+    tracker.hold(std::chrono::hours(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(0u, mBegins);
+
+    tracker.hold(std::chrono::milliseconds::zero());
+
+    ASSERT_TRUE(waitFor([&] { return tracker.takeLraPeriod(&lraPeriod); }));
+}
+
+TEST_F(ResonanceTrackerTest, completedRun_reportsLraPeriod) {
+    ResonanceTracker tracker(output(), std::chrono::milliseconds(1), std::chrono::milliseconds(0),
+                             std::chrono::milliseconds(1));
+    uint32_t lraPeriod;
+
+    ASSERT_TRUE(waitFor([&] { return tracker.takeLraPeriod(&lraPeriod); }));
+
+    // Further runs may have started since.
+    EXPECT_EQ(LRA_PERIOD, lraPeriod);
+    EXPECT_GE(mBegins, 1u);
+    EXPECT_GE(mFinishes, 1u);
+    EXPECT_EQ(0u, mAborts);
+}
+
+TEST_F(ResonanceTrackerTest, interruptedRun_abortsAndDropsResult) {
+    ResonanceTracker tracker(output(), std::chrono::milliseconds(1), std::chrono::milliseconds(0),
+                             std::chrono::hours(1));
+    uint32_t lraPeriod;
+
+    ASSERT_TRUE(waitFor([&] { return mBegins == 1; }));
+    tracker.interrupt();
+
+    // The hardware is restored by the time interrupt() returns.
+    EXPECT_EQ(1u, mAborts);
+    EXPECT_EQ(0u, mFinishes);
+    EXPECT_FALSE(tracker.takeLraPeriod(&lraPeriod));
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "StartupProfile.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using ::testing::Test;
+
+using namespace std::chrono_literals;
+
+using Phase = StartupProfile::Phase;
+using Scope = StartupProfile::Scope;
+
+class StartupProfileTest : public Test {
+  protected:
+    StartupProfile mProfile;
+};
+
+TEST_F(StartupProfileTest, scope_recordsPhase) {
+    EXPECT_FALSE(mProfile.span(Phase::OPEN_NODES).recorded);
+    {
+        Scope scope(&mProfile, Phase::OPEN_NODES);
+        std::this_thread::sleep_for(2ms);
+    }
+
+    auto span = mProfile.span(Phase::OPEN_NODES);
+    EXPECT_TRUE(span.recorded);
+    EXPECT_GE(span.elapsed, 2ms);
+    EXPECT_FALSE(mProfile.span(Phase::BUILD_CONFIG).recorded);
+}
+
+TEST_F(StartupProfileTest, scope_keepsFirstRun) {
+    {
+        Scope scope(&mProfile, Phase::LOAD_CALIBRATION);
+        std::this_thread::sleep_for(2ms);
+    }
+    {
+        Scope scope(&mProfile, Phase::LOAD_CALIBRATION);
+    }
+
+    EXPECT_GE(mProfile.span(Phase::LOAD_CALIBRATION).elapsed, 2ms);
+}
+
+TEST_F(StartupProfileTest, sampleUsage_countsFds) {
+    TemporaryFile file;
+    auto before = StartupProfile::sampleUsage();
+    int fd = open(file.path, O_RDONLY | O_CLOEXEC);
+
+    ASSERT_GE(fd, 0);
+    auto after = StartupProfile::sampleUsage();
+    close(fd);
+
+    EXPECT_EQ(before.fds + 1, after.fds);
+    EXPECT_GT(after.rssBytes, 0u);
+}
+
+TEST_F(StartupProfileTest, debug_listsPhases) {
+    TemporaryFile out;
+    std::string dump;
+
+    {
+        Scope scope(&mProfile, Phase::REGISTER_SERVICE);
+    }
+    mProfile.setNodes(14, 4096);
+    mProfile.debug(out.fd);
+    ASSERT_TRUE(::android::base::ReadFileToString(out.path, &dump));
+
+    EXPECT_NE(std::string::npos, dump.find(StartupProfile::getName(Phase::REGISTER_SERVICE)));
+    EXPECT_EQ(std::string::npos, dump.find(StartupProfile::getName(Phase::OPEN_NODES)));
+    EXPECT_NE(std::string::npos, dump.find("Nodes: 14 open, 4096 bytes"));
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
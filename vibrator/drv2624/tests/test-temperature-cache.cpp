@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+
+#include "TemperatureCache.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace vibrator {
+
+using ::testing::Test;
+
+static constexpr char ZONE[] = "pa-therm1";
+static constexpr char DEVPATH[] = "/devices/virtual/thermal/thermal_zone7";
+
+class TemperatureCacheTest : public Test {
+  protected:
+    TemperatureCache::ReadFunction reader() {
+        return [this](int32_t *value) {
+            mReads++;
+            *value = mTemperature;
+            return mReadable;
+        };
+    }
+
+    static std::string uevent(const std::string &name, const std::string &temp,
+                              const std::string &header = std::string("change@") + DEVPATH) {
+        std::string msg = header;
+        msg += '\0';
+        msg += "SUBSYSTEM=thermal";
+        msg += '\0';
+        msg += "NAME=" + name;
+        msg += '\0';
+        if (!temp.empty()) {
+            msg += "TEMP=" + temp;
+            msg += '\0';
+        }
+        return msg;
+    }
+
+    int32_t mTemperature{25000};
+    bool mReadable{true};
+    uint32_t mReads{0};
+};
+
+TEST_F(TemperatureCacheTest, reusesFreshValue) {
+    TemperatureCache cache(reader(), std::chrono::hours(1));
+    int32_t value;
+
+    ASSERT_TRUE(cache.get(&value));
+    EXPECT_EQ(25000, value);
+
+    mTemperature = 3000;
+    ASSERT_TRUE(cache.get(&value));
+    EXPECT_EQ(25000, value);
+    EXPECT_EQ(1, mReads);
+}
+
+TEST_F(TemperatureCacheTest, refreshesStaleValue) {
+    TemperatureCache cache(reader(), std::chrono::milliseconds(0));
+    int32_t value;
+
+    ASSERT_TRUE(cache.get(&value));
+    mTemperature = 3000;
+    ASSERT_TRUE(cache.get(&value));
+    EXPECT_EQ(3000, value);
+    EXPECT_EQ(2, mReads);
+}
+
+TEST_F(TemperatureCacheTest, readFailure) {
+    TemperatureCache cache(reader(), std::chrono::hours(1));
+    int32_t value;
+
+    mReadable = false;
+    EXPECT_FALSE(cache.get(&value));
+
+    mReadable = true;
+    EXPECT_TRUE(cache.get(&value));
+    EXPECT_EQ(2, mReads);
+}
+
+TEST_F(TemperatureCacheTest, ueventUpdatesValue) {
+    TemperatureCache cache(reader(), std::chrono::hours(1), ZONE);
+    std::string msg = uevent(ZONE, "4000");
+    int32_t value;
+
+    ASSERT_TRUE(cache.get(&value));
+    cache.onUevent(msg.data(), msg.size());
+    ASSERT_TRUE(cache.get(&value));
+    EXPECT_EQ(4000, value);
+    EXPECT_EQ(1, mReads);
+}
+
+TEST_F(TemperatureCacheTest, ueventWithoutTempInvalidates) {
+    TemperatureCache cache(reader(), std::chrono::hours(1), ZONE);
+    std::string msg = uevent(ZONE, "");
+    int32_t value;
+
+    ASSERT_TRUE(cache.get(&value));
+    mTemperature = 4000;
+    cache.onUevent(msg.data(), msg.size());
+    ASSERT_TRUE(cache.get(&value));
+    EXPECT_EQ(4000, value);
+    EXPECT_EQ(2, mReads);
+}
+
+TEST_F(TemperatureCacheTest, ueventOtherZoneIgnored) {
+    TemperatureCache cache(reader(), std::chrono::hours(1), ZONE);
+    std::string msg = uevent("battery", "4000");
+    int32_t value;
+
+    ASSERT_TRUE(cache.get(&value));
+    cache.onUevent(msg.data(), msg.size());
+    ASSERT_TRUE(cache.get(&value));
+    EXPECT_EQ(25000, value);
+}
+
+// Replays uevents through the filter in the kernel, over a datagram socket
+// pair, so that the program is checked by the same verifier and interpreter
+// as on the uevent socket.
+TEST_F(TemperatureCacheTest, ueventFilter) {
+    int sockets[2];
+    char buf[UINT8_MAX];
+    auto passes = [&](const std::string &msg) {
+        EXPECT_EQ(static_cast<ssize_t>(msg.size()),
+                  send(sockets[0], msg.data(), msg.size(), 0));
+        return recv(sockets[1], buf, sizeof(buf), MSG_DONTWAIT) ==
+               static_cast<ssize_t>(msg.size());
+    };
+    auto program = TemperatureCache::buildUeventFilter(DEVPATH);
+    const sock_fprog fprog = {
+            .len = static_cast<unsigned short>(program.size()),
+            .filter = program.data(),
+    };
+
+    ASSERT_FALSE(program.empty());
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, sockets));
+    ASSERT_EQ(0, setsockopt(sockets[1], SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)));
+
+    EXPECT_TRUE(passes(uevent(ZONE, "4000")));
+    EXPECT_TRUE(passes(uevent(ZONE, "")));
+    EXPECT_FALSE(passes(uevent(ZONE, "4000", std::string("change@") + DEVPATH + "0")));
+    EXPECT_FALSE(passes(uevent(ZONE, "4000", std::string("add@") + DEVPATH)));
+    EXPECT_FALSE(passes(uevent("battery", "4000",
+                               "change@/devices/platform/soc/power_supply/battery")));
+    EXPECT_FALSE(passes("change@/devices"));
+
+    close(sockets[0]);
+    close(sockets[1]);
+}
+
+}  // namespace vibrator
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -18,6 +18,8 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <future>
+
 #include "Vibrator.h"
 #include "mocks.h"
 #include "types.h"
@@ -37,8 +39,10 @@ using ::testing::DoAll;
 using ::testing::DoDefault;
 using ::testing::Exactly;
 using ::testing::ExpectationSet;
+using ::testing::InvokeWithoutArgs;
 using ::testing::Mock;
 using ::testing::Return;
+using ::testing::SaveArg;
 using ::testing::Sequence;
 using ::testing::SetArgPointee;
 using ::testing::SetArgReferee;
@@ -49,20 +53,22 @@ using ::testing::WithParamInterface;
 
 // Constants With Prescribed Values
 
+// The tests provide no calibration coefficients, so every strength plays its
+// level at full scale.
 static const std::map<EffectTuple, EffectSequence> EFFECT_SEQUENCES{
-    {{Effect::CLICK, EffectStrength::LIGHT}, {"1 0", 2}},
+    {{Effect::CLICK, EffectStrength::LIGHT}, {"1 0", 0}},
     {{Effect::CLICK, EffectStrength::MEDIUM}, {"1 0", 0}},
     {{Effect::CLICK, EffectStrength::STRONG}, {"1 0", 0}},
-    {{Effect::TICK, EffectStrength::LIGHT}, {"2 0", 2}},
+    {{Effect::TICK, EffectStrength::LIGHT}, {"2 0", 0}},
     {{Effect::TICK, EffectStrength::MEDIUM}, {"2 0", 0}},
     {{Effect::TICK, EffectStrength::STRONG}, {"2 0", 0}},
-    {{Effect::DOUBLE_CLICK, EffectStrength::LIGHT}, {"3 0", 2}},
+    {{Effect::DOUBLE_CLICK, EffectStrength::LIGHT}, {"3 0", 0}},
     {{Effect::DOUBLE_CLICK, EffectStrength::MEDIUM}, {"3 0", 0}},
     {{Effect::DOUBLE_CLICK, EffectStrength::STRONG}, {"3 0", 0}},
-    {{Effect::HEAVY_CLICK, EffectStrength::LIGHT}, {"4 0", 2}},
+    {{Effect::HEAVY_CLICK, EffectStrength::LIGHT}, {"4 0", 0}},
     {{Effect::HEAVY_CLICK, EffectStrength::MEDIUM}, {"4 0", 0}},
     {{Effect::HEAVY_CLICK, EffectStrength::STRONG}, {"4 0", 0}},
-    {{Effect::TEXTURE_TICK, EffectStrength::LIGHT}, {"2 0", 2}},
+    {{Effect::TEXTURE_TICK, EffectStrength::LIGHT}, {"2 0", 0}},
     {{Effect::TEXTURE_TICK, EffectStrength::MEDIUM}, {"2 0", 0}},
     {{Effect::TEXTURE_TICK, EffectStrength::STRONG}, {"2 0", 0}},
 };
@@ -102,6 +108,7 @@ class VibratorTestTemplate : public Test, public WithParamInterface<std::tuple<b
         }
 
         mShortLraPeriod = std::rand();
+        mTemperature = ROOM_TEMPERATURE;
         if (getDynamicConfig()) {
             mLongFrequencyShift = std::rand();
             mLongLraPeriod =
@@ -140,8 +147,13 @@ class VibratorTestTemplate : public Test, public WithParamInterface<std::tuple<b
         ON_CALL(*mMockApi, setCtrlLoop(_)).WillByDefault(Return(true));
         ON_CALL(*mMockApi, setLraWaveShape(_)).WillByDefault(Return(true));
         ON_CALL(*mMockApi, setOdClamp(_)).WillByDefault(Return(true));
+        ON_CALL(*mMockApi, getPATemp(_)).WillByDefault([this](int32_t *value) {
+            *value = mTemperature;
+            return true;
+        });
 
         ON_CALL(*mMockCal, destructor()).WillByDefault(Assign(&mMockCal, nullptr));
+        ON_CALL(*mMockCal, watch(_)).WillByDefault(SaveArg<0>(&mOnChange));
         ON_CALL(*mMockCal, getLraPeriod(_))
             .WillByDefault(DoAll(SetArgPointee<0>(mShortLraPeriod), Return(true)));
         ON_CALL(*mMockCal, getCloseLoopThreshold(_))
@@ -168,6 +180,12 @@ class VibratorTestTemplate : public Test, public WithParamInterface<std::tuple<b
         ON_CALL(*mMockCal, getHeavyClickDuration(_))
             .WillByDefault(
                 DoAll(SetArgPointee<0>(mEffectDurations[Effect::HEAVY_CLICK]), Return(true)));
+        ON_CALL(*mMockCal, getEffectShape(_))
+            .WillByDefault(DoAll(SetArgPointee<0>(UINT32_MAX), Return(true)));
+        ON_CALL(*mMockCal, getSteadyShape(_))
+            .WillByDefault(DoAll(SetArgPointee<0>(UINT32_MAX), Return(true)));
+        ON_CALL(*mMockCal, getTriggerEffectSupport(_))
+            .WillByDefault(DoAll(SetArgPointee<0>(1), Return(true)));
 
         relaxMock(false);
     }
@@ -225,13 +243,28 @@ class VibratorTestTemplate : public Test, public WithParamInterface<std::tuple<b
         EXPECT_CALL(*mMockCal, getTickDuration(_)).Times(times);
         EXPECT_CALL(*mMockCal, getDoubleClickDuration(_)).Times(times);
         EXPECT_CALL(*mMockCal, getHeavyClickDuration(_)).Times(times);
+        EXPECT_CALL(*mMockCal, getTemperatureMaxAge(_)).Times(times);
+        EXPECT_CALL(*mMockCal, getQFactor(_)).Times(times);
+        EXPECT_CALL(*mMockCal, getResonanceInterval(_)).Times(times);
+        EXPECT_CALL(*mMockCal, getTriggerEffectSupport(_)).Times(times);
+        EXPECT_CALL(*mMockCal, getAlwaysOnState(_)).Times(times);
+        EXPECT_CALL(*mMockCal, setAlwaysOnState(_)).Times(times);
+        EXPECT_CALL(*mMockCal, watch(_)).Times(times);
         EXPECT_CALL(*mMockCal, debug(_)).Times(times);
     }
 
   protected:
+    // Above the temperature range in which the steady strength is limited.
+    static constexpr int32_t ROOM_TEMPERATURE = 25000;
+    // Below the lower bound of that range.
+    static constexpr int32_t COLD_TEMPERATURE = 0;
+    // od_clamp used for steady vibrations below the lower bound.
+    static constexpr uint32_t STEADY_VOLTAGE_LOWER_BOUND = 90;
+
     MockApi *mMockApi;
     MockCal *mMockCal;
     std::shared_ptr<IVibrator> mVibrator;
+    std::function<void()> mOnChange;
 
     EffectDuration mCloseLoopThreshold;
     uint32_t mLongFrequencyShift;
@@ -239,6 +272,7 @@ class VibratorTestTemplate : public Test, public WithParamInterface<std::tuple<b
     uint32_t mLongLraPeriod;
     uint32_t mShortVoltageMax;
     uint32_t mLongVoltageMax;
+    int32_t mTemperature;
     std::map<Effect, EffectDuration> mEffectDurations;
 };
 
@@ -253,6 +287,7 @@ TEST_P(BasicTest, Constructor) {
 
     EXPECT_CALL(*mMockApi, destructor()).WillOnce(DoDefault());
     EXPECT_CALL(*mMockCal, destructor()).WillOnce(DoDefault());
+    EXPECT_CALL(*mMockCal, watch(_)).WillOnce(DoDefault());
 
     deleteVibrator(false);
 
@@ -274,6 +309,7 @@ TEST_P(BasicTest, Constructor) {
         EXPECT_CALL(*mMockCal, getLongFrequencyShift(_)).WillOnce(DoDefault());
         EXPECT_CALL(*mMockCal, getShortVoltageMax(_)).WillOnce(DoDefault());
         EXPECT_CALL(*mMockCal, getLongVoltageMax(_)).WillOnce(DoDefault());
+        EXPECT_CALL(*mMockCal, getTemperatureMaxAge(_)).WillOnce(DoDefault());
     } else {
         EXPECT_CALL(*mMockApi, setOlLraPeriod(mShortLraPeriod))
             .InSequence(lraPeriodSeq)
@@ -284,8 +320,13 @@ TEST_P(BasicTest, Constructor) {
     EXPECT_CALL(*mMockCal, getTickDuration(_)).WillOnce(DoDefault());
     EXPECT_CALL(*mMockCal, getDoubleClickDuration(_)).WillOnce(DoDefault());
     EXPECT_CALL(*mMockCal, getHeavyClickDuration(_)).WillOnce(DoDefault());
+    EXPECT_CALL(*mMockCal, getResonanceInterval(_)).WillOnce(DoDefault());
+    EXPECT_CALL(*mMockCal, getQFactor(_)).WillOnce(DoDefault());
+    EXPECT_CALL(*mMockCal, getTriggerEffectSupport(_)).WillOnce(DoDefault());
+    EXPECT_CALL(*mMockCal, getAlwaysOnState(_)).WillOnce(DoDefault());
 
     EXPECT_CALL(*mMockApi, setLpTriggerEffect(1)).WillOnce(Return(true));
+    EXPECT_CALL(*mMockCal, watch(_)).WillOnce(DoDefault());
 
     createVibrator(std::move(mockapi), std::move(mockcal), false);
 }
@@ -301,9 +342,34 @@ TEST_P(BasicTest, on) {
     if (getDynamicConfig()) {
         e += EXPECT_CALL(*mMockApi, setLraWaveShape(0)).WillOnce(DoDefault());
         e += EXPECT_CALL(*mMockApi, setOdClamp(mLongVoltageMax)).WillOnce(DoDefault());
-        e += EXPECT_CALL(*mMockApi, setOlLraPeriod(mLongLraPeriod)).WillOnce(DoDefault());
+        e += EXPECT_CALL(*mMockApi, setOlLraPeriod(mShortLraPeriod)).WillOnce(DoDefault());
+    }
+
+    EXPECT_CALL(*mMockApi, setActivate(true)).After(e).WillOnce(DoDefault());
+
+    EXPECT_EQ(EX_NONE, mVibrator->on(duration, nullptr).getExceptionCode());
+}
+
+TEST_P(BasicTest, on_cold) {
+    EffectDuration duration = std::rand();
+    ExpectationSet e;
+
+    if (!getDynamicConfig()) {
+        GTEST_SKIP() << "Temperature only applies to dynamic config";
     }
 
+    mTemperature = COLD_TEMPERATURE;
+
+    e += EXPECT_CALL(*mMockApi, setCtrlLoop(_)).WillOnce(DoDefault());
+    e += EXPECT_CALL(*mMockApi, setMode("rtp")).WillOnce(DoDefault());
+    e += EXPECT_CALL(*mMockApi, setDuration(duration)).WillOnce(DoDefault());
+    e += EXPECT_CALL(*mMockApi, setLraWaveShape(0)).WillOnce(DoDefault());
+    e += EXPECT_CALL(*mMockApi, setOdClamp(STEADY_VOLTAGE_LOWER_BOUND)).WillOnce(DoDefault());
+    // The random periods can leave the shifted one without a value, in which
+    // case the calibrated period is used.
+    e += EXPECT_CALL(*mMockApi, setOlLraPeriod(mLongLraPeriod ?: mShortLraPeriod))
+             .WillOnce(DoDefault());
+
     EXPECT_CALL(*mMockApi, setActivate(true)).After(e).WillOnce(DoDefault());
 
     EXPECT_EQ(EX_NONE, mVibrator->on(duration, nullptr).getExceptionCode());
@@ -329,6 +395,63 @@ TEST_P(BasicTest, on_closeLoop) {
     EXPECT_EQ(EX_NONE, mVibrator->on(duration, nullptr).getExceptionCode());
 }
 
+TEST_P(BasicTest, reload_appliesCloseLoopThreshold) {
+    EffectDuration duration = mCloseLoopThreshold + 1;
+
+    relaxMock(true);
+    ON_CALL(*mMockCal, getCloseLoopThreshold(_))
+        .WillByDefault(DoAll(SetArgPointee<0>(duration), Return(true)));
+
+    ASSERT_TRUE(mOnChange);
+    mOnChange();
+
+    EXPECT_CALL(*mMockApi, setCtrlLoop(true)).WillOnce(DoDefault());
+
+    EXPECT_EQ(EX_NONE, mVibrator->on(duration, nullptr).getExceptionCode());
+}
+
+TEST_P(BasicTest, on_callback) {
+    auto callback = ndk::SharedRefBase::make<MockVibratorCallback>();
+    std::promise<void> completed;
+
+    relaxMock(true);
+
+    EXPECT_CALL(*callback, onComplete()).WillOnce(InvokeWithoutArgs([&completed] {
+        completed.set_value();
+        return ndk::ScopedAStatus::ok();
+    }));
+
+    EXPECT_EQ(EX_NONE, mVibrator->on(1, callback).getExceptionCode());
+    EXPECT_EQ(std::future_status::ready,
+              completed.get_future().wait_for(std::chrono::seconds(1)));
+}
+
+TEST_P(BasicTest, off_completesCallback) {
+    auto callback = ndk::SharedRefBase::make<MockVibratorCallback>();
+    std::promise<void> completed;
+
+    relaxMock(true);
+
+    EXPECT_CALL(*callback, onComplete()).WillOnce(InvokeWithoutArgs([&completed] {
+        completed.set_value();
+        return ndk::ScopedAStatus::ok();
+    }));
+
+    EXPECT_EQ(EX_NONE, mVibrator->on(INT32_MAX, callback).getExceptionCode());
+    EXPECT_EQ(EX_NONE, mVibrator->off().getExceptionCode());
+    EXPECT_EQ(std::future_status::ready,
+              completed.get_future().wait_for(std::chrono::seconds(1)));
+}
+
+TEST_P(BasicTest, supportsCallbacks) {
+    EXPECT_CALL(*mMockApi, hasRtpInput()).WillOnce(Return(true));
+
+    int32_t capabilities;
+    EXPECT_TRUE(mVibrator->getCapabilities(&capabilities).isOk());
+    EXPECT_GT(capabilities & IVibrator::CAP_ON_CALLBACK, 0);
+    EXPECT_GT(capabilities & IVibrator::CAP_PERFORM_CALLBACK, 0);
+}
+
 TEST_P(BasicTest, off) {
     EXPECT_CALL(*mMockApi, setActivate(false)).WillOnce(DoDefault());
 
@@ -375,6 +498,136 @@ TEST_P(BasicTest, setExternalControl_disable) {
     EXPECT_EQ(EX_UNSUPPORTED_OPERATION, mVibrator->setExternalControl(false).getExceptionCode());
 }
 
+TEST_P(BasicTest, getSupportedPrimitives) {
+    std::vector<CompositePrimitive> supported;
+
+    EXPECT_TRUE(mVibrator->getSupportedPrimitives(&supported).isOk());
+    EXPECT_THAT(supported, ::testing::Contains(CompositePrimitive::CLICK));
+    EXPECT_THAT(supported, ::testing::Contains(CompositePrimitive::LIGHT_TICK));
+}
+
+TEST_P(BasicTest, compose_packsSequence) {
+    auto callback = ndk::SharedRefBase::make<MockVibratorCallback>();
+    std::vector<CompositeEffect> composite(2);
+    std::promise<void> played;
+    std::promise<void> completed;
+    ExpectationSet e;
+
+    composite[0].primitive = CompositePrimitive::CLICK;
+    composite[0].scale = 1.0f;
+    composite[1].primitive = CompositePrimitive::LIGHT_TICK;
+    composite[1].scale = 1.0f;
+
+    relaxMock(true);
+
+    e += EXPECT_CALL(*mMockApi, setSequencer("1 0 2 0")).WillOnce(Return(true));
+    e += EXPECT_CALL(*mMockApi, setScale(0)).WillOnce(Return(true));
+    e += EXPECT_CALL(*mMockApi, setDuration(mEffectDurations[Effect::CLICK] +
+                                            mEffectDurations[Effect::TICK]))
+             .WillOnce(DoDefault());
+    EXPECT_CALL(*mMockApi, setActivate(true))
+        .After(e)
+        .WillOnce(DoAll(InvokeWithoutArgs([&played] { played.set_value(); }), Return(true)));
+    EXPECT_CALL(*callback, onComplete()).WillOnce(InvokeWithoutArgs([&completed] {
+        completed.set_value();
+        return ndk::ScopedAStatus::ok();
+    }));
+
+    EXPECT_EQ(EX_NONE, mVibrator->compose(composite, callback).getExceptionCode());
+    EXPECT_EQ(std::future_status::ready, played.get_future().wait_for(std::chrono::seconds(1)));
+    // Keep the completion wait short regardless of the random durations.
+    EXPECT_EQ(EX_NONE, mVibrator->off().getExceptionCode());
+    EXPECT_EQ(std::future_status::ready,
+              completed.get_future().wait_for(std::chrono::seconds(1)));
+}
+
+TEST_P(BasicTest, compose_tooLarge) {
+    int32_t maxSize;
+
+    EXPECT_TRUE(mVibrator->getCompositionSizeMax(&maxSize).isOk());
+
+    std::vector<CompositeEffect> composite(maxSize + 1);
+    for (auto &e : composite) {
+        e.primitive = CompositePrimitive::CLICK;
+        e.scale = 1.0f;
+    }
+
+    EXPECT_EQ(EX_ILLEGAL_ARGUMENT, mVibrator->compose(composite, nullptr).getExceptionCode());
+}
+
+TEST_P(BasicTest, getSupportedBraking) {
+    std::vector<Braking> supported;
+
+    EXPECT_TRUE(mVibrator->getSupportedBraking(&supported).isOk());
+    EXPECT_EQ(std::vector<Braking>{Braking::NONE}, supported);
+}
+
+TEST_P(BasicTest, composePwle_illegalArguments) {
+    ActivePwle active;
+    std::vector<float> bandwidth;
+    int32_t durationMax, sizeMax;
+    float resonantFreqHz;
+
+    EXPECT_TRUE(mVibrator->getPwlePrimitiveDurationMax(&durationMax).isOk());
+    EXPECT_TRUE(mVibrator->getPwleCompositionSizeMax(&sizeMax).isOk());
+    EXPECT_TRUE(mVibrator->getBandwidthAmplitudeMap(&bandwidth).isOk());
+    EXPECT_FALSE(bandwidth.empty());
+
+    EXPECT_CALL(*mMockApi, hasRtpInput()).WillRepeatedly(Return(true));
+    EXPECT_TRUE(mVibrator->getResonantFrequency(&resonantFreqHz).isOk());
+
+    active.startAmplitude = active.endAmplitude = 1.0f;
+    active.startFrequency = active.endFrequency = resonantFreqHz;
+    active.duration = durationMax;
+
+    EXPECT_EQ(EX_ILLEGAL_ARGUMENT, mVibrator->composePwle({}, nullptr).getExceptionCode());
+    EXPECT_EQ(EX_ILLEGAL_ARGUMENT,
+              mVibrator->composePwle(std::vector<PrimitivePwle>(sizeMax + 1, active), nullptr)
+                  .getExceptionCode());
+
+    ActivePwle longer = active;
+    longer.duration = durationMax + 1;
+    EXPECT_EQ(EX_ILLEGAL_ARGUMENT, mVibrator->composePwle({longer}, nullptr).getExceptionCode());
+
+    ActivePwle louder = active;
+    louder.endAmplitude = 1.5f;
+    EXPECT_EQ(EX_ILLEGAL_ARGUMENT, mVibrator->composePwle({louder}, nullptr).getExceptionCode());
+
+    BrakingPwle braking;
+    braking.braking = Braking::CLAB;
+    braking.duration = 0;
+    EXPECT_EQ(EX_ILLEGAL_ARGUMENT, mVibrator->composePwle({braking}, nullptr).getExceptionCode());
+}
+
+TEST_P(BasicTest, composePwle_unsupported) {
+    ActivePwle active;
+
+    EXPECT_CALL(*mMockApi, hasRtpInput()).WillOnce(Return(false));
+
+    EXPECT_EQ(EX_UNSUPPORTED_OPERATION,
+              mVibrator->composePwle({active}, nullptr).getExceptionCode());
+}
+
+TEST_P(BasicTest, alwaysOnEnable_programsTrigger) {
+    Sequence s;
+
+    EXPECT_CALL(*mMockApi, setLpTriggerEffect(2)).InSequence(s).WillOnce(Return(true));
+    EXPECT_CALL(*mMockCal, setAlwaysOnState("1:2")).InSequence(s).WillOnce(Return(true));
+    EXPECT_CALL(*mMockApi, setLpTriggerEffect(0)).InSequence(s).WillOnce(Return(true));
+    EXPECT_CALL(*mMockCal, setAlwaysOnState("none")).InSequence(s).WillOnce(Return(true));
+
+    EXPECT_TRUE(mVibrator->alwaysOnEnable(1, Effect::TICK, EffectStrength::MEDIUM).isOk());
+    EXPECT_TRUE(mVibrator->alwaysOnDisable(1).isOk());
+}
+
+TEST_P(BasicTest, alwaysOnEnable_unsupported) {
+    EXPECT_CALL(*mMockApi, setLpTriggerEffect(_)).Times(0);
+
+    EXPECT_EQ(EX_UNSUPPORTED_OPERATION,
+              mVibrator->alwaysOnEnable(1, Effect::RINGTONE_1, EffectStrength::MEDIUM)
+                      .getExceptionCode());
+}
+
 INSTANTIATE_TEST_CASE_P(VibratorTests, BasicTest,
                         ValuesIn({BasicTest::MakeParam(false), BasicTest::MakeParam(true)}),
                         BasicTest::PrintParam);